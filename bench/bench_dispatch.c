@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+
+/*
+ * Dispatch cost of the listener table walk versus the generated switch.
+ * Events are published in a pseudo random order so that the branch
+ * predictor can not learn the listener sequence.
+ */
+
+#include <stdio.h>
+
+#include "uloop.h"
+#include "uloop_platform.h"
+#include "uloop_listeners.h"
+
+#define BENCH_ROUNDS  20000
+#define BENCH_BURST   512
+
+#ifdef ULOOP_DISPATCH_SWITCH
+#define BENCH_MODE "switch"
+#else
+#define BENCH_MODE "table"
+#endif
+
+uint32_t bench_systick;
+
+static volatile uint32_t sink;
+static uint32_t calls;
+
+void bench_listener_a(uloop_event_t event) {
+	sink += event;
+	calls += 1;
+}
+
+void bench_listener_b(uloop_event_t event) {
+	sink ^= event;
+	calls += 1;
+}
+
+void bench_listener_c(uloop_event_t event) {
+	sink += event << 1;
+	calls += 1;
+}
+
+void bench_listener_d(uloop_event_t event) {
+	sink -= event;
+	calls += 1;
+}
+
+int main(void) {
+	uint8_t order[BENCH_BURST];
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < BENCH_BURST; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		order[i] = seed % ULOOP_EVENT_COUNT;
+	}
+	uloop_init();
+	uint64_t publish_cycles = 0;
+	uint64_t run_cycles = 0;
+	uint64_t start_ns = bench_time_ns();
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		uint64_t start = bench_cycles();
+		for (uint32_t i = 0; i < BENCH_BURST; i++) {
+			uloop_publish(order[i]);
+		}
+		uint64_t middle = bench_cycles();
+		while (uloop_run()) {
+			continue;
+		}
+		publish_cycles += middle - start;
+		run_cycles += bench_cycles() - middle;
+	}
+	uint64_t total_ns = bench_time_ns() - start_ns;
+	uint64_t events = (uint64_t) BENCH_ROUNDS * BENCH_BURST;
+	printf(
+		"{\"bench\": \"dispatch\", \"mode\": \"%s\", \"events\": %u, \"listener_calls\": %u, "
+		"\"cycles_per_run\": %.1f, \"cycles_per_publish\": %.1f, \"ns_per_event\": %.1f}\n",
+		BENCH_MODE, (unsigned) ULOOP_EVENT_COUNT, (unsigned) calls,
+		(double) run_cycles / events,
+		(double) publish_cycles / events,
+		(double) total_ns / events
+	);
+	return 0;
+}
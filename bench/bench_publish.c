@@ -0,0 +1,163 @@
+// SPDX-License-Identifier: MIT
+
+/*
+ * Publish and dispatch cost versus event count. Every event is bound to a
+ * single listener, events are published in a pseudo random order so that
+ * large configurations walk the whole listener lookup table. Builds with
+ * a data queue additionally measure the data queue across payload sizes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "uloop.h"
+#include "uloop_platform.h"
+#include "uloop_listeners.h"
+
+#define BENCH_ROUNDS       4000
+#define BENCH_BURST        256
+#define BENCH_SAMPLES      1000000
+#define BENCH_DATA_ROUNDS  20000
+#define BENCH_DATA_BURST   32
+#define BENCH_DATA_MAX     255
+
+const uloop_listener_t uloop_listeners[ULOOP_LISTENER_COUNT] = {
+	bench_listener
+};
+
+const uloop_listener_id_t uloop_listener_table[ULOOP_LISTENER_TABLE_SIZE] = {
+	0, ULOOP_LISTENER_NONE
+};
+
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {
+	[0 ... (ULOOP_EVENT_COUNT - 1)] = 0
+};
+
+uint32_t bench_systick;
+
+static uloop_event_t order[BENCH_BURST];
+static uint32_t samples[BENCH_SAMPLES];
+static uint64_t published_at;
+static uint32_t latency;
+static volatile uint32_t sink;
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void bench_listener(uloop_event_t event, const void* data, uint32_t size) {
+	latency = bench_cycles() - published_at;
+	sink += event + size + ((const uint8_t*) data)[size - 1];
+}
+#else
+void bench_listener(uloop_event_t event) {
+	latency = bench_cycles() - published_at;
+	sink += event;
+}
+#endif
+
+static int compare(const void* a, const void* b) {
+	uint32_t x = *((const uint32_t*) a);
+	uint32_t y = *((const uint32_t*) b);
+	return (x > y) - (x < y);
+}
+
+static inline void publish(uloop_event_t event, const uint8_t* data, uint32_t size) {
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uloop_publish_ex(event, data, size);
+#else
+	(void) data;
+	(void) size;
+	uloop_publish(event);
+#endif
+}
+
+static void bench_throughput(const uint8_t* data, uint32_t size) {
+	uint64_t start = bench_time_ns();
+	for (uint32_t round = 0; round < BENCH_ROUNDS; round++) {
+		for (uint32_t i = 0; i < BENCH_BURST; i++) {
+			publish(order[i], data, size);
+		}
+		uloop_run_until_idle();
+	}
+	uint64_t total = bench_time_ns() - start;
+	uint64_t events = (uint64_t) BENCH_ROUNDS * BENCH_BURST;
+	printf(
+		"{\"bench\": \"publish\", \"events\": %u, \"data_size\": %u, \"events_per_s\": %.0f, \"ns_per_event\": %.1f}\n",
+		(unsigned) ULOOP_EVENT_COUNT, (unsigned) size,
+		(events * 1e9) / total,
+		(double) total / events
+	);
+}
+
+static void bench_latency(const uint8_t* data, uint32_t size) {
+	uint32_t overhead = UINT32_MAX;
+	for (uint32_t i = 0; i < 1000; i++) {
+		uint64_t start = bench_cycles();
+		uint32_t delta = bench_cycles() - start;
+		if (delta < overhead) {
+			overhead = delta;
+		}
+	}
+	for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+		published_at = bench_cycles();
+		publish(order[i % BENCH_BURST], data, size);
+		uloop_run();
+		samples[i] = latency;
+	}
+	qsort(samples, BENCH_SAMPLES, sizeof(uint32_t), compare);
+	printf(
+		"{\"bench\": \"latency\", \"events\": %u, \"data_size\": %u, \"unit\": \"%s\", \"overhead\": %u, "
+		"\"p50\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}\n",
+		(unsigned) ULOOP_EVENT_COUNT, (unsigned) size, BENCH_CYCLES_UNIT, (unsigned) overhead,
+		(unsigned) samples[BENCH_SAMPLES / 2],
+		(unsigned) samples[(BENCH_SAMPLES / 100) * 99],
+		(unsigned) samples[(BENCH_SAMPLES / 1000) * 999],
+		(unsigned) samples[BENCH_SAMPLES - 1]
+	);
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static void bench_data_size(const uint8_t* data, uint32_t size) {
+	uint64_t start = bench_time_ns();
+	for (uint32_t round = 0; round < BENCH_DATA_ROUNDS; round++) {
+		for (uint32_t i = 0; i < BENCH_DATA_BURST; i++) {
+			uloop_publish_ex(order[i], data, size);
+		}
+		uloop_run_until_idle();
+	}
+	uint64_t total = bench_time_ns() - start;
+	uint64_t events = (uint64_t) BENCH_DATA_ROUNDS * BENCH_DATA_BURST;
+	printf(
+		"{\"bench\": \"data_size\", \"events\": %u, \"data_size\": %u, \"events_per_s\": %.0f, \"mb_per_s\": %.1f}\n",
+		(unsigned) ULOOP_EVENT_COUNT, (unsigned) size,
+		(events * 1e9) / total,
+		(events * size * 1e3) / total
+	);
+}
+#endif
+
+int main(void) {
+	static const uint32_t sizes[] = {1, 4, 16, 64, BENCH_DATA_MAX};
+	uint8_t data[BENCH_DATA_MAX];
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < BENCH_BURST; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		order[i] = seed % ULOOP_EVENT_COUNT;
+	}
+	for (uint32_t i = 0; i < BENCH_DATA_MAX; i++) {
+		data[i] = i;
+	}
+	uloop_init();
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	bench_throughput(data, 4);
+	bench_latency(data, 4);
+	for (uint32_t i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		bench_data_size(data, sizes[i]);
+	}
+#else
+	(void) sizes;
+	bench_throughput(data, 0);
+	bench_latency(data, 0);
+#endif
+	return 0;
+}
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+
+/*
+ * Two processes connected by the shared memory bridge. The latency is the
+ * round trip of a ping answered by the listener of the peer, halved, both
+ * loops sleep between the pings so every hop includes a futex wakeup of the
+ * receiving thread and an eventfd wakeup of the loop. The throughput is the
+ * time to stream events of a given size to the peer until it confirmed the
+ * last one.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "uloop.h"
+#include "uloop_shm.h"
+
+#define PING_EVENT   0
+#define PONG_EVENT   1
+#define DATA_EVENT   2
+#define DONE_EVENT   3
+#define STOP_EVENT   4
+
+#define BENCH_RING_SIZE  (1u << 20)
+#define BENCH_PINGS      20000
+#define BENCH_EVENTS     1000000
+#define BENCH_DATA_MAX   255
+
+static void bench_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[ULOOP_LISTENER_COUNT] = {
+	bench_listener
+};
+
+const uloop_listener_id_t uloop_listener_table[ULOOP_LISTENER_TABLE_SIZE] = {
+	0, ULOOP_LISTENER_NONE
+};
+
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {
+	[0 ... (ULOOP_EVENT_COUNT - 1)] = 0
+};
+
+static uloop_shm_t* bridge;
+static bool running;
+static bool done;
+static uint32_t pongs;
+static uint64_t samples[BENCH_PINGS];
+
+static inline uint64_t bench_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void ping(void) {
+	uint64_t now = bench_time_ns();
+	uloop_shm_publish_ex(bridge, PING_EVENT, &now, sizeof(now));
+}
+
+static void bench_listener(uloop_event_t event, const void* data, uint32_t size) {
+	uint64_t sent;
+	if (event == PING_EVENT) {
+		uloop_shm_publish_ex(bridge, PONG_EVENT, data, size);
+	} else if (event == PONG_EVENT) {
+		memcpy(&sent, data, sizeof(sent));
+		samples[pongs] = (bench_time_ns() - sent) / 2;
+		pongs += 1;
+		if (pongs < BENCH_PINGS) {
+			ping();
+		}
+	} else if (event == DONE_EVENT) {
+		// the peer answers, every event before it was dispatched on its side
+		if (running) {
+			uloop_shm_publish(bridge, DONE_EVENT);
+		}
+		done = true;
+	} else if (event == STOP_EVENT) {
+		running = false;
+	} else {
+		// DATA_EVENT, only dispatched
+	}
+}
+
+static int compare(const void* a, const void* b) {
+	uint64_t x = *((const uint64_t*) a);
+	uint64_t y = *((const uint64_t*) b);
+	return (x > y) - (x < y);
+}
+
+static void peer(int fd) {
+	uloop_init();
+	while ((bridge = uloop_shm_map(fd, BENCH_RING_SIZE, 1)) == NULL) {
+		usleep(1000);
+	}
+	running = true;
+	while (running) {
+		uloop_run();
+	}
+	uloop_shm_close(bridge);
+}
+
+static void bench_latency(void) {
+	ping();
+	while (pongs < BENCH_PINGS) {
+		uloop_run();
+	}
+	qsort(samples, BENCH_PINGS, sizeof(uint64_t), compare);
+	printf(
+		"{\"bench\": \"shm_latency\", \"unit\": \"ns\", \"p50\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}\n",
+		(unsigned) samples[BENCH_PINGS / 2],
+		(unsigned) samples[(BENCH_PINGS / 100) * 99],
+		(unsigned) samples[(BENCH_PINGS / 1000) * 999],
+		(unsigned) samples[BENCH_PINGS - 1]
+	);
+}
+
+static void bench_throughput(const uint8_t* data, uint32_t size) {
+	uloop_shm_stats_t before;
+	uloop_shm_stats_t after;
+	uloop_shm_stats(bridge, &before);
+	done = false;
+	uint64_t start = bench_time_ns();
+	for (uint32_t i = 0; i < BENCH_EVENTS; i++) {
+		while (!uloop_shm_publish_ex(bridge, DATA_EVENT, data, size)) {
+			continue;
+		}
+	}
+	while (!uloop_shm_publish(bridge, DONE_EVENT)) {
+		continue;
+	}
+	while (!done) {
+		uloop_run();
+	}
+	uint64_t total = bench_time_ns() - start;
+	uloop_shm_stats(bridge, &after);
+	printf(
+		"{\"bench\": \"shm_throughput\", \"data_size\": %u, \"events_per_s\": %.0f, \"mb_per_s\": %.1f, \"ring_full\": %u, \"wakeups\": %u}\n",
+		(unsigned) size,
+		(BENCH_EVENTS * 1e9) / total,
+		(BENCH_EVENTS * size * 1e3) / total,
+		(unsigned) (after.drops - before.drops),
+		(unsigned) (after.wakeups - before.wakeups)
+	);
+}
+
+int main(void) {
+	static const uint32_t sizes[] = {0, 8, 64, BENCH_DATA_MAX};
+	uint8_t data[BENCH_DATA_MAX];
+	for (uint32_t i = 0; i < BENCH_DATA_MAX; i++) {
+		data[i] = i;
+	}
+	int fd = memfd_create("uloop_bench", 0);
+	pid_t pid = fork();
+	if (pid == 0) {
+		peer(fd);
+		return 0;
+	}
+	uloop_init();
+	bridge = uloop_shm_map(fd, BENCH_RING_SIZE, 0);
+	if ((fd < 0) || (pid < 0) || (bridge == NULL)) {
+		fprintf(stderr, "shm setup failed\n");
+		return 1;
+	}
+	bench_latency();
+	for (uint32_t i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+		bench_throughput(data, sizes[i]);
+	}
+	uloop_shm_publish(bridge, STOP_EVENT);
+	waitpid(pid, NULL, 0);
+	uloop_shm_close(bridge);
+	return 0;
+}
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+
+/*
+ * Framed stream bridge over a pipe to a second process, standing in for a
+ * UART or USB-CDC link. Events with a small payload are streamed with
+ * different batch sizes until the receiving process confirmed the last
+ * one, the wire bytes per event show the framing overhead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "uloop.h"
+#include "uloop_platform.h"
+#include "uloop_stream.h"
+
+#define DATA_EVENT  0
+#define DONE_EVENT  1
+
+#define BENCH_EVENTS     200000
+#define BENCH_DATA_SIZE  16
+#define BENCH_BUFFER     8192
+
+static void bench_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[ULOOP_LISTENER_COUNT] = {
+	bench_listener
+};
+
+const uloop_listener_id_t uloop_listener_table[ULOOP_LISTENER_TABLE_SIZE] = {
+	0, ULOOP_LISTENER_NONE
+};
+
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {
+	[0 ... (ULOOP_EVENT_COUNT - 1)] = 0
+};
+
+uint32_t bench_systick;
+
+static uint8_t tx[BENCH_BUFFER];
+static uint8_t rx[BENCH_BUFFER];
+static int ack_fd;
+static uint64_t wire_bytes;
+static volatile uint32_t sink;
+
+static void bench_listener(uloop_event_t event, const void* data, uint32_t size) {
+	if (event == DONE_EVENT) {
+		// every event before it was dispatched
+		ssize_t written = write(ack_fd, "", 1);
+		(void) written;
+	} else {
+		sink += ((const uint8_t*) data)[size - 1];
+	}
+}
+
+static int32_t pipe_write(void* context, const uint8_t* data, uint32_t size) {
+	ssize_t written = write(*((int*) context), data, size);
+	wire_bytes += (written > 0) ? (uint64_t) written : 0;
+	return (int32_t) written;
+}
+
+static int32_t pipe_read(void* context, uint8_t* data, uint32_t size) {
+	return (int32_t) read(*((int*) context), data, size);
+}
+
+static void stream_init(uloop_stream_t* stream, int* fd, uint32_t batch_size) {
+	uloop_stream_config_t config;
+	memset(&config, 0, sizeof(config));
+	config.write = pipe_write;
+	config.read = pipe_read;
+	config.context = fd;
+	config.tx_buffer = tx;
+	config.tx_size = sizeof(tx);
+	config.rx_buffer = rx;
+	config.rx_size = sizeof(rx);
+	config.batch_size = batch_size;
+	config.flush_ticks = UINT32_MAX;
+	uloop_stream_init(stream, &config);
+}
+
+static void peer(int fd) {
+	uloop_stream_t stream;
+	uloop_init();
+	stream_init(&stream, &fd, 0);
+	// a closed pipe ends the run
+	while (uloop_stream_poll(&stream)) {
+		uloop_run_until_idle();
+	}
+}
+
+static void bench_batch(int fd, int ack, uint32_t batch_size) {
+	uloop_stream_t stream;
+	uint8_t data[BENCH_DATA_SIZE];
+	char done;
+	for (uint32_t i = 0; i < BENCH_DATA_SIZE; i++) {
+		data[i] = i;
+	}
+	stream_init(&stream, &fd, batch_size);
+	wire_bytes = 0;
+	uint64_t start = bench_time_ns();
+	for (uint32_t i = 0; i < BENCH_EVENTS; i++) {
+		uloop_stream_send(&stream, DATA_EVENT, data, sizeof(data));
+	}
+	uloop_stream_send(&stream, DONE_EVENT, NULL, 0);
+	uloop_stream_flush(&stream);
+	if (read(ack, &done, 1) != 1) {
+		bench_fail("ack");
+	}
+	uint64_t total = bench_time_ns() - start;
+	printf(
+		"{\"bench\": \"stream\", \"batch_size\": %u, \"data_size\": %u, \"events_per_s\": %.0f, \"mb_per_s\": %.1f, "
+		"\"frames\": %u, \"wire_bytes_per_event\": %.2f}\n",
+		(unsigned) batch_size, (unsigned) BENCH_DATA_SIZE,
+		(BENCH_EVENTS * 1e9) / total,
+		(BENCH_EVENTS * BENCH_DATA_SIZE * 1e3) / total,
+		(unsigned) stream.stats.frames_sent,
+		(double) wire_bytes / (BENCH_EVENTS + 1)
+	);
+}
+
+int main(void) {
+	static const uint32_t batches[] = {0, 64, 256, 1024, 4096};
+	int link[2];
+	int acks[2];
+	if ((pipe(link) != 0) || (pipe(acks) != 0)) {
+		bench_fail("pipe");
+	}
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(link[1]);
+		close(acks[0]);
+		ack_fd = acks[1];
+		peer(link[0]);
+		return 0;
+	}
+	close(link[0]);
+	close(acks[1]);
+	for (uint32_t i = 0; i < (sizeof(batches) / sizeof(batches[0])); i++) {
+		bench_batch(link[1], acks[0], batches[i]);
+	}
+	close(link[1]);
+	waitpid(pid, NULL, 0);
+	return 0;
+}
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: MIT
+
+/*
+ * Timer listener cost versus timer count. Every timer owns its own timeout
+ * event and is restarted with a random period from its listener, on top of
+ * that a few random timers are restarted every tick to model protocol
+ * timers that are refreshed by traffic before they expire.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "uloop.h"
+#include "uloop_timer.h"
+#include "uloop_platform.h"
+#include "uloop_listeners.h"
+
+#define BENCH_TICKS        100000
+#define BENCH_MAX_PERIOD   1000
+#define BENCH_RESTARTS     4
+
+#define IDS_1(x)      (x)
+#define IDS_10(x)     IDS_1(x), IDS_1(x + 1), IDS_1(x + 2), IDS_1(x + 3), IDS_1(x + 4), \
+                      IDS_1(x + 5), IDS_1(x + 6), IDS_1(x + 7), IDS_1(x + 8), IDS_1(x + 9)
+#define IDS_100(x)    IDS_10(x), IDS_10(x + 10), IDS_10(x + 20), IDS_10(x + 30), IDS_10(x + 40), \
+                      IDS_10(x + 50), IDS_10(x + 60), IDS_10(x + 70), IDS_10(x + 80), IDS_10(x + 90)
+#define IDS_1000(x)   IDS_100(x), IDS_100(x + 100), IDS_100(x + 200), IDS_100(x + 300), IDS_100(x + 400), \
+                      IDS_100(x + 500), IDS_100(x + 600), IDS_100(x + 700), IDS_100(x + 800), IDS_100(x + 900)
+#define IDS_10000(x)  IDS_1000(x), IDS_1000(x + 1000), IDS_1000(x + 2000), IDS_1000(x + 3000), IDS_1000(x + 4000), \
+                      IDS_1000(x + 5000), IDS_1000(x + 6000), IDS_1000(x + 7000), IDS_1000(x + 8000), IDS_1000(x + 9000)
+#define IDS__(count)  IDS_##count
+#define IDS_(count)   IDS__(count)
+
+#ifdef ULOOP_TIMER_HEAP
+#define BENCH_BACKEND "heap"
+#else
+#define BENCH_BACKEND "scan"
+#endif
+
+const uloop_listener_t uloop_listeners[ULOOP_LISTENER_COUNT] = {
+	bench_update_listener,
+	bench_timeout_listener
+};
+
+const uloop_listener_id_t uloop_listener_table[ULOOP_LISTENER_TABLE_SIZE] = {
+	0, ULOOP_LISTENER_NONE,
+	1, ULOOP_LISTENER_NONE
+};
+
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {
+	0, [1 ... BENCH_TIMER_COUNT] = 2
+};
+
+const uloop_event_t uloop_timer_events[ULOOP_TIMER_COUNT] = {
+	IDS_(BENCH_TIMER_COUNT)(E_TIMEOUT_FIRST)
+};
+
+uint32_t bench_systick;
+
+static uint64_t seed = 1;
+static uint64_t update_time;
+static uint32_t updates;
+static uint32_t expired;
+
+static uint32_t xorshift32(void) {
+	uint64_t x = seed;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	seed = x;
+	return (uint32_t) ((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void restart(uloop_timer_t timer) {
+	uloop_timer_start(timer, 1 + (xorshift32() % BENCH_MAX_PERIOD));
+}
+
+void bench_update_listener(uloop_event_t event) {
+	uint64_t start = bench_time_ns();
+	uloop_timer_listener(event);
+	update_time += bench_time_ns() - start;
+	updates += 1;
+}
+
+void bench_timeout_listener(uloop_event_t event) {
+	expired += 1;
+	restart(event - E_TIMEOUT_FIRST);
+}
+
+int main(void) {
+	uloop_init();
+	uloop_timer_init(bench_systick);
+	for (uint32_t i = 0; i < ULOOP_TIMER_COUNT; i++) {
+		restart(i);
+	}
+	uint64_t start = bench_time_ns();
+	for (uint32_t tick = 1; tick <= BENCH_TICKS; tick++) {
+		bench_systick = tick;
+		uloop_timer_update(tick);
+		while (uloop_run()) {
+			continue;
+		}
+		for (uint32_t i = 0; i < BENCH_RESTARTS; i++) {
+			restart(xorshift32() % ULOOP_TIMER_COUNT);
+		}
+	}
+	uint64_t total = bench_time_ns() - start;
+	printf(
+		"{\"bench\": \"timer\", \"backend\": \"%s\", \"timers\": %u, \"ticks\": %u, \"updates\": %u, \"expired\": %u, "
+		"\"ns_per_tick\": %.1f, \"ns_per_update\": %.1f, \"ns_per_expiry\": %.1f}\n",
+		BENCH_BACKEND, (unsigned) ULOOP_TIMER_COUNT, (unsigned) BENCH_TICKS, (unsigned) updates, (unsigned) expired,
+		(double) total / BENCH_TICKS,
+		(double) update_time / (updates ? updates : 1),
+		(double) update_time / (expired ? expired : 1)
+	);
+	return 0;
+}
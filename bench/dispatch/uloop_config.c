@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: MIT
+
+/* what uloop_config.c.template emits for the dispatch benchmark, in both dispatch modes */
+
+#include "uloop.h"
+#include "uloop_listeners.h"
+#ifdef ULOOP_DISPATCH_SWITCH
+#include "uloop_dispatch.h"
+#endif
+
+const uloop_listener_t uloop_listeners[ULOOP_LISTENER_COUNT] = {
+	bench_listener_a,
+	bench_listener_b,
+	bench_listener_c,
+	bench_listener_d
+};
+
+#ifdef ULOOP_DISPATCH_SWITCH
+
+void uloop_dispatch_generated(uloop_event_t event, const void* data, uint32_t size) {
+	switch (event) {
+		case 0:
+		case 4:
+		case 8:
+		case 12:
+			uloop_execute(0, bench_listener_a, event, data, size);
+			break;
+		case 1:
+		case 5:
+		case 9:
+		case 13:
+			uloop_execute(1, bench_listener_b, event, data, size);
+			uloop_execute(2, bench_listener_c, event, data, size);
+			break;
+		case 2:
+		case 6:
+		case 10:
+		case 14:
+			uloop_execute(2, bench_listener_c, event, data, size);
+			break;
+		case 3:
+		case 7:
+		case 11:
+		case 15:
+			uloop_execute(3, bench_listener_d, event, data, size);
+			uloop_execute(0, bench_listener_a, event, data, size);
+			break;
+		default:
+			(void) data;
+			(void) size;
+			break;
+	}
+}
+
+#else
+
+/* every event has its own row, as generated */
+const uloop_listener_id_t uloop_listener_table[ULOOP_LISTENER_TABLE_SIZE] = {
+	0, ULOOP_LISTENER_NONE,
+	1, 2, ULOOP_LISTENER_NONE,
+	2, ULOOP_LISTENER_NONE,
+	3, 0, ULOOP_LISTENER_NONE,
+	0, ULOOP_LISTENER_NONE,
+	1, 2, ULOOP_LISTENER_NONE,
+	2, ULOOP_LISTENER_NONE,
+	3, 0, ULOOP_LISTENER_NONE,
+	0, ULOOP_LISTENER_NONE,
+	1, 2, ULOOP_LISTENER_NONE,
+	2, ULOOP_LISTENER_NONE,
+	3, 0, ULOOP_LISTENER_NONE,
+	0, ULOOP_LISTENER_NONE,
+	1, 2, ULOOP_LISTENER_NONE,
+	2, ULOOP_LISTENER_NONE,
+	3, 0, ULOOP_LISTENER_NONE
+};
+
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {
+	0, 2, 5, 7, 10, 12, 15, 17, 20, 22, 25, 27, 30, 32, 35, 37
+};
+
+#endif
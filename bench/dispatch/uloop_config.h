@@ -0,0 +1,14 @@
+#pragma once
+
+#define ULOOP_EVENT_QUEUE_SIZE    1024
+#define ULOOP_DATA_QUEUE_SIZE     0
+#define ULOOP_LISTENER_TIME_LIMIT 0
+#define ULOOP_METADATA_NAME_SIZE  4
+
+#define ULOOP_LISTENER_COUNT      4
+#define ULOOP_LISTENER_TABLE_SIZE 40
+#define ULOOP_EVENT_COUNT         16
+
+#ifdef BENCH_DISPATCH_SWITCH
+#define ULOOP_DISPATCH_SWITCH
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "uloop.h"
+
+extern void bench_listener_a(uloop_event_t event);
+extern void bench_listener_b(uloop_event_t event);
+extern void bench_listener_c(uloop_event_t event);
+extern void bench_listener_d(uloop_event_t event);
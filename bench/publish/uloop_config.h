@@ -0,0 +1,8 @@
+#define ULOOP_EVENT_QUEUE_SIZE    1024
+#define ULOOP_DATA_QUEUE_SIZE     BENCH_DATA_QUEUE_SIZE
+#define ULOOP_LISTENER_TIME_LIMIT 0
+#define ULOOP_METADATA_NAME_SIZE  4
+
+#define ULOOP_LISTENER_COUNT      1
+#define ULOOP_LISTENER_TABLE_SIZE 2
+#define ULOOP_EVENT_COUNT         BENCH_EVENT_COUNT
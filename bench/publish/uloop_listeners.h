@@ -0,0 +1,9 @@
+#pragma once
+
+#include "uloop.h"
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+extern void bench_listener(uloop_event_t event, const void* data, uint32_t size);
+#else
+extern void bench_listener(uloop_event_t event);
+#endif
@@ -0,0 +1,11 @@
+#define ULOOP_EVENT_QUEUE_SIZE    1024
+#define ULOOP_DATA_QUEUE_SIZE     0
+#define ULOOP_LISTENER_TIME_LIMIT 0
+#define ULOOP_METADATA_NAME_SIZE  4
+
+#define ULOOP_LISTENER_COUNT      2
+#define ULOOP_LISTENER_TABLE_SIZE 4
+#define ULOOP_EVENT_COUNT         (BENCH_TIMER_COUNT + 1)
+
+#define E_ULOOP_TIMER_UPDATE      0
+#define E_TIMEOUT_FIRST           1
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "uloop.h"
+
+extern void uloop_timer_listener(uloop_event_t event);
+extern void bench_update_listener(uloop_event_t event);
+extern void bench_timeout_listener(uloop_event_t event);
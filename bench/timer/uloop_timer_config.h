@@ -0,0 +1,3 @@
+#pragma once
+
+#define ULOOP_TIMER_COUNT BENCH_TIMER_COUNT
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "uloop.h"
+
+extern uint32_t bench_systick;
+
+static inline uint64_t bench_time_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+/* time stamp counter where available, nanoseconds otherwise */
+#if defined(__x86_64__) || defined(__i386__)
+#define BENCH_CYCLES_UNIT "cycles"
+#else
+#define BENCH_CYCLES_UNIT "ns"
+#endif
+
+static inline uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return bench_time_ns();
+#endif
+}
+
+static inline void bench_fail(const char* reason) {
+	fprintf(stderr, "uloop error: %s\n", reason);
+	abort();
+}
+
+/* error reporting */
+#define ULOOP_ERROR_EQOVF()        bench_fail("eqOVF")
+#define ULOOP_ERROR_DQOVF()        bench_fail("dqOVF")
+#define ULOOP_ERROR_DQCORR()       bench_fail("dqCORR")
+#define ULOOP_ERROR_TMO(time_us)   bench_fail("tmo")
+
+/* development asserts are compiled out, as in a release build */
+#define ULOOP_DEV_ASSERT(cond)     do { (void) sizeof(cond); } while (0)
+
+/* single threaded host, a compiler barrier is enough */
+#define ULOOP_ATOMIC_BLOCK_ENTER() __asm__ __volatile__ ("" ::: "memory")
+#define ULOOP_ATOMIC_BLOCK_LEAVE() __asm__ __volatile__ ("" ::: "memory")
+
+/* listener timing is not measured */
+#define ULOOP_TIMER_START()        do {} while (0)
+#define ULOOP_TIMER_STOP()         0
+
+#define ULOOP_SYSTICK()            bench_systick
+#define ULOOP_TIMESTAMP()          ((uint32_t) bench_time_ns())
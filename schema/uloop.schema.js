@@ -7,17 +7,49 @@
 			metadataNameSize: "number",
 			metadataEnabled: "boolean",
 			statisticsEnabled: "boolean",
+			"statisticsBuckets?": "number",
+			"statisticsSampleRate?": "number",
+			"lockFreeQueue?": "boolean",
+			"latencyBuckets?": "number",
+			"traceSize?": "number",
+			"runForEnabled?": "boolean",
+			"syncDepth?": "number",
+			"mailboxSize?": "number",
+			"mailboxDataSize?": "number",
 			_strict: true
 		},
 		events: [{
 			name: "string",
 			"metadata?": "string",
+			"priority?": "number",
+			"coalesce?": "boolean",
+			"coalesceDataSize?": "number",
+			"overflow?": "string",
+			"reserve?": "number",
 			_strict: true
 		}, "+"],
 		listeners: [{
 			function: "string",
 			"metadata?": "string",
+			"enabled?": "boolean",
 			events: ["string", "*"],
+			"syncEvents?": ["string", "+"],
+			"instance?": "string",
+			"parallel?": "boolean",
+			_strict: true
+		}, "+"],
+		"producers?": ["string", "+"],
+		"instances?": ["string", "+"],
+		"dispatch?": "string",
+		"subscriptions?": "boolean",
+		"slabs?": [{
+			size: "number",
+			count: "number",
+			_strict: true
+		}, "+"],
+		"priorities?": [{
+			eventQueueSize: "number",
+			"dataQueueSize?": "number",
 			_strict: true
 		}, "+"],
 		prefix: "string"
@@ -3,8 +3,14 @@
 		timers: [{
 			name: "string",
 			event: "string",
+			"period?": "number",
 			_strict: true
 		}, "*"],
+		"producer?": "string",
+		"backend?": "string",
+		"periodic?": "boolean",
+		"poolSize?": "number",
+		"poolDataSize?": "number",
 		prefix: "string"
 	}
 })
@@ -0,0 +1,173 @@
+#!/usr/bin/env node
+// SPDX-License-Identifier: MIT
+
+/*
+ * Decodes a memory dump holding the uloop_trace ring into the Chrome trace
+ * event format, which is also read by Perfetto (https://ui.perfetto.dev).
+ *
+ * usage: uloop_trace.js dump.bin [options] > trace.json
+ *
+ *   --event-names file     dump of uloop_event_names
+ *   --listener-names file  dump of uloop_listener_names
+ *   --name-size n          metadataNameSize of the configuration
+ *   --tick-us x            duration of one ULOOP_TIMESTAMP() tick in us, 1 by default
+ *
+ * The dump may be a complete RAM image, the ring is found by its magic
+ * number. A little-endian target is assumed.
+ */
+
+const fs = require('fs')
+
+const TRACE_MAGIC = 0x52544C55
+const RECORD_SIZE = 8
+
+const PUBLISH = 0
+const PRE_DISPATCH = 1
+const POST_DISPATCH = 2
+const PRE_EXECUTE = 3
+const POST_EXECUTE = 4
+
+const TID_LOOP = 1
+const TID_PUBLISH = 2
+
+function fail(message) {
+	process.stderr.write(`uloop_trace: ${message}\n`)
+	process.exit(1)
+}
+
+function parseArgs(argv) {
+	const args = {dump: null, eventNames: null, listenerNames: null, nameSize: 0, tickUs: 1}
+	for (let i = 0; i < argv.length; i++) {
+		const value = argv[i + 1]
+		switch (argv[i]) {
+			case '--event-names':
+				args.eventNames = value
+				i += 1
+				break
+			case '--listener-names':
+				args.listenerNames = value
+				i += 1
+				break
+			case '--name-size':
+				args.nameSize = parseInt(value, 10)
+				i += 1
+				break
+			case '--tick-us':
+				args.tickUs = parseFloat(value)
+				i += 1
+				break
+			default:
+				if (argv[i].startsWith('--') || args.dump) {
+					fail(`unexpected argument '${argv[i]}'`)
+				}
+				args.dump = argv[i]
+		}
+	}
+	if (!args.dump) {
+		fail('no dump file given')
+	}
+	if ((args.eventNames || args.listenerNames) && !(args.nameSize > 0)) {
+		fail('--name-size is required together with names')
+	}
+	if (!(args.tickUs > 0)) {
+		fail('invalid --tick-us')
+	}
+	return args
+}
+
+function readNames(file, size) {
+	const names = []
+	if (file) {
+		const buffer = fs.readFileSync(file)
+		for (let offset = 0; (offset + size) <= buffer.length; offset += size) {
+			const raw = buffer.subarray(offset, offset + size)
+			const end = raw.indexOf(0)
+			names.push(raw.subarray(0, end < 0 ? size : end).toString('latin1'))
+		}
+	}
+	return names
+}
+
+/* returns the records in the order they were written, oldest first */
+function readRing(buffer) {
+	let base = -1
+	for (let offset = 0; (offset + 12) <= buffer.length; offset += 4) {
+		if (buffer.readUInt32LE(offset) == TRACE_MAGIC) {
+			base = offset
+			break
+		}
+	}
+	if (base < 0) {
+		fail('no uloop_trace found in dump')
+	}
+	const size = buffer.readUInt32LE(base + 4)
+	const head = buffer.readUInt32LE(base + 8)
+	if ((size == 0) || (size & (size - 1)) || ((base + 12 + (size * RECORD_SIZE)) > buffer.length)) {
+		fail('uloop_trace header is corrupted or the dump is truncated')
+	}
+	const count = Math.min(head, size)
+	const records = []
+	for (let i = head - count; i != head; i = (i + 1) >>> 0) {
+		const offset = base + 12 + ((i & (size - 1)) * RECORD_SIZE)
+		records.push({
+			stamp: buffer.readUInt32LE(offset),
+			event: buffer.readUInt16LE(offset + 4),
+			listener: buffer.readUInt8(offset + 6),
+			phase: buffer.readUInt8(offset + 7)
+		})
+	}
+	return records
+}
+
+function convert(records, eventNames, listenerNames, tickUs) {
+	const eventName = id => eventNames[id] || `event ${id}`
+	const listenerName = id => listenerNames[id] || `listener ${id}`
+	const trace = [
+		{name: 'thread_name', ph: 'M', pid: 1, tid: TID_LOOP, args: {name: 'uloop_run'}},
+		{name: 'thread_name', ph: 'M', pid: 1, tid: TID_PUBLISH, args: {name: 'publish'}}
+	]
+	// spans still open on the loop track, the oldest records may end spans that began before the ring start
+	const open = []
+	let time = 0
+	let previous = records.length ? records[0].stamp : 0
+	for (const record of records) {
+		// the stamp is taken after the record is claimed, an interrupt in between can make it go back slightly
+		time += (record.stamp - previous) | 0
+		previous = record.stamp
+		const ts = time * tickUs
+		const args = {event: eventName(record.event)}
+		switch (record.phase) {
+			case PUBLISH:
+				trace.push({name: eventName(record.event), cat: 'publish', ph: 'i', s: 't', ts, pid: 1, tid: TID_PUBLISH})
+				break
+			case PRE_DISPATCH:
+				open.push(PRE_DISPATCH)
+				trace.push({name: eventName(record.event), cat: 'dispatch', ph: 'B', ts, pid: 1, tid: TID_LOOP})
+				break
+			case PRE_EXECUTE:
+				open.push(PRE_EXECUTE)
+				trace.push({name: listenerName(record.listener), cat: 'execute', ph: 'B', ts, pid: 1, tid: TID_LOOP, args})
+				break
+			case POST_DISPATCH:
+			case POST_EXECUTE:
+				if (open.length && (open[open.length - 1] == record.phase - 1)) {
+					open.pop()
+					trace.push({ph: 'E', ts, pid: 1, tid: TID_LOOP})
+				}
+				break
+			default:
+				// a record that was being written when the dump was taken
+				break
+		}
+	}
+	while (open.pop() !== undefined) {
+		trace.push({ph: 'E', ts: time * tickUs, pid: 1, tid: TID_LOOP})
+	}
+	return {traceEvents: trace, displayTimeUnit: 'ns'}
+}
+
+const args = parseArgs(process.argv.slice(2))
+const records = readRing(fs.readFileSync(args.dump))
+const eventNames = readNames(args.eventNames, args.nameSize)
+const listenerNames = readNames(args.listenerNames, args.nameSize)
+process.stdout.write(JSON.stringify(convert(records, eventNames, listenerNames, args.tickUs), null, '\t') + '\n')
@@ -4,8 +4,7 @@
 
 #include "uloop.h"
 #include "uloop_platform.h"
-
-#define ULOOP_HOOK_NULL  do { /* empty */ } while (false)
+#include "uloop_dispatch.h"
 
 #ifndef ULOOP_HOOK_INIT
 #define ULOOP_HOOK_INIT()                                    ULOOP_HOOK_NULL
@@ -15,6 +14,10 @@
 #define ULOOP_HOOK_PUBLISH(event, data, size)                ULOOP_HOOK_NULL
 #endif
 
+#ifndef ULOOP_HOOK_POST_PUBLISH
+#define ULOOP_HOOK_POST_PUBLISH(event, data, size)           ULOOP_HOOK_NULL
+#endif
+
 #ifndef ULOOP_HOOK_PRE_DISPATCH
 #define ULOOP_HOOK_PRE_DISPATCH(event, data, size)           ULOOP_HOOK_NULL
 #endif
@@ -23,25 +26,235 @@
 #define ULOOP_HOOK_POST_DISPATCH(event, data, size)          ULOOP_HOOK_NULL
 #endif
 
-#ifndef ULOOP_HOOK_PRE_EXECUTE
-#define ULOOP_HOOK_PRE_EXECUTE(listener, event, data, size)  ULOOP_HOOK_NULL
+/* ULOOP_HOOK_PRE_EXECUTE and ULOOP_HOOK_POST_EXECUTE defaults are in uloop_dispatch.h */
+
+/* ULOOP_HOOK_IDLE has no default, the empty queue is not checked again when it is not defined */
+
+#ifdef ULOOP_LATENCY_BUCKETS
+#define EVENT_QUEUE_STAMP  , .stamp = ULOOP_TIMESTAMP()
+#else
+#define EVENT_QUEUE_STAMP
+#endif
+
+#ifdef ULOOP_SLAB_COUNT
+#define EVENT_QUEUE_BLOCK  , .block = 0xFFFF
+#else
+#define EVENT_QUEUE_BLOCK
 #endif
 
-#ifndef ULOOP_HOOK_POST_EXECUTE
-#define ULOOP_HOOK_POST_EXECUTE(listener, event, data, size) ULOOP_HOOK_NULL
+#if (ULOOP_DATA_QUEUE_SIZE > 0) && (ULOOP_EVENT_COUNT > 255)
+#define EVENT_QUEUE_ABORTED_INIT   , .aborted = 0
+#define EVENT_QUEUE_ABORT(item)    ((item).aborted = 1)
+#define EVENT_QUEUE_ABORTED(item)  ((item).aborted != 0)
+#else
+#define EVENT_QUEUE_ABORTED_INIT
+#define EVENT_QUEUE_ABORT(item)    ((item).id = ULOOP_EVENT_NONE)
+#define EVENT_QUEUE_ABORTED(item)  ((item).id == ULOOP_EVENT_NONE)
 #endif
 
 #if ULOOP_DATA_QUEUE_SIZE > 0
-#define EVENT_QUEUE_ITEM(event, _size) (uloop_event_queue_item_t) {.id = event, .size = (uint8_t) _size}
+#define EVENT_QUEUE_ITEM(event, _size) (uloop_event_queue_item_t) {.id = event EVENT_QUEUE_ABORTED_INIT, .size = (uloop_data_size_t) _size EVENT_QUEUE_BLOCK EVENT_QUEUE_STAMP}
+#else
+#define EVENT_QUEUE_ITEM(event, size) (uloop_event_queue_item_t) {.id = event EVENT_QUEUE_STAMP}
+#endif
+
+#if (defined(ULOOP_LOCK_FREE_QUEUE) + defined(ULOOP_PRODUCER_COUNT) + defined(ULOOP_PRIORITY_COUNT)) > 1
+#error "only one of lockFreeQueue, producers and priorities can be used"
+#endif
+
+#if (ULOOP_DATA_QUEUE_SIZE > 0) && (ULOOP_EVENT_COUNT > 256)
+#error "at most 256 events are supported with the data queue"
+#endif
+
+#if defined(ULOOP_SLAB_COUNT) && (defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT) || defined(ULOOP_PRIORITY_COUNT))
+#error "slabs can not be used together with lockFreeQueue, producers or priorities"
+#endif
+
+#if (ULOOP_INSTANCE_COUNT > 1) && (defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT) || defined(ULOOP_PRIORITY_COUNT))
+#error "instances can not be used together with lockFreeQueue, producers or priorities"
+#endif
+
+#if (ULOOP_INSTANCE_COUNT > 1) && defined(ULOOP_COALESCE_DATA_SIZE)
+#error "instances can not be used together with coalesceDataSize"
+#endif
+
+#if defined(ULOOP_COALESCE) && defined(ULOOP_PRODUCER_COUNT)
+#error "coalescing events can not be used together with producers"
+#endif
+
+#if defined(ULOOP_SMP) && defined(ULOOP_PRIORITY_COUNT)
+#error "priorities can not be used on platforms with publishers on other cores"
+#endif
+
+#if (ULOOP_INSTANCE_COUNT > 1) && (ULOOP_MAILBOX_SIZE & (ULOOP_MAILBOX_SIZE - 1))
+#error "ULOOP_MAILBOX_SIZE must be a power of two"
+#endif
+
+#if defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT) || defined(ULOOP_SLAB_COUNT) || (ULOOP_INSTANCE_COUNT > 1)
+#define ATOMIC_LOAD(ptr)                   __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(ptr, value)           __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define ATOMIC_CAS(ptr, expected, desired) \
+	__atomic_compare_exchange_n(ptr, expected, desired, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+#endif
+
+/*
+ * Indexes of the critical section queue that the loop reads or writes outside
+ * of the critical section. On a single core the critical section is enough,
+ * when publishers run on other cores (ULOOP_SMP) the accesses are ordered.
+ */
+#ifdef ULOOP_SMP
+#define SHARED_LOAD(ptr)          __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define SHARED_STORE(ptr, value)  __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
 #else
-#define EVENT_QUEUE_ITEM(event, size) (uloop_event_queue_item_t) {.id = event}
+#define SHARED_LOAD(ptr)          (*(ptr))
+#define SHARED_STORE(ptr, value)  (*(ptr) = (value))
+#endif
+
+#ifdef ULOOP_LOCK_FREE_QUEUE
+
+#if (ULOOP_EVENT_QUEUE_SIZE & (ULOOP_EVENT_QUEUE_SIZE - 1)) || (ULOOP_EVENT_QUEUE_SIZE > 32768)
+#error "lockFreeQueue requires eventQueueSize to be a power of two not greater than 32768"
+#endif
+
+#if (ULOOP_DATA_QUEUE_SIZE & (ULOOP_DATA_QUEUE_SIZE - 1)) || (ULOOP_DATA_QUEUE_SIZE > 16384)
+#error "lockFreeQueue requires dataQueueSize to be a power of two not greater than 16384"
+#endif
+
+/*
+ * Both queues are indexed by free running 16-bit counters. The event counter
+ * is kept in the lower and the data counter in the upper half of a single word
+ * so that one CAS reserves an event slot together with its data block. The
+ * consumer publishes its position the same way in the head word.
+ */
+#define COUNTER_EVENT(counter)      ((uint16_t) (counter))
+#define COUNTER_DATA(counter)       ((uint16_t) ((counter) >> 16))
+#define COUNTER_PACK(event, data)   ((uint32_t) (uint16_t) (event) | ((uint32_t) (uint16_t) (data) << 16))
+
+typedef struct {
+	uint16_t seq;
+	uloop_event_queue_item_t item;
+} event_queue_slot_t;
+
+static struct {
+	uint32_t head;
+	uint32_t tail;
+	event_queue_slot_t data[ULOOP_EVENT_QUEUE_SIZE];
+} event_queue;
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static struct {
+	uint16_t read;
+	uint32_t retained;
+	uint32_t data[ULOOP_DATA_QUEUE_SIZE / 4];
+} data_queue;
+#endif
+
+#elif defined(ULOOP_PRODUCER_COUNT)
+
+#if (ULOOP_EVENT_QUEUE_SIZE & (ULOOP_EVENT_QUEUE_SIZE - 1)) || (ULOOP_DATA_QUEUE_SIZE & (ULOOP_DATA_QUEUE_SIZE - 1))
+#error "producers require eventQueueSize and dataQueueSize to be powers of two"
+#endif
+
+/*
+ * Every producer context owns a single-producer single-consumer ring pair,
+ * the producer writes only the tail counters and the consumer only the head
+ * counters. Events are stamped with ULOOP_TIMESTAMP() when published and
+ * uloop_run merges the rings by always taking the oldest pending event.
+ * Slots are allocated at alloc, the tail is only moved up to it once no
+ * reservation of the producer is outstanding.
+ */
+typedef struct {
+	uint32_t stamp;
+	uloop_event_queue_item_t item;
+} event_queue_slot_t;
+
+typedef struct {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t alloc;
+	uint32_t reserved;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint32_t data_head;
+	uint32_t data_tail;
+	uint32_t data_read;
+	uint32_t data_retained;
+	uint32_t data[ULOOP_DATA_QUEUE_SIZE / 4];
+#endif
+	event_queue_slot_t slots[ULOOP_EVENT_QUEUE_SIZE];
+} producer_queue_t;
+
+static producer_queue_t producer_queues[ULOOP_PRODUCER_COUNT];
+static producer_queue_t* producer_selected;
+
+#elif defined(ULOOP_PRIORITY_COUNT)
+
+#if ULOOP_PRIORITY_COUNT > 32
+#error "at most 32 priority levels are supported"
+#endif
+
+/*
+ * Every priority level has its own event and data ring carved out of shared
+ * storage according to uloop_priority_levels. Bit n of priority_pending is
+ * set when level n might hold events, the bit is cleared lazily by the
+ * consumer once it finds the level empty. The consumer only sees events up
+ * to ready, which stops at the oldest outstanding reservation.
+ */
+typedef struct {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t ready;
+	uint32_t reserved;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint32_t data_head;
+	uint32_t data_tail;
+	uint32_t data_read;
+	uint32_t data_retained;
 #endif
+} priority_queue_t;
 
+static priority_queue_t priority_queues[ULOOP_PRIORITY_COUNT];
+static uloop_event_queue_item_t priority_events[ULOOP_PRIORITY_EVENT_QUEUE_SIZE];
 #if ULOOP_DATA_QUEUE_SIZE > 0
+static uint32_t priority_data[ULOOP_PRIORITY_DATA_QUEUE_SIZE / 4];
+#endif
+static uint32_t priority_pending;
+static uint32_t priority_selected;
+
+#else
+
+/*
+ * The consumer reads data at read, the producers may reuse the space up to
+ * head. Both are equal unless a listener retained a block. In the same way
+ * the consumer sees events up to ready, which stops at the oldest
+ * outstanding reservation.
+ */
+#ifdef ULOOP_SLAB_COUNT
+
+#if ULOOP_SLAB_BLOCK_COUNT >= 0xFFFF
+#error "at most 65534 slab blocks are supported"
+#endif
+
+/*
+ * With slabs the data queue ring is replaced by fixed size blocks. Every
+ * class keeps its free blocks in a lock-free stack, the head word holds the
+ * top block in the lower half and a tag in the upper half. The tag changes
+ * on every update so a CAS can not succeed on a head that was popped and
+ * pushed again in between.
+ */
+#define SLAB_NONE  0xFFFF
+
+static uint32_t slab_free_heads[ULOOP_SLAB_COUNT];
+static uint16_t slab_next[ULOOP_SLAB_BLOCK_COUNT];
+static uint8_t slab_retained[ULOOP_SLAB_BLOCK_COUNT];
+static uint32_t slab_storage[ULOOP_SLAB_DATA_SIZE / 4];
+
+#elif ULOOP_DATA_QUEUE_SIZE > 0
 static struct {
 	uint32_t head;
 	uint32_t tail;
 	uint32_t end;
+	uint32_t read;
+	uint32_t retained;
 	uint8_t data[ULOOP_DATA_QUEUE_SIZE];
 } data_queue;
 #endif
@@ -49,206 +262,2120 @@ static struct {
 static struct {
 	uint32_t head;
 	uint32_t tail;
+	uint32_t ready;
+	uint32_t reserved;
+#ifdef ULOOP_OVERFLOW_REPLACE
+	uint32_t read;
+#endif
 	uloop_event_queue_item_t data[ULOOP_EVENT_QUEUE_SIZE];
 } event_queue;
 
-uloop_listener_id_t uloop_listener_active;
+#ifdef ULOOP_OVERFLOW_RESERVES
+/*
+ * Slots kept free for the events with a reserve. Every queue slot remembers
+ * the reserve it was counted against, so aborted reservations hand their
+ * slot back as well.
+ */
+#define RESERVE_NONE  0xFF
 
-#ifdef ULOOP_STATISTICS_ENABLED
-uloop_event_stats_t uloop_event_stats[ULOOP_EVENT_COUNT] = {0};
-uloop_listenter_stats_t uloop_listener_stats[ULOOP_LISTENER_COUNT] = {0};
+static uint8_t reserve_owner[ULOOP_EVENT_QUEUE_SIZE];
+static uint16_t reserve_queued[ULOOP_OVERFLOW_RESERVES];
+static uint32_t reserve_free;
 #endif
 
-static inline bool event_queue_empty() {
-	return event_queue.head == event_queue.tail;
-}
+struct uloop_ctx {
+	uint32_t index;
+#if ULOOP_INSTANCE_COUNT > 1
+	uint32_t next;  /* sender whose mailbox is read first */
+#endif
+};
 
-static inline void event_queue_push(uloop_event_t event, uint32_t size) {
-	ULOOP_DEV_ASSERT((ULOOP_DATA_QUEUE_SIZE == 0) || (size < 256));
-	event_queue.data[event_queue.tail] = EVENT_QUEUE_ITEM(event, size);
-	uint32_t tail = (event_queue.tail + 1) % ULOOP_EVENT_QUEUE_SIZE;
-	if (tail == event_queue.head) {
-		ULOOP_ERROR_EQOVF();
-	}
-	event_queue.tail = tail;
-}
+static uloop_ctx_t instances[ULOOP_INSTANCE_COUNT];
 
-static inline uloop_event_queue_item_t event_queue_top() {
-	return event_queue.data[event_queue.head];
-}
+#if ULOOP_INSTANCE_COUNT > 1
+/*
+ * The other instances are reached through mailboxes, single producer single
+ * consumer rings of fixed size messages. Every ordered pair of instances has
+ * its own mailbox, a sender only competes with its own interrupts there and
+ * the receiver takes messages without a lock. Instance 0 queues its own
+ * events, the mailbox from itself to itself does not exist.
+ */
+typedef struct {
+	uloop_event_t event;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uloop_data_size_t size;
+#endif
+#ifdef ULOOP_LATENCY_BUCKETS
+	uint32_t stamp;
+#endif
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint32_t data[(ULOOP_MAILBOX_DATA_SIZE + 3) / 4];
+#endif
+} mailbox_message_t;
 
-static inline void event_queue_pop() {
-	event_queue.head = (event_queue.head + 1) % ULOOP_EVENT_QUEUE_SIZE;
-}
+typedef struct {
+	uint32_t head;  /* written by the receiver only */
+	uint32_t tail;  /* written by the sender only */
+	mailbox_message_t messages[ULOOP_MAILBOX_SIZE];
+} mailbox_t;
+
+static mailbox_t mailboxes[(ULOOP_INSTANCE_COUNT * ULOOP_INSTANCE_COUNT) - 1];
+#endif
+
+#endif
+
+#if ULOOP_INSTANCE_COUNT > 1
+#define EVENT_INSTANCE(event)  uloop_event_instance[event]
+
+uloop_listener_id_t uloop_instance_active[ULOOP_INSTANCE_COUNT];
+#else
+#define EVENT_INSTANCE(event)  0
+
+uloop_listener_id_t uloop_listener_active;
+#endif
 
 #if ULOOP_DATA_QUEUE_SIZE > 0
-static inline const uint8_t* data_queue_top() {
-	return &data_queue.data[data_queue.head];
-}
+/* number of uloop_data_retain calls for the event being dispatched */
+static uint32_t data_retain_requests;
+#endif
 
-static uint8_t* data_queue_push(uint32_t unaligned_size) {
-	uint8_t* ret;
-	uint32_t size = (unaligned_size + 3) & (~3);
-	if (data_queue.head == data_queue.tail) {
-		ULOOP_DEV_ASSERT(size < ULOOP_DATA_QUEUE_SIZE);
-		ret = data_queue.data;
-		data_queue.head = 0;
-		data_queue.tail = size;
-	} else if (data_queue.tail > data_queue.head) {
-		uint32_t end_size = ULOOP_DATA_QUEUE_SIZE - data_queue.tail;
-		if (size < end_size) {
-			ret = &data_queue.data[data_queue.tail];
-			data_queue.tail += size;
-		} else if ((size == end_size) && (data_queue.head > 0)) {
-			ret = &data_queue.data[data_queue.tail];
-			data_queue.tail = 0;
-		} else if (size < data_queue.head) {
-			ret = data_queue.data;
-			data_queue.end = data_queue.tail;
-			data_queue.tail = size;
-		} else {
-			ret = NULL;
-		}
-	} else {
-		if (size < (data_queue.head - data_queue.tail)) {
-			ret = &data_queue.data[data_queue.tail];
-			data_queue.tail += size;
-		} else {
-			ret = NULL;
-		}
-	}
-	return ret;
-}
+#ifdef ULOOP_OVERFLOW
+/*
+ * uloop_run* calls in progress in each instance, the idle hook included. A
+ * blocking publish runs the loop itself, which is only allowed while none
+ * is in progress, that is from the main context between the loop calls.
+ */
+static uint32_t run_depth[ULOOP_INSTANCE_COUNT];
+#define RUN_ENTER(instance)  SHARED_STORE(&run_depth[instance], run_depth[instance] + 1)
+#define RUN_LEAVE(instance)  SHARED_STORE(&run_depth[instance], run_depth[instance] - 1)
+#define RUN_ACTIVE(instance) (SHARED_LOAD(&run_depth[instance]) != 0)
+#else
+#define RUN_ENTER(instance)
+#define RUN_LEAVE(instance)
+#define RUN_ACTIVE(instance) false
+#endif
 
-static void data_queue_pop(uint32_t unaligned_size) {
-	uint32_t size = (unaligned_size + 3) & (~3);
-	ULOOP_ATOMIC_BLOCK_ENTER();
-	ULOOP_DEV_ASSERT(data_queue.head != data_queue.tail);
-	data_queue.head += size;
-	if (data_queue.head > data_queue.end) {
-		data_queue.head -= size;
-		ULOOP_ERROR_DQCORR();
-	} else if (data_queue.head == data_queue.end) {
-		data_queue.head = 0;
-		data_queue.end = ULOOP_DATA_QUEUE_SIZE;
+#ifdef ULOOP_STATISTICS_ENABLED
+uloop_event_stats_t uloop_event_stats[ULOOP_EVENT_COUNT];
+uloop_listenter_stats_t uloop_listener_stats[ULOOP_LISTENER_COUNT];
+#ifdef ULOOP_SLAB_COUNT
+uloop_slab_stats_t uloop_slab_stats[ULOOP_SLAB_COUNT];
+#endif
+#endif
+
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+uint16_t uloop_listener_countdown[ULOOP_LISTENER_COUNT];
+#endif
+
+#ifdef ULOOP_TRACE_SIZE
+#if ULOOP_TRACE_SIZE & (ULOOP_TRACE_SIZE - 1)
+#error "traceSize must be a power of two"
+#endif
+uloop_trace_t uloop_trace;
+#endif
+
+#if defined(ULOOP_LATENCY_BUCKETS) || defined(ULOOP_STATISTICS_BUCKETS)
+uint32_t uloop_histogram_percentile(const uint16_t* histogram, uint32_t buckets, uint32_t permille) {
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < buckets; i++) {
+		total += histogram[i];
+	}
+	uint32_t rank = ((total * permille) + 999) / 1000;
+	uint32_t count = 0;
+	uint32_t bucket = 0;
+	while ((bucket < (buckets - 1)) && ((count + histogram[bucket]) < rank)) {
+		count += histogram[bucket];
+		bucket += 1;
+	}
+	uint32_t bound;
+	if (bucket == 0) {
+		bound = 0;
+	} else if (bucket == (buckets - 1)) {
+		bound = UINT32_MAX;
 	} else {
-		// do nothing
+		bound = (1UL << bucket) - 1;
 	}
-	ULOOP_ATOMIC_BLOCK_LEAVE();
+	return bound;
 }
 #endif
 
-static inline void update_listener_stats(uloop_listenter_stats_t* stats, uint32_t duration) {
-	stats->runs += 1;
-	stats->time_total += duration;
-	if (stats->time_max < duration) {
-		stats->time_max = duration;
+#ifdef ULOOP_LATENCY_BUCKETS
+uloop_event_latency_t uloop_event_latency[ULOOP_EVENT_COUNT];
+
+static inline void latency_record(uloop_event_queue_item_t event) {
+	uint32_t delay = ULOOP_TIMESTAMP() - event.stamp;
+	uloop_event_latency_t* latency = &uloop_event_latency[event.id];
+	uloop_histogram_add(latency->histogram, ULOOP_LATENCY_BUCKETS, delay);
+	if (latency->max < delay) {
+		latency->max = delay;
 	}
 }
-
-static inline void dispatch(uloop_event_t event, const void* data, uint32_t size) {
-#if ULOP_DATA_QUEUE_SIZE == 0
-	(void) data;
-	(void) size;
-#endif
-	const uloop_listener_id_t* ptr = &uloop_listener_table[uloop_listener_lut[event]];
-	while (ptr[0] != ULOOP_LISTENER_NONE) {
-		uint32_t listener = ptr[0];
-		uloop_listener_active = listener;
-		ULOOP_TIMER_START();
-		ULOOP_HOOK_PRE_EXECUTE(listener, event, data, size);
-#if ULOOP_DATA_QUEUE_SIZE > 0
-		uloop_listeners[listener](event, data, size);
-#else
-		uloop_listeners[listener](event);
 #endif
-		ULOOP_HOOK_POST_EXECUTE(listener, event, data, size);
-		uint32_t duration = ULOOP_TIMER_STOP();
-#ifdef ULOOP_STATISTICS_ENABLED
-		update_listener_stats(&uloop_listener_stats[listener], duration);
+
+#ifdef ULOOP_COALESCE
+
+/*
+ * A coalescing event is queued only when its pending bit goes from 0 to 1,
+ * the bit is cleared right before the event is dispatched. The lock-free
+ * mode has no critical sections on the publish side and instances may run
+ * on other cores, there the bit is updated with atomic operations. The
+ * producer mode avoids read-modify-write atomics and has no coalescing.
+ */
+static uint32_t coalesce_pending[(ULOOP_EVENT_COUNT + 31) / 32];
+
+#ifdef ULOOP_COALESCE_DATA_SIZE
+/* slots of the latest value events, the first word of a slot holds the data size */
+static uint32_t coalesce_data[ULOOP_COALESCE_DATA_SIZE / 4];
 #endif
-#if ULOOP_LISTENER_TIME_LIMIT > 0
-		if (duration > ULOOP_LISTENER_TIME_LIMIT) {
-			ULOOP_ERROR_TMO(duration);
-		}
+
+static inline bool coalesce_enabled(uloop_event_t event) {
+	return (uloop_coalesce_events[event / 32] & (1UL << (event % 32))) != 0;
+}
+
+/* returns false when the event is coalescing and already queued */
+static inline bool coalesce_publish(uloop_event_t event) {
+	bool queue = true;
+	if (coalesce_enabled(event)) {
+		uint32_t bit = 1UL << (event % 32);
+		uint32_t previous;
+#if defined(ULOOP_LOCK_FREE_QUEUE) || (ULOOP_INSTANCE_COUNT > 1)
+		previous = __atomic_fetch_or(&coalesce_pending[event / 32], bit, __ATOMIC_ACQ_REL);
 #else
-	(void) duration;
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		previous = coalesce_pending[event / 32];
+		coalesce_pending[event / 32] = previous | bit;
+		ULOOP_ATOMIC_BLOCK_LEAVE();
 #endif
-		uloop_listener_active = ULOOP_LISTENER_NONE;
-		ptr += 1;
+		queue = (previous & bit) == 0;
 	}
+	return queue;
 }
 
-void uloop_publish(uloop_event_t event) {
-	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+static inline void coalesce_clear(uloop_event_t event) {
+	uint32_t bit = 1UL << (event % 32);
+#if defined(ULOOP_LOCK_FREE_QUEUE) || (ULOOP_INSTANCE_COUNT > 1)
+	__atomic_fetch_and(&coalesce_pending[event / 32], ~bit, __ATOMIC_ACQ_REL);
+#else
 	ULOOP_ATOMIC_BLOCK_ENTER();
-	event_queue_push(event, 0);
+	coalesce_pending[event / 32] &= ~bit;
 	ULOOP_ATOMIC_BLOCK_LEAVE();
+#endif
 }
 
-#if ULOOP_DATA_QUEUE_SIZE > 0
-void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
-	ULOOP_HOOK_PUBLISH(event, data, size);
-	ULOOP_ATOMIC_BLOCK_ENTER();
-	event_queue_push(event, size);
-	if (size > 0) {
-		ULOOP_DEV_ASSERT(data != NULL);
-		uint8_t* ptr = data_queue_push(size);
+#ifdef ULOOP_COALESCE_DATA_SIZE
+/* stores the data of a latest value event in its slot, returns the data size left for the data queue */
+static inline uint32_t coalesce_store(uloop_event_t event, const void* data, uint32_t size) {
+	const uloop_coalesce_slot_t* slot = &uloop_coalesce_slots[event];
+	if (slot->size > 0) {
+		ULOOP_DEV_ASSERT(size <= slot->size);
+		uint32_t* ptr = &coalesce_data[slot->offset / 4];
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		ptr[0] = size;
+		memcpy(&ptr[1], data, size);
 		ULOOP_ATOMIC_BLOCK_LEAVE();
-		if (ptr == NULL) {
-			ULOOP_ERROR_DQOVF();
-		}
-		memcpy(ptr, data, size);
-	} else {
+		size = 0;
+	}
+	return size;
+}
+
+/* copies the latest value of an event out of its slot, returns its size */
+static inline uint32_t coalesce_load(uloop_event_t event, uint32_t* buffer) {
+	uint32_t size = 0;
+	const uloop_coalesce_slot_t* slot = &uloop_coalesce_slots[event];
+	if (slot->size > 0) {
+		const uint32_t* ptr = &coalesce_data[slot->offset / 4];
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		size = ptr[0];
+		memcpy(buffer, &ptr[1], size);
 		ULOOP_ATOMIC_BLOCK_LEAVE();
 	}
+	return size;
 }
 #endif
 
-bool uloop_run() {
-	bool executed;
-	if (!event_queue_empty()) {
-		uloop_event_queue_item_t event = event_queue_top();
-#ifdef ULOOP_STATISTICS_ENABLED
-		uloop_event_stats[event.id].count += 1;
+#else
+
+static inline bool coalesce_publish(uloop_event_t event) {
+	(void) event;
+	return true;
+}
+
 #endif
-#if ULOOP_DATA_QUEUE_SIZE > 0
-		const uint8_t* data = (event.size > 0) ? data_queue_top() : NULL;
-		ULOOP_HOOK_PRE_DISPATCH(event.id, data, event.size);
-		dispatch(event.id, data, event.size);
-		ULOOP_HOOK_POST_DISPATCH(event.id, data, event.size);
-		if (event.size > 0) {
-			data_queue_pop(event.size);
+
+#ifdef ULOOP_SUBSCRIPTIONS
+
+/*
+ * Every (event, listener) pair has an enable bit at its position in
+ * uloop_listener_table, every event counts its enabled pairs. Publishing an
+ * event without enabled pairs returns before the queues are touched.
+ */
+uint32_t uloop_subscription_mask[(ULOOP_LISTENER_TABLE_SIZE + 31) / 32];
+static uint8_t subscription_active[ULOOP_EVENT_COUNT];
+
+static inline bool event_active(uloop_event_t event) {
+	return subscription_active[event] != 0;
+}
+
+/* returns the position of the pair in uloop_listener_table or of the row end when there is no such pair */
+static inline uint32_t subscription_find(uloop_listener_id_t listener, uloop_event_t event) {
+	uint32_t pair = uloop_listener_lut[event];
+	while ((uloop_listener_table[pair] != listener) && (uloop_listener_table[pair] != ULOOP_LISTENER_NONE)) {
+		pair += 1;
+	}
+	return pair;
+}
+
+static void subscription_update(uloop_listener_id_t listener, uloop_event_t event, bool enable) {
+	ULOOP_DEV_ASSERT(event < ULOOP_EVENT_COUNT);
+	uint32_t pair = subscription_find(listener, event);
+	ULOOP_DEV_ASSERT(uloop_listener_table[pair] != ULOOP_LISTENER_NONE);
+	if (uloop_listener_table[pair] != ULOOP_LISTENER_NONE) {
+		uint32_t bit = 1UL << (pair % 32);
+		uint32_t previous;
+#if defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT) || (ULOOP_INSTANCE_COUNT > 1)
+		if (enable) {
+			previous = __atomic_fetch_or(&uloop_subscription_mask[pair / 32], bit, __ATOMIC_ACQ_REL);
+		} else {
+			previous = __atomic_fetch_and(&uloop_subscription_mask[pair / 32], ~bit, __ATOMIC_ACQ_REL);
+		}
+		// only the caller that flipped the bit updates the count
+		if (((previous & bit) != 0) != enable) {
+			if (enable) {
+				__atomic_fetch_add(&subscription_active[event], 1, __ATOMIC_ACQ_REL);
+			} else {
+				__atomic_fetch_sub(&subscription_active[event], 1, __ATOMIC_ACQ_REL);
+			}
 		}
 #else
-		ULOOP_HOOK_PRE_DISPATCH(event.id, NULL, 0);
-		dispatch(event.id, NULL, 0);
-		ULOOP_HOOK_POST_DISPATCH(event.id, NULL, 0);
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		previous = uloop_subscription_mask[pair / 32];
+		if (((previous & bit) != 0) != enable) {
+			uloop_subscription_mask[pair / 32] = previous ^ bit;
+			subscription_active[event] += enable ? 1 : -1;
+		}
+		ULOOP_ATOMIC_BLOCK_LEAVE();
 #endif
-		event_queue_pop();
-		executed = true;
-	} else {
-		executed = false;
 	}
-	return executed;
 }
 
-void uloop_init() {
-	event_queue.head = 0;
-	event_queue.tail = 0;
-#if ULOOP_DATA_QUEUE_SIZE > 0
-	data_queue.head = 0;
-	data_queue.tail = 0;
-	data_queue.end = ULOOP_DATA_QUEUE_SIZE;
-#endif
-	ULOOP_HOOK_INIT();
+void uloop_listener_enable(uloop_listener_id_t listener, uloop_event_t event) {
+	subscription_update(listener, event, true);
 }
 
-uloop_event_queue_item_t uloop_event_queue_get(uint32_t offset) {
-	uloop_event_queue_item_t item = EVENT_QUEUE_ITEM(ULOOP_EVENT_NONE, 0);
-	uint32_t size = (event_queue.tail - event_queue.head) & (ULOOP_EVENT_QUEUE_SIZE - 1);
-	if (size > offset) {
-		item = event_queue.data[(event_queue.head + offset) & (ULOOP_EVENT_QUEUE_SIZE - 1)];
+void uloop_listener_disable(uloop_listener_id_t listener, uloop_event_t event) {
+	subscription_update(listener, event, false);
+}
+
+bool uloop_listener_enabled(uloop_listener_id_t listener, uloop_event_t event) {
+	ULOOP_DEV_ASSERT(event < ULOOP_EVENT_COUNT);
+	uint32_t pair = subscription_find(listener, event);
+	return (uloop_listener_table[pair] != ULOOP_LISTENER_NONE) && uloop_subscribed(pair);
+}
+
+#else
+
+static inline bool event_active(uloop_event_t event) {
+	(void) event;
+	return true;
+}
+
+#endif
+
+#if (defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT) || defined(ULOOP_PRIORITY_COUNT)) && (ULOOP_DATA_QUEUE_SIZE > 0)
+/* returns the counter at which a block of given aligned size starts, blocks never wrap */
+static inline uint32_t data_queue_start(uint32_t counter, uint32_t size, uint32_t capacity) {
+	uint32_t offset = counter & (capacity - 1);
+	if ((offset + size) > capacity) {
+		counter += capacity - offset;
 	}
+	return counter;
+}
+#endif
+
+#ifdef ULOOP_LOCK_FREE_QUEUE
+
+static inline bool event_queue_empty() {
+	uint16_t head = COUNTER_EVENT(event_queue.head);
+	return ATOMIC_LOAD(&event_queue.data[head & (ULOOP_EVENT_QUEUE_SIZE - 1)].seq) != (uint16_t) (head + 1);
+}
+
+static uint8_t* event_queue_reserve(uloop_event_t event, uint32_t unaligned_size, uint16_t* position) {
+	uint32_t head;
+	uint32_t tail;
+	uint16_t event_tail;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint32_t size = (unaligned_size + 3) & (~3);
+	uint16_t data_start;
+	uint16_t data_tail;
+	ULOOP_DEV_ASSERT((unaligned_size < 256) && (size < ULOOP_DATA_QUEUE_SIZE));
+#else
+	const uint16_t data_tail = 0;
+	(void) unaligned_size;
+#endif
+	do {
+		head = ATOMIC_LOAD(&event_queue.head);
+		tail = ATOMIC_LOAD(&event_queue.tail);
+		event_tail = COUNTER_EVENT(tail);
+		if ((uint16_t) (event_tail - COUNTER_EVENT(head)) >= ULOOP_EVENT_QUEUE_SIZE) {
+			ULOOP_ERROR_EQOVF();
+		}
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		data_start = data_queue_start(COUNTER_DATA(tail), size, ULOOP_DATA_QUEUE_SIZE);
+		data_tail = data_start + size;
+		if ((uint16_t) (data_tail - COUNTER_DATA(head)) > ULOOP_DATA_QUEUE_SIZE) {
+			ULOOP_ERROR_DQOVF();
+		}
+#endif
+	} while (!ATOMIC_CAS(&event_queue.tail, &tail, COUNTER_PACK(event_tail + 1, data_tail)));
+	event_queue.data[event_tail & (ULOOP_EVENT_QUEUE_SIZE - 1)].item = EVENT_QUEUE_ITEM(event, unaligned_size);
+	position[0] = event_tail;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	return (uint8_t*) data_queue.data + (data_start & (ULOOP_DATA_QUEUE_SIZE - 1));
+#else
+	return NULL;
+#endif
+}
+
+static inline void event_queue_commit(uint16_t position) {
+	ATOMIC_STORE(&event_queue.data[position & (ULOOP_EVENT_QUEUE_SIZE - 1)].seq, (uint16_t) (position + 1));
+}
+
+static inline uloop_event_queue_item_t event_queue_top() {
+	return event_queue.data[COUNTER_EVENT(event_queue.head) & (ULOOP_EVENT_QUEUE_SIZE - 1)].item;
+}
+
+static inline void event_queue_pop() {
+	uint32_t head = event_queue.head;
+	ATOMIC_STORE(&event_queue.head, COUNTER_PACK(COUNTER_EVENT(head) + 1, COUNTER_DATA(head)));
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static inline const uint8_t* data_queue_top(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	uint16_t start = data_queue_start(data_queue.read, size, ULOOP_DATA_QUEUE_SIZE);
+	return (const uint8_t*) data_queue.data + (start & (ULOOP_DATA_QUEUE_SIZE - 1));
+}
+
+/* hands the consumed data back to the producers */
+static inline void data_queue_release() {
+	uint32_t head = event_queue.head;
+	ATOMIC_STORE(&event_queue.head, COUNTER_PACK(COUNTER_EVENT(head), data_queue.read));
+}
+
+static void data_queue_pop(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	data_queue.read = data_queue_start(data_queue.read, size, ULOOP_DATA_QUEUE_SIZE) + size;
+	data_queue.retained += data_retain_requests;
+	data_retain_requests = 0;
+	if (data_queue.retained == 0) {
+		data_queue_release();
+	}
+}
+#endif
+
+#elif defined(ULOOP_PRODUCER_COUNT)
+
+/* selects the producer queue holding the oldest pending event */
+static inline bool event_queue_empty() {
+	producer_queue_t* selected = NULL;
+	uint32_t stamp = 0;
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		producer_queue_t* queue = &producer_queues[i];
+		if (ATOMIC_LOAD(&queue->tail) != queue->head) {
+			uint32_t item_stamp = queue->slots[queue->head & (ULOOP_EVENT_QUEUE_SIZE - 1)].stamp;
+			if ((selected == NULL) || ((int32_t) (item_stamp - stamp) < 0)) {
+				selected = queue;
+				stamp = item_stamp;
+			}
+		}
+	}
+	producer_selected = selected;
+	return selected == NULL;
+}
+
+static uint8_t* event_queue_reserve(producer_queue_t* queue, uloop_event_t event, uint32_t unaligned_size) {
+	uint8_t* ret;
+	uint32_t tail = queue->alloc;
+	if ((tail - ATOMIC_LOAD(&queue->head)) >= ULOOP_EVENT_QUEUE_SIZE) {
+		ULOOP_ERROR_EQOVF();
+	}
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint32_t size = (unaligned_size + 3) & (~3);
+	ULOOP_DEV_ASSERT((unaligned_size < 256) && (size < ULOOP_DATA_QUEUE_SIZE));
+	uint32_t start = data_queue_start(queue->data_tail, size, ULOOP_DATA_QUEUE_SIZE);
+	if (((start + size) - ATOMIC_LOAD(&queue->data_head)) > ULOOP_DATA_QUEUE_SIZE) {
+		ULOOP_ERROR_DQOVF();
+	}
+	queue->data_tail = start + size;
+	ret = (uint8_t*) queue->data + (start & (ULOOP_DATA_QUEUE_SIZE - 1));
+#else
+	(void) unaligned_size;
+	ret = NULL;
+#endif
+	event_queue_slot_t* slot = &queue->slots[tail & (ULOOP_EVENT_QUEUE_SIZE - 1)];
+	slot->item = EVENT_QUEUE_ITEM(event, unaligned_size);
+	slot->stamp = ULOOP_TIMESTAMP();
+	queue->alloc = tail + 1;
+	return ret;
+}
+
+static inline void event_queue_commit(producer_queue_t* queue) {
+	if (queue->reserved == 0) {
+		ATOMIC_STORE(&queue->tail, queue->alloc);
+	}
+}
+
+static inline uloop_event_queue_item_t event_queue_top() {
+	return producer_selected->slots[producer_selected->head & (ULOOP_EVENT_QUEUE_SIZE - 1)].item;
+}
+
+static inline void event_queue_pop() {
+	ATOMIC_STORE(&producer_selected->head, producer_selected->head + 1);
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static inline const uint8_t* data_queue_top(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	uint32_t start = data_queue_start(producer_selected->data_read, size, ULOOP_DATA_QUEUE_SIZE);
+	return (const uint8_t*) producer_selected->data + (start & (ULOOP_DATA_QUEUE_SIZE - 1));
+}
+
+static void data_queue_pop(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	producer_queue_t* queue = producer_selected;
+	queue->data_read = data_queue_start(queue->data_read, size, ULOOP_DATA_QUEUE_SIZE) + size;
+	queue->data_retained += data_retain_requests;
+	data_retain_requests = 0;
+	if (queue->data_retained == 0) {
+		ATOMIC_STORE(&queue->data_head, queue->data_read);
+	}
+}
+#endif
+
+#elif defined(ULOOP_PRIORITY_COUNT)
+
+/* selects the highest priority level holding events */
+static inline bool event_queue_empty() {
+	uint32_t pending = priority_pending;
+	while (pending != 0) {
+		uint32_t level = 31 - ULOOP_CLZ(pending);
+		const priority_queue_t* queue = &priority_queues[level];
+		if (queue->head != queue->ready) {
+			priority_selected = level;
+			return false;
+		}
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		if (queue->head == queue->ready) {
+			priority_pending &= ~(1UL << level);
+		}
+		pending = priority_pending;
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+	}
+	return true;
+}
+
+static inline uint8_t* event_queue_push(uloop_event_t event, uint32_t unaligned_size) {
+	uint8_t* ret;
+	uint32_t level = uloop_event_priority[event];
+	const uloop_priority_level_t* config = &uloop_priority_levels[level];
+	priority_queue_t* queue = &priority_queues[level];
+	if ((queue->tail - queue->head) >= config->event_queue_size) {
+		ULOOP_ERROR_EQOVF();
+	}
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint32_t size = (unaligned_size + 3) & (~3);
+	ULOOP_DEV_ASSERT(unaligned_size < 256);
+	if (size > 0) {
+		uint32_t start = data_queue_start(queue->data_tail, size, config->data_queue_size);
+		if (((start + size) - queue->data_head) > config->data_queue_size) {
+			ULOOP_ERROR_DQOVF();
+		}
+		queue->data_tail = start + size;
+		ret = (uint8_t*) priority_data + config->data_queue_offset + (start & (config->data_queue_size - 1));
+	} else {
+		ret = NULL;
+	}
+#else
+	(void) unaligned_size;
+	ret = NULL;
+#endif
+	priority_events[config->event_queue_offset + (queue->tail & (config->event_queue_size - 1))] = EVENT_QUEUE_ITEM(event, unaligned_size);
+	queue->tail += 1;
+	if (queue->reserved == 0) {
+		queue->ready = queue->tail;
+		priority_pending |= 1UL << level;
+	}
+	return ret;
+}
+
+static inline uloop_event_queue_item_t event_queue_top() {
+	const uloop_priority_level_t* config = &uloop_priority_levels[priority_selected];
+	return priority_events[config->event_queue_offset + (priority_queues[priority_selected].head & (config->event_queue_size - 1))];
+}
+
+static inline void event_queue_pop() {
+	priority_queues[priority_selected].head += 1;
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static inline const uint8_t* data_queue_top(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	const uloop_priority_level_t* config = &uloop_priority_levels[priority_selected];
+	uint32_t start = data_queue_start(priority_queues[priority_selected].data_read, size, config->data_queue_size);
+	return (const uint8_t*) priority_data + config->data_queue_offset + (start & (config->data_queue_size - 1));
+}
+
+static void data_queue_pop(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	priority_queue_t* queue = &priority_queues[priority_selected];
+	queue->data_read = data_queue_start(queue->data_read, size, uloop_priority_levels[priority_selected].data_queue_size) + size;
+	queue->data_retained += data_retain_requests;
+	data_retain_requests = 0;
+	if (queue->data_retained == 0) {
+		queue->data_head = queue->data_read;
+	}
+}
+#endif
+
+#else
+
+static inline bool event_queue_empty() {
+	return event_queue.head == SHARED_LOAD(&event_queue.ready);
+}
+
+/* returns true when the event fits the event queue, must be called within a critical section */
+static inline bool event_queue_space(uloop_event_t event) {
+	uint32_t used = (event_queue.tail + ULOOP_EVENT_QUEUE_SIZE - SHARED_LOAD(&event_queue.head)) % ULOOP_EVENT_QUEUE_SIZE;
+	uint32_t space = ULOOP_EVENT_QUEUE_SIZE - 1 - used;
+	bool fits = space > 0;
+#ifdef ULOOP_OVERFLOW_RESERVES
+	uint32_t index = uloop_event_overflow[event].reserve;
+	if ((index == RESERVE_NONE) || (reserve_queued[index] >= uloop_overflow_reserves[index])) {
+		// the slots kept for other events can not be taken
+		fits = space > reserve_free;
+	}
+#else
+	(void) event;
+#endif
+	return fits;
+}
+
+/* must be called within a critical section once event_queue_space confirmed the slot */
+static inline uloop_event_queue_item_t* event_queue_push(uloop_event_t event, uint32_t size) {
+	ULOOP_DEV_ASSERT((ULOOP_DATA_QUEUE_SIZE == 0) || (size <= ULOOP_DATA_SIZE_MAX));
+	uloop_event_queue_item_t* item = &event_queue.data[event_queue.tail];
+	item[0] = EVENT_QUEUE_ITEM(event, size);
+#ifdef ULOOP_OVERFLOW_RESERVES
+	uint32_t index = uloop_event_overflow[event].reserve;
+	reserve_owner[event_queue.tail] = (uint8_t) index;
+	if (index != RESERVE_NONE) {
+		reserve_queued[index] += 1;
+		if (reserve_queued[index] <= uloop_overflow_reserves[index]) {
+			reserve_free -= 1;
+		}
+	}
+#endif
+	event_queue.tail = (event_queue.tail + 1) % ULOOP_EVENT_QUEUE_SIZE;
+	if (event_queue.reserved == 0) {
+		SHARED_STORE(&event_queue.ready, event_queue.tail);
+	}
+	return item;
+}
+
+/* must be called within the critical section of the push, a stamp of NULL keeps the one just taken */
+static inline void event_queue_stamp(uloop_event_queue_item_t* item, const uint32_t* stamp) {
+#ifdef ULOOP_LATENCY_BUCKETS
+	if (stamp != NULL) {
+		item->stamp = *stamp;
+	}
+#else
+	(void) item;
+	(void) stamp;
+#endif
+}
+
+/* takes the entry for dispatching, a newer publish can only take over entries that were not taken yet */
+static inline uloop_event_queue_item_t event_queue_take(uint32_t index) {
+#ifdef ULOOP_OVERFLOW_REPLACE
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	uloop_event_queue_item_t item = event_queue.data[index];
+	event_queue.read = (index + 1) % ULOOP_EVENT_QUEUE_SIZE;
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+	return item;
+#else
+	return event_queue.data[index];
+#endif
+}
+
+static inline uloop_event_queue_item_t event_queue_top() {
+	return event_queue_take(event_queue.head);
+}
+
+/* hands the slots up to head back to the producers */
+static inline void event_queue_release(uint32_t head) {
+#ifdef ULOOP_OVERFLOW_RESERVES
+	// a slot and its reserve have to become free together
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	for (uint32_t i = event_queue.head; i != head; i = (i + 1) % ULOOP_EVENT_QUEUE_SIZE) {
+		uint32_t index = reserve_owner[i];
+		if (index != RESERVE_NONE) {
+			if (reserve_queued[index] <= uloop_overflow_reserves[index]) {
+				reserve_free += 1;
+			}
+			reserve_queued[index] -= 1;
+		}
+	}
+	event_queue.head = head;
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+#else
+	SHARED_STORE(&event_queue.head, head);
+#endif
+}
+
+static inline void event_queue_pop() {
+	event_queue_release((event_queue.head + 1) % ULOOP_EVENT_QUEUE_SIZE);
+}
+
+#ifdef ULOOP_OVERFLOW_REPLACE
+/* returns the oldest entry of the event that was not taken yet, must be called within a critical section */
+static inline uloop_event_queue_item_t* event_queue_find(uloop_event_t event) {
+	uloop_event_queue_item_t* item = NULL;
+	for (uint32_t i = event_queue.read; (item == NULL) && (i != event_queue.ready); i = (i + 1) % ULOOP_EVENT_QUEUE_SIZE) {
+		if ((event_queue.data[i].id == event) && !EVENT_QUEUE_ABORTED(event_queue.data[i])) {
+			item = &event_queue.data[i];
+		}
+	}
+	return item;
+}
+#endif
+
+#ifdef ULOOP_SLAB_COUNT
+static inline uint32_t slab_class(uint32_t block) {
+	uint32_t index = 0;
+	while ((index < (ULOOP_SLAB_COUNT - 1)) && (block >= uloop_slab_classes[index + 1].first)) {
+		index += 1;
+	}
+	return index;
+}
+
+static inline uint8_t* slab_data(uint32_t block) {
+	const uloop_slab_class_t* slab = &uloop_slab_classes[slab_class(block)];
+	return (uint8_t*) slab_storage + slab->offset + ((block - slab->first) * slab->size);
+}
+
+static inline uint32_t slab_pop(uint32_t index) {
+	uint32_t block;
+	uint32_t head = ATOMIC_LOAD(&slab_free_heads[index]);
+	do {
+		block = head & 0xFFFF;
+		if (block == SLAB_NONE) {
+			break;
+		}
+	} while (!ATOMIC_CAS(&slab_free_heads[index], &head, ((head + 0x10000) & 0xFFFF0000) | slab_next[block]));
+	return block;
+}
+
+static inline void slab_push(uint32_t index, uint32_t block) {
+	uint32_t head = ATOMIC_LOAD(&slab_free_heads[index]);
+	do {
+		slab_next[block] = (uint16_t) head;
+	} while (!ATOMIC_CAS(&slab_free_heads[index], &head, ((head + 0x10000) & 0xFFFF0000) | block));
+}
+
+/* takes a block of the smallest class that fits size, larger classes are used when it is exhausted */
+static uint32_t slab_try_alloc(uint32_t size) {
+	ULOOP_DEV_ASSERT(size <= ULOOP_DATA_SIZE_MAX);
+	uint32_t index = 0;
+	while ((index < ULOOP_SLAB_COUNT) && (uloop_slab_classes[index].size < size)) {
+		index += 1;
+	}
+	uint32_t block = SLAB_NONE;
+	while ((block == SLAB_NONE) && (index < ULOOP_SLAB_COUNT)) {
+		block = slab_pop(index);
+		index += 1;
+	}
+	return block;
+}
+
+/* must be called within a critical section */
+static inline void slab_stats_alloc(uint32_t block, uint32_t size) {
+#ifdef ULOOP_STATISTICS_ENABLED
+	uint32_t index = slab_class(block);
+	uloop_slab_stats_t* stats = &uloop_slab_stats[index];
+	stats->used += 1;
+	if (stats->peak < stats->used) {
+		stats->peak = stats->used;
+	}
+	stats->allocations += 1;
+	if ((index > 0) && (uloop_slab_classes[index - 1].size >= size)) {
+		stats->fallbacks += 1;
+	}
+	stats->wasted += uloop_slab_classes[index].size - size;
+#else
+	(void) block;
+	(void) size;
+#endif
+}
+
+static void slab_release(uint32_t block) {
+	uint32_t index = slab_class(block);
+#ifdef ULOOP_STATISTICS_ENABLED
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	uloop_slab_stats[index].used -= 1;
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+#endif
+	slab_push(index, block);
+}
+
+/* releases the block of a dispatched event unless a listener retained it */
+static inline void slab_consume(uint32_t block) {
+	ULOOP_DEV_ASSERT(data_retain_requests < 256);
+	slab_retained[block] = (uint8_t) data_retain_requests;
+	data_retain_requests = 0;
+	if (slab_retained[block] == 0) {
+		slab_release(block);
+	}
+}
+#elif ULOOP_DATA_QUEUE_SIZE > 0
+static inline const uint8_t* data_queue_top(uint32_t size) {
+	(void) size;
+	return &data_queue.data[data_queue.read];
+}
+
+static uint8_t* data_queue_push(uint32_t unaligned_size) {
+	uint8_t* ret;
+	uint32_t size = (unaligned_size + 3) & (~3);
+	if (data_queue.head == data_queue.tail) {
+		ULOOP_DEV_ASSERT(size < ULOOP_DATA_QUEUE_SIZE);
+		ret = data_queue.data;
+		data_queue.head = 0;
+		data_queue.read = 0;
+		data_queue.tail = size;
+	} else if (data_queue.tail > data_queue.head) {
+		uint32_t end_size = ULOOP_DATA_QUEUE_SIZE - data_queue.tail;
+		if (size < end_size) {
+			ret = &data_queue.data[data_queue.tail];
+			data_queue.tail += size;
+		} else if ((size == end_size) && (data_queue.head > 0)) {
+			ret = &data_queue.data[data_queue.tail];
+			data_queue.tail = 0;
+		} else if (size < data_queue.head) {
+			ret = data_queue.data;
+			data_queue.end = data_queue.tail;
+			data_queue.tail = size;
+		} else {
+			ret = NULL;
+		}
+	} else {
+		if (size < (data_queue.head - data_queue.tail)) {
+			ret = &data_queue.data[data_queue.tail];
+			data_queue.tail += size;
+		} else {
+			ret = NULL;
+		}
+	}
+	return ret;
+}
+
+/* hands the consumed data back to the producers, must be called within a critical section */
+static inline void data_queue_release() {
+	if (data_queue.read < data_queue.head) {
+		// the consumer wrapped since the last release
+		data_queue.end = ULOOP_DATA_QUEUE_SIZE;
+	}
+	data_queue.head = data_queue.read;
+}
+
+static void data_queue_pop(uint32_t unaligned_size) {
+	uint32_t size = (unaligned_size + 3) & (~3);
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	ULOOP_DEV_ASSERT(data_queue.read != data_queue.tail);
+	data_queue.read += size;
+	if (data_queue.read > data_queue.end) {
+		data_queue.read -= size;
+		ULOOP_ERROR_DQCORR();
+	} else if (data_queue.read == data_queue.end) {
+		data_queue.read = 0;
+	} else {
+		// do nothing
+	}
+	data_queue.retained += data_retain_requests;
+	data_retain_requests = 0;
+	if (data_queue.retained == 0) {
+		data_queue_release();
+	}
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+}
+#endif
+
+#endif
+
+static inline void dispatch(uloop_event_t event, const void* data, uint32_t size) {
+#ifdef ULOOP_DISPATCH_SWITCH
+	uloop_dispatch_generated(event, data, size);
+#else
+	const uloop_listener_id_t* ptr = &uloop_listener_table[uloop_listener_lut[event]];
+	while (ptr[0] != ULOOP_LISTENER_NONE) {
+		uint32_t listener = ptr[0];
+#ifdef ULOOP_SUBSCRIPTIONS
+		if (uloop_subscribed((uint32_t) (ptr - uloop_listener_table))) {
+			uloop_execute(listener, uloop_listeners[listener], event, data, size);
+		}
+#else
+		uloop_execute(listener, uloop_listeners[listener], event, data, size);
+#endif
+		ptr += 1;
+	}
+#endif
+}
+
+#ifdef ULOOP_SYNC_DEPTH
+
+/* nesting level of uloop_publish_sync in each instance */
+static uint32_t sync_depth[ULOOP_INSTANCE_COUNT];
+uint32_t uloop_sync_time[ULOOP_INSTANCE_COUNT];
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_sync(uloop_event_t event, const void* data, uint32_t size) {
+#else
+void uloop_publish_sync(uloop_event_t event) {
+	const void* data = NULL;
+	uint32_t size = 0;
+#endif
+	// the configuration keeps sync events in the instance of the publishing listener
+	uint32_t instance = EVENT_INSTANCE(event);
+	uloop_listener_id_t listener = ULOOP_ACTIVE(instance);
+	ULOOP_DEV_ASSERT((listener != ULOOP_LISTENER_NONE) && (sync_depth[instance] < ULOOP_SYNC_DEPTH));
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if ((sync_depth[instance] < ULOOP_SYNC_DEPTH) && event_active(event)) {
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		uint32_t retain_requests = data_retain_requests;
+#endif
+		uint32_t outer_time = uloop_sync_time[instance];
+		sync_depth[instance] += 1;
+#ifdef ULOOP_STATISTICS_ENABLED
+		uloop_event_stats[event].count += 1;
+#endif
+		ULOOP_TIMER_START();
+		ULOOP_TRACE(ULOOP_TRACE_PRE_DISPATCH, event, ULOOP_LISTENER_NONE);
+		ULOOP_HOOK_PRE_DISPATCH(event, data, size);
+		dispatch(event, data, size);
+		ULOOP_HOOK_POST_DISPATCH(event, data, size);
+		ULOOP_TRACE(ULOOP_TRACE_POST_DISPATCH, event, ULOOP_LISTENER_NONE);
+		// the whole nested dispatch is taken off the time of the publishing listener
+		uloop_sync_time[instance] = outer_time + ULOOP_TIMER_STOP();
+		sync_depth[instance] -= 1;
+		ULOOP_ACTIVE(instance) = listener;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		// the data belongs to the publishing listener, it can not be retained
+		ULOOP_DEV_ASSERT(data_retain_requests == retain_requests);
+#endif
+	}
+}
+
+#endif
+
+#ifdef ULOOP_LOCK_FREE_QUEUE
+
+void uloop_publish(uloop_event_t event) {
+	uint16_t position;
+	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if (event_active(event) && coalesce_publish(event)) {
+		(void) event_queue_reserve(event, 0, &position);
+		event_queue_commit(position);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, NULL, 0);
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
+	uint16_t position;
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	ULOOP_DEV_ASSERT((size == 0) || (data != NULL));
+#ifdef ULOOP_COALESCE_DATA_SIZE
+	size = coalesce_store(event, data, size);
+#endif
+	if (event_active(event) && coalesce_publish(event)) {
+		uint8_t* ptr = event_queue_reserve(event, size, &position);
+		if (size > 0) {
+			memcpy(ptr, data, size);
+		}
+		event_queue_commit(position);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, data, size);
+}
+
+void* uloop_publish_reserve(uloop_reservation_t* reservation, uloop_event_t event, uint32_t size) {
+	uint16_t position;
+	uint8_t* ptr = event_queue_reserve(event, size, &position);
+	reservation->data = (size > 0) ? ptr : NULL;
+	reservation->slot = position;
+	reservation->event = event;
+	reservation->size = (uloop_data_size_t) size;
+	return reservation->data;
+}
+
+void uloop_publish_commit(const uloop_reservation_t* reservation) {
+	ULOOP_HOOK_PUBLISH(reservation->event, reservation->data, reservation->size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, reservation->event, ULOOP_LISTENER_NONE);
+#ifdef ULOOP_LATENCY_BUCKETS
+	event_queue.data[reservation->slot & (ULOOP_EVENT_QUEUE_SIZE - 1)].item.stamp = ULOOP_TIMESTAMP();
+#endif
+	event_queue_commit((uint16_t) reservation->slot);
+	ULOOP_HOOK_POST_PUBLISH(reservation->event, reservation->data, reservation->size);
+}
+
+void uloop_publish_abort(const uloop_reservation_t* reservation) {
+	EVENT_QUEUE_ABORT(event_queue.data[reservation->slot & (ULOOP_EVENT_QUEUE_SIZE - 1)].item);
+	event_queue_commit((uint16_t) reservation->slot);
+}
+#endif
+
+#elif defined(ULOOP_PRODUCER_COUNT)
+
+void uloop_publish_from(uloop_producer_t producer, uloop_event_t event) {
+	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	ULOOP_DEV_ASSERT(producer < ULOOP_PRODUCER_COUNT);
+	producer_queue_t* queue = &producer_queues[producer];
+	if (event_active(event)) {
+		(void) event_queue_reserve(queue, event, 0);
+		event_queue_commit(queue);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, NULL, 0);
+}
+
+void uloop_publish(uloop_event_t event) {
+	uloop_publish_from(0, event);
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex_from(uloop_producer_t producer, uloop_event_t event, const void* data, uint32_t size) {
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	ULOOP_DEV_ASSERT((producer < ULOOP_PRODUCER_COUNT) && ((size == 0) || (data != NULL)));
+	producer_queue_t* queue = &producer_queues[producer];
+	if (event_active(event)) {
+		uint8_t* ptr = event_queue_reserve(queue, event, size);
+		if (size > 0) {
+			memcpy(ptr, data, size);
+		}
+		event_queue_commit(queue);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, data, size);
+}
+
+void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
+	uloop_publish_ex_from(0, event, data, size);
+}
+
+void* uloop_publish_reserve_from(uloop_producer_t producer, uloop_reservation_t* reservation, uloop_event_t event, uint32_t size) {
+	ULOOP_DEV_ASSERT(producer < ULOOP_PRODUCER_COUNT);
+	producer_queue_t* queue = &producer_queues[producer];
+	reservation->slot = queue->alloc;
+	uint8_t* ptr = event_queue_reserve(queue, event, size);
+	queue->reserved += 1;
+	reservation->data = (size > 0) ? ptr : NULL;
+	reservation->producer = producer;
+	reservation->event = event;
+	reservation->size = (uloop_data_size_t) size;
+	return reservation->data;
+}
+
+void* uloop_publish_reserve(uloop_reservation_t* reservation, uloop_event_t event, uint32_t size) {
+	return uloop_publish_reserve_from(0, reservation, event, size);
+}
+
+void uloop_publish_commit(const uloop_reservation_t* reservation) {
+	ULOOP_HOOK_PUBLISH(reservation->event, reservation->data, reservation->size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, reservation->event, ULOOP_LISTENER_NONE);
+	producer_queue_t* queue = &producer_queues[reservation->producer];
+	ULOOP_DEV_ASSERT(queue->reserved > 0);
+#ifdef ULOOP_LATENCY_BUCKETS
+	queue->slots[reservation->slot & (ULOOP_EVENT_QUEUE_SIZE - 1)].item.stamp = ULOOP_TIMESTAMP();
+#endif
+	queue->reserved -= 1;
+	event_queue_commit(queue);
+	ULOOP_HOOK_POST_PUBLISH(reservation->event, reservation->data, reservation->size);
+}
+
+void uloop_publish_abort(const uloop_reservation_t* reservation) {
+	producer_queue_t* queue = &producer_queues[reservation->producer];
+	ULOOP_DEV_ASSERT(queue->reserved > 0);
+	EVENT_QUEUE_ABORT(queue->slots[reservation->slot & (ULOOP_EVENT_QUEUE_SIZE - 1)].item);
+	queue->reserved -= 1;
+	event_queue_commit(queue);
+}
+#endif
+
+#elif defined(ULOOP_PRIORITY_COUNT)
+
+void uloop_publish(uloop_event_t event) {
+	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if (event_active(event) && coalesce_publish(event)) {
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		(void) event_queue_push(event, 0);
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, NULL, 0);
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	ULOOP_DEV_ASSERT((size == 0) || (data != NULL));
+#ifdef ULOOP_COALESCE_DATA_SIZE
+	size = coalesce_store(event, data, size);
+#endif
+	if (event_active(event) && coalesce_publish(event)) {
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		uint8_t* ptr = event_queue_push(event, size);
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+		if (size > 0) {
+			memcpy(ptr, data, size);
+		}
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, data, size);
+}
+
+void* uloop_publish_reserve(uloop_reservation_t* reservation, uloop_event_t event, uint32_t size) {
+	const uloop_priority_level_t* config = &uloop_priority_levels[uloop_event_priority[event]];
+	priority_queue_t* queue = &priority_queues[uloop_event_priority[event]];
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	reservation->slot = config->event_queue_offset + (queue->tail & (config->event_queue_size - 1));
+	queue->reserved += 1;
+	uint8_t* ptr = event_queue_push(event, size);
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+	reservation->data = ptr;
+	reservation->event = event;
+	reservation->size = (uloop_data_size_t) size;
+	return ptr;
+}
+
+/* makes the events up to the tail visible once no reservation is outstanding */
+static inline void event_queue_commit(uloop_event_t event) {
+	uint32_t level = uloop_event_priority[event];
+	priority_queue_t* queue = &priority_queues[level];
+	ULOOP_DEV_ASSERT(queue->reserved > 0);
+	queue->reserved -= 1;
+	if (queue->reserved == 0) {
+		queue->ready = queue->tail;
+		priority_pending |= 1UL << level;
+	}
+}
+
+void uloop_publish_commit(const uloop_reservation_t* reservation) {
+	ULOOP_HOOK_PUBLISH(reservation->event, reservation->data, reservation->size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, reservation->event, ULOOP_LISTENER_NONE);
+	ULOOP_ATOMIC_BLOCK_ENTER();
+#ifdef ULOOP_LATENCY_BUCKETS
+	priority_events[reservation->slot].stamp = ULOOP_TIMESTAMP();
+#endif
+	event_queue_commit(reservation->event);
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+	ULOOP_HOOK_POST_PUBLISH(reservation->event, reservation->data, reservation->size);
+}
+
+void uloop_publish_abort(const uloop_reservation_t* reservation) {
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	EVENT_QUEUE_ABORT(priority_events[reservation->slot]);
+	event_queue_commit(reservation->event);
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+}
+#endif
+
+#else
+
+#define PUBLISH_QUEUED   0
+#define PUBLISH_EQ_FULL  1
+#define PUBLISH_DQ_FULL  2
+
+static inline uint32_t overflow_policy(uloop_event_t event, bool try_only) {
+#ifdef ULOOP_OVERFLOW
+	uint32_t policy = uloop_event_overflow[event].policy;
+#else
+	uint32_t policy = ULOOP_OVERFLOW_FATAL;
+	(void) event;
+#endif
+	if (try_only && ((policy == ULOOP_OVERFLOW_FATAL) || (policy == ULOOP_OVERFLOW_BLOCK))) {
+		policy = ULOOP_OVERFLOW_DROP_NEW;
+	}
+	return policy;
+}
+
+/* must be called within a critical section */
+static inline void overflow_drop(uloop_event_t event) {
+#ifdef ULOOP_STATISTICS_ENABLED
+	uloop_event_stats[event].drops += 1;
+#else
+	(void) event;
+#endif
+}
+
+/*
+ * Queues the event together with its data. When the event queue is full and
+ * the policy is ULOOP_OVERFLOW_DROP_OLDEST the oldest entry of the same
+ * event that was not taken by the consumer yet gets the new data instead,
+ * it keeps its position in the queue. A stamp other than NULL replaces the
+ * time of the publish, messages drained from a mailbox keep their own one.
+ */
+static uint32_t event_queue_publish(uloop_event_t event, const void* data, uint32_t size, uint32_t policy, const uint32_t* stamp) {
+	uint32_t status = PUBLISH_QUEUED;
+#ifdef ULOOP_OVERFLOW_REPLACE
+	uloop_event_queue_item_t* item = NULL;
+#endif
+#ifdef ULOOP_SLAB_COUNT
+	// the block is filled before the event becomes visible
+	uint32_t block = SLAB_NONE;
+	uint32_t unused = SLAB_NONE;
+	if (size > 0) {
+		ULOOP_DEV_ASSERT(data != NULL);
+		block = slab_try_alloc(size);
+		if (block != SLAB_NONE) {
+			memcpy(slab_data(block), data, size);
+		}
+	}
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	if ((size > 0) && (block == SLAB_NONE)) {
+		status = PUBLISH_DQ_FULL;
+	} else if (!event_queue_space(event)) {
+		status = PUBLISH_EQ_FULL;
+		unused = block;
+#ifdef ULOOP_OVERFLOW_REPLACE
+		item = (policy == ULOOP_OVERFLOW_DROP_OLDEST) ? event_queue_find(event) : NULL;
+		if (item != NULL) {
+			// the block of the dropped entry goes back to its class
+			unused = item->block;
+			item->block = (uint16_t) block;
+			item->size = (uloop_data_size_t) size;
+		}
+#endif
+	} else {
+		uloop_event_queue_item_t* pushed = event_queue_push(event, size);
+		pushed->block = (uint16_t) block;
+		event_queue_stamp(pushed, stamp);
+	}
+	if ((block != SLAB_NONE) && (unused != block)) {
+		slab_stats_alloc(block, size);
+	}
+#else
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uint8_t* ptr = NULL;
+#endif
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	if (!event_queue_space(event)) {
+		status = PUBLISH_EQ_FULL;
+#ifdef ULOOP_OVERFLOW_REPLACE
+		// data in the ring can not be exchanged, only entries without data are taken over
+		item = ((policy == ULOOP_OVERFLOW_DROP_OLDEST) && (size == 0)) ? event_queue_find(event) : NULL;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		if ((item != NULL) && (item->size > 0)) {
+			item = NULL;
+		}
+#endif
+#endif
+	} else {
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		if (size > 0) {
+			ULOOP_DEV_ASSERT(data != NULL);
+			ptr = data_queue_push(size);
+		}
+		if ((size > 0) && (ptr == NULL)) {
+			status = PUBLISH_DQ_FULL;
+		} else {
+#ifdef ULOOP_SMP
+			// the loop does not wait for the critical section, the data is copied before the event is visible
+			if (ptr != NULL) {
+				memcpy(ptr, data, size);
+			}
+#endif
+			event_queue_stamp(event_queue_push(event, size), stamp);
+		}
+#else
+		(void) data;
+		event_queue_stamp(event_queue_push(event, size), stamp);
+#endif
+	}
+#endif
+#ifdef ULOOP_OVERFLOW_REPLACE
+	if (item != NULL) {
+#ifdef ULOOP_LATENCY_BUCKETS
+		item->stamp = ULOOP_TIMESTAMP();
+#endif
+		status = PUBLISH_QUEUED;
+		overflow_drop(event);
+	}
+#endif
+	if ((status != PUBLISH_QUEUED) && (policy != ULOOP_OVERFLOW_FATAL) && (policy != ULOOP_OVERFLOW_BLOCK)) {
+		overflow_drop(event);
+	}
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+#ifdef ULOOP_SLAB_COUNT
+	if (unused != SLAB_NONE) {
+		if (unused == block) {
+			slab_push(slab_class(block), block);
+		} else {
+			slab_release(unused);
+		}
+	}
+#elif (ULOOP_DATA_QUEUE_SIZE > 0) && !defined(ULOOP_SMP)
+	if (ptr != NULL) {
+		memcpy(ptr, data, size);
+	}
+#endif
+	return status;
+}
+
+#if ULOOP_INSTANCE_COUNT > 1
+static inline mailbox_t* mailbox(uint32_t receiver, uint32_t sender) {
+	return &mailboxes[(receiver * ULOOP_INSTANCE_COUNT) + sender - 1];
+}
+
+/* a full mailbox is a full event queue to the overflow policy, drop-oldest-of-same-event drops the new message */
+static uint32_t mailbox_publish(uint32_t sender, uloop_event_t event, const void* data, uint32_t size, uint32_t policy) {
+	mailbox_t* box = mailbox(EVENT_INSTANCE(event), sender);
+	uint32_t status = PUBLISH_QUEUED;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	if (size > ULOOP_MAILBOX_DATA_SIZE) {
+		ULOOP_ERROR_DQOVF();
+	}
+#else
+	(void) data;
+	(void) size;
+#endif
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	uint32_t tail = box->tail;
+	if ((tail - ATOMIC_LOAD(&box->head)) < ULOOP_MAILBOX_SIZE) {
+		mailbox_message_t* message = &box->messages[tail & (ULOOP_MAILBOX_SIZE - 1)];
+		message->event = event;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		message->size = (uloop_data_size_t) size;
+		if (size > 0) {
+			ULOOP_DEV_ASSERT(data != NULL);
+			memcpy(message->data, data, size);
+		}
+#endif
+#ifdef ULOOP_LATENCY_BUCKETS
+		message->stamp = ULOOP_TIMESTAMP();
+#endif
+		ATOMIC_STORE(&box->tail, tail + 1);
+	} else {
+		status = PUBLISH_EQ_FULL;
+		if ((policy != ULOOP_OVERFLOW_FATAL) && (policy != ULOOP_OVERFLOW_BLOCK)) {
+			overflow_drop(event);
+		}
+	}
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+	return status;
+}
+#endif
+
+/* instance 0 queues its own events, everything else goes through a mailbox */
+static inline uint32_t instance_publish(uint32_t sender, uloop_event_t event, const void* data, uint32_t size, uint32_t policy) {
+	uint32_t status;
+#if ULOOP_INSTANCE_COUNT > 1
+	if ((sender == 0) && (EVENT_INSTANCE(event) == 0)) {
+		status = event_queue_publish(event, data, size, policy, NULL);
+	} else {
+		status = mailbox_publish(sender, event, data, size, policy);
+	}
+#else
+	(void) sender;
+	status = event_queue_publish(event, data, size, policy, NULL);
+#endif
+	return status;
+}
+
+/*
+ * The instance publishing through the functions without a context. The
+ * platform can tell it with ULOOP_INSTANCE_CURRENT(), otherwise they belong to
+ * instance 0 and must not be called while a listener of another instance runs.
+ */
+static inline uint32_t publish_sender(void) {
+#if (ULOOP_INSTANCE_COUNT > 1) && defined(ULOOP_INSTANCE_CURRENT)
+	uint32_t sender = ULOOP_INSTANCE_CURRENT();
+	ULOOP_DEV_ASSERT(sender < ULOOP_INSTANCE_COUNT);
+	return sender;
+#else
+#if ULOOP_INSTANCE_COUNT > 1
+	for (uint32_t i = 1; i < ULOOP_INSTANCE_COUNT; i++) {
+		ULOOP_DEV_ASSERT(ULOOP_ACTIVE(i) == ULOOP_LISTENER_NONE);
+	}
+#endif
+	return 0;
+#endif
+}
+
+/* returns true when the event was queued, the overflow policy of the event decides about the rest */
+static bool publish(uint32_t sender, uloop_event_t event, const void* data, uint32_t size, bool try_only) {
+	uint32_t policy = overflow_policy(event, try_only);
+	uint32_t status = instance_publish(sender, event, data, size, policy);
+	while ((status != PUBLISH_QUEUED) && (policy == ULOOP_OVERFLOW_BLOCK)) {
+		// a listener, an interrupt or a thread publishing while the loop runs or idles would run it a second time
+		ULOOP_DEV_ASSERT(!RUN_ACTIVE(sender));
+		(void) uloop_run_ctx(&instances[sender]);
+		status = instance_publish(sender, event, data, size, policy);
+	}
+	if (status == PUBLISH_QUEUED) {
+		// done
+	} else if (policy == ULOOP_OVERFLOW_FATAL) {
+		if (status == PUBLISH_EQ_FULL) {
+			ULOOP_ERROR_EQOVF();
+		} else {
+			ULOOP_ERROR_DQOVF();
+		}
+	} else {
+#ifdef ULOOP_COALESCE
+		// nothing is queued, the next publish has to queue the event again
+		if (coalesce_enabled(event)) {
+			coalesce_clear(event);
+		}
+#endif
+	}
+	return status == PUBLISH_QUEUED;
+}
+
+void uloop_publish(uloop_event_t event) {
+	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if (event_active(event) && coalesce_publish(event)) {
+		(void) publish(publish_sender(), event, NULL, 0, false);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, NULL, 0);
+}
+
+bool uloop_try_publish(uloop_event_t event) {
+	bool queued = true;
+	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if (event_active(event) && coalesce_publish(event)) {
+		queued = publish(publish_sender(), event, NULL, 0, true);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, NULL, 0);
+	return queued;
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+#ifdef ULOOP_COALESCE_DATA_SIZE
+	size = coalesce_store(event, data, size);
+#endif
+	if (event_active(event) && coalesce_publish(event)) {
+		(void) publish(publish_sender(), event, data, size, false);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, data, size);
+}
+
+bool uloop_try_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
+	bool queued = true;
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+#ifdef ULOOP_COALESCE_DATA_SIZE
+	size = coalesce_store(event, data, size);
+#endif
+	if (event_active(event) && coalesce_publish(event)) {
+		queued = publish(publish_sender(), event, data, size, true);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, data, size);
+	return queued;
+}
+#endif
+
+void uloop_publish_ctx(uloop_ctx_t* ctx, uloop_event_t event) {
+	ULOOP_HOOK_PUBLISH(event, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if (event_active(event) && coalesce_publish(event)) {
+		(void) publish(ctx->index, event, NULL, 0, false);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, NULL, 0);
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex_ctx(uloop_ctx_t* ctx, uloop_event_t event, const void* data, uint32_t size) {
+	ULOOP_HOOK_PUBLISH(event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, event, ULOOP_LISTENER_NONE);
+	if (event_active(event) && coalesce_publish(event)) {
+		(void) publish(ctx->index, event, data, size, false);
+	}
+	ULOOP_HOOK_POST_PUBLISH(event, data, size);
+}
+
+void* uloop_publish_reserve(uloop_reservation_t* reservation, uloop_event_t event, uint32_t size) {
+	uint8_t* ptr = NULL;
+	if (EVENT_INSTANCE(event) != 0) {
+		// reservations point into the event queue, which only instance 0 has
+		ULOOP_ERROR_EQOVF();
+	}
+#ifdef ULOOP_SLAB_COUNT
+	uint32_t block = SLAB_NONE;
+	if (size > 0) {
+		block = slab_try_alloc(size);
+		if (block == SLAB_NONE) {
+			ULOOP_ERROR_DQOVF();
+		}
+	}
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	if (!event_queue_space(event)) {
+		ULOOP_ERROR_EQOVF();
+	}
+	reservation->slot = event_queue.tail;
+	event_queue.reserved += 1;
+	event_queue_push(event, size)->block = (uint16_t) block;
+	if (size > 0) {
+		slab_stats_alloc(block, size);
+		ptr = slab_data(block);
+	}
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+#else
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	if (!event_queue_space(event)) {
+		ULOOP_ERROR_EQOVF();
+	}
+	reservation->slot = event_queue.tail;
+	event_queue.reserved += 1;
+	event_queue_push(event, size);
+	if (size > 0) {
+		ptr = data_queue_push(size);
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+		if (ptr == NULL) {
+			ULOOP_ERROR_DQOVF();
+		}
+	} else {
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+	}
+#endif
+	reservation->data = ptr;
+	reservation->event = event;
+	reservation->size = (uloop_data_size_t) size;
+	return ptr;
+}
+
+/* makes the events up to the tail visible once no reservation is outstanding */
+static inline void event_queue_commit() {
+	ULOOP_DEV_ASSERT(event_queue.reserved > 0);
+	event_queue.reserved -= 1;
+	if (event_queue.reserved == 0) {
+		SHARED_STORE(&event_queue.ready, event_queue.tail);
+	}
+}
+
+void uloop_publish_commit(const uloop_reservation_t* reservation) {
+	(void) reservation;
+	ULOOP_HOOK_PUBLISH(reservation->event, reservation->data, reservation->size);
+	ULOOP_TRACE(ULOOP_TRACE_PUBLISH, reservation->event, ULOOP_LISTENER_NONE);
+	ULOOP_ATOMIC_BLOCK_ENTER();
+#ifdef ULOOP_LATENCY_BUCKETS
+	event_queue.data[reservation->slot].stamp = ULOOP_TIMESTAMP();
+#endif
+	event_queue_commit();
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+	ULOOP_HOOK_POST_PUBLISH(reservation->event, reservation->data, reservation->size);
+}
+
+void uloop_publish_abort(const uloop_reservation_t* reservation) {
+	ULOOP_ATOMIC_BLOCK_ENTER();
+	EVENT_QUEUE_ABORT(event_queue.data[reservation->slot]);
+	event_queue_commit();
+	ULOOP_ATOMIC_BLOCK_LEAVE();
+}
+#endif
+
+#if ULOOP_INSTANCE_COUNT > 1
+/* moves the messages for instance 0 into its event queue as long as they fit, the rest waits in the mailboxes */
+static void mailbox_drain(void) {
+	for (uint32_t sender = 1; sender < ULOOP_INSTANCE_COUNT; sender++) {
+		mailbox_t* box = mailbox(0, sender);
+		uint32_t head = box->head;
+		uint32_t status = PUBLISH_QUEUED;
+		while ((status == PUBLISH_QUEUED) && (head != ATOMIC_LOAD(&box->tail))) {
+			const mailbox_message_t* message = &box->messages[head & (ULOOP_MAILBOX_SIZE - 1)];
+#ifdef ULOOP_LATENCY_BUCKETS
+			// the latency includes the time the message waited in the mailbox
+			const uint32_t* stamp = &message->stamp;
+#else
+			const uint32_t* stamp = NULL;
+#endif
+#if ULOOP_DATA_QUEUE_SIZE > 0
+			status = event_queue_publish(message->event, message->data, message->size, ULOOP_OVERFLOW_BLOCK, stamp);
+#else
+			status = event_queue_publish(message->event, NULL, 0, ULOOP_OVERFLOW_BLOCK, stamp);
+#endif
+			if (status == PUBLISH_QUEUED) {
+				head += 1;
+				ATOMIC_STORE(&box->head, head);
+			}
+		}
+	}
+}
+#endif
+
+#endif
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_data_retain(const void* data) {
+#if ULOOP_INSTANCE_COUNT > 1
+	// the retain counter belongs to instance 0, the other instances get their data right from a mailbox
+	const uint8_t* ptr = (const uint8_t*) data;
+	if ((ptr >= (const uint8_t*) mailboxes) && (ptr < (const uint8_t*) &mailboxes[sizeof(mailboxes) / sizeof(mailboxes[0])])) {
+		ULOOP_ERROR_DQCORR();
+	}
+#endif
+	ULOOP_DEV_ASSERT((data != NULL) && (uloop_listener_active != ULOOP_LISTENER_NONE));
+	data_retain_requests += 1;
+}
+
+void uloop_data_release(const void* data) {
+	ULOOP_DEV_ASSERT(data != NULL);
+#ifdef ULOOP_LOCK_FREE_QUEUE
+	ULOOP_DEV_ASSERT(data_queue.retained > 0);
+	data_queue.retained -= 1;
+	if (data_queue.retained == 0) {
+		data_queue_release();
+	}
+#elif defined(ULOOP_PRODUCER_COUNT)
+	producer_queue_t* queue = NULL;
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		if (((uintptr_t) data - (uintptr_t) producer_queues[i].data) < ULOOP_DATA_QUEUE_SIZE) {
+			queue = &producer_queues[i];
+		}
+	}
+	ULOOP_DEV_ASSERT((queue != NULL) && (queue->data_retained > 0));
+	queue->data_retained -= 1;
+	if (queue->data_retained == 0) {
+		ATOMIC_STORE(&queue->data_head, queue->data_read);
+	}
+#elif defined(ULOOP_PRIORITY_COUNT)
+	priority_queue_t* queue = NULL;
+	uintptr_t offset = (uintptr_t) data - (uintptr_t) priority_data;
+	for (uint32_t i = 0; i < ULOOP_PRIORITY_COUNT; i++) {
+		if ((offset - uloop_priority_levels[i].data_queue_offset) < uloop_priority_levels[i].data_queue_size) {
+			queue = &priority_queues[i];
+		}
+	}
+	ULOOP_DEV_ASSERT((queue != NULL) && (queue->data_retained > 0));
+	queue->data_retained -= 1;
+	if (queue->data_retained == 0) {
+		queue->data_head = queue->data_read;
+	}
+#elif defined(ULOOP_SLAB_COUNT)
+	uintptr_t offset = (uintptr_t) data - (uintptr_t) slab_storage;
+	ULOOP_DEV_ASSERT(offset < ULOOP_SLAB_DATA_SIZE);
+	const uloop_slab_class_t* slab = uloop_slab_classes;
+	while ((slab < &uloop_slab_classes[ULOOP_SLAB_COUNT - 1]) && (offset >= slab[1].offset)) {
+		slab += 1;
+	}
+	uint32_t block = slab->first + ((offset - slab->offset) / slab->size);
+	ULOOP_DEV_ASSERT(slab_retained[block] > 0);
+	slab_retained[block] -= 1;
+	if (slab_retained[block] == 0) {
+		slab_release(block);
+	}
+#else
+	ULOOP_DEV_ASSERT(data_queue.retained > 0);
+	data_queue.retained -= 1;
+	if (data_queue.retained == 0) {
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		data_queue_release();
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+	}
+#endif
+}
+#endif
+
+static inline void run_event(uloop_event_queue_item_t event, const uint8_t* data) {
+#if ULOOP_DATA_QUEUE_SIZE > 0
+#ifdef ULOOP_COALESCE_DATA_SIZE
+	uint32_t buffer[ULOOP_COALESCE_SLOT_SIZE / 4];
+#endif
+	if (!EVENT_QUEUE_ABORTED(event)) {
+		// aborted reservations carry no event
+#ifdef ULOOP_COALESCE
+		if (coalesce_enabled(event.id)) {
+			// cleared first, a publish from now on queues the event again
+			coalesce_clear(event.id);
+#ifdef ULOOP_COALESCE_DATA_SIZE
+			if (uloop_coalesce_slots[event.id].size > 0) {
+				event.size = (uloop_data_size_t) coalesce_load(event.id, buffer);
+				data = (const uint8_t*) buffer;
+			}
+#endif
+		}
+#endif
+#ifdef ULOOP_STATISTICS_ENABLED
+		uloop_event_stats[event.id].count += 1;
+#endif
+#ifdef ULOOP_LATENCY_BUCKETS
+		latency_record(event);
+#endif
+		ULOOP_TRACE(ULOOP_TRACE_PRE_DISPATCH, event.id, ULOOP_LISTENER_NONE);
+		ULOOP_HOOK_PRE_DISPATCH(event.id, data, event.size);
+		dispatch(event.id, data, event.size);
+		ULOOP_HOOK_POST_DISPATCH(event.id, data, event.size);
+		ULOOP_TRACE(ULOOP_TRACE_POST_DISPATCH, event.id, ULOOP_LISTENER_NONE);
+#ifdef ULOOP_COALESCE_DATA_SIZE
+		// the latest value is a copy on the stack, it can not be retained
+		ULOOP_DEV_ASSERT((data != (const uint8_t*) buffer) || (data_retain_requests == 0));
+#endif
+	}
+#else
+	(void) data;
+#ifdef ULOOP_COALESCE
+	if (coalesce_enabled(event.id)) {
+		coalesce_clear(event.id);
+	}
+#endif
+#ifdef ULOOP_STATISTICS_ENABLED
+	uloop_event_stats[event.id].count += 1;
+#endif
+#ifdef ULOOP_LATENCY_BUCKETS
+	latency_record(event);
+#endif
+	ULOOP_TRACE(ULOOP_TRACE_PRE_DISPATCH, event.id, ULOOP_LISTENER_NONE);
+	ULOOP_HOOK_PRE_DISPATCH(event.id, NULL, 0);
+	dispatch(event.id, NULL, 0);
+	ULOOP_HOOK_POST_DISPATCH(event.id, NULL, 0);
+	ULOOP_TRACE(ULOOP_TRACE_POST_DISPATCH, event.id, ULOOP_LISTENER_NONE);
+#endif
+}
+
+#if defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT)
+bool uloop_queue_pending(void) {
+	return !event_queue_empty();
+}
+#endif
+
+bool uloop_run() {
+	bool executed;
+	RUN_ENTER(0);
+#if ULOOP_INSTANCE_COUNT > 1
+	mailbox_drain();
+#endif
+	if (!event_queue_empty()) {
+		uloop_event_queue_item_t event = event_queue_top();
+#ifdef ULOOP_SLAB_COUNT
+		const uint8_t* data = (event.size > 0) ? slab_data(event.block) : NULL;
+		run_event(event, data);
+		if (event.size > 0) {
+			slab_consume(event.block);
+		}
+#elif ULOOP_DATA_QUEUE_SIZE > 0
+		const uint8_t* data = (event.size > 0) ? data_queue_top(event.size) : NULL;
+		run_event(event, data);
+		if (event.size > 0) {
+			data_queue_pop(event.size);
+		}
+#else
+		run_event(event, NULL);
+#endif
+		event_queue_pop();
+		executed = true;
+	} else {
+#ifdef ULOOP_HOOK_IDLE
+		// checked again inside the critical section, so that a publish from an interrupt can not be missed
+		ULOOP_ATOMIC_BLOCK_ENTER();
+#ifdef ULOOP_PRIORITY_COUNT
+		// event_queue_empty takes the critical section itself, every publish sets a pending bit
+		if (priority_pending == 0) {
+#else
+		if (event_queue_empty()) {
+#endif
+			ULOOP_HOOK_IDLE();
+		}
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+#endif
+		executed = false;
+	}
+	RUN_LEAVE(0);
+	return executed;
+}
+
+#if !defined(ULOOP_LOCK_FREE_QUEUE) && !defined(ULOOP_PRODUCER_COUNT) && !defined(ULOOP_PRIORITY_COUNT)
+
+/*
+ * A batch works on a snapshot of the event queue tail taken when it begins.
+ * The event queue head is kept locally and the consumed data is released
+ * once in run_batch_commit, a data queue pop only moves the read offset
+ * within a short critical section. Events published while the batch runs
+ * are left for the next one.
+ */
+typedef struct {
+	uint32_t head;
+	uint32_t tail;
+#if (ULOOP_DATA_QUEUE_SIZE > 0) && !defined(ULOOP_SLAB_COUNT)
+	bool data_popped;
+#endif
+} run_batch_t;
+
+static inline void run_batch_begin(run_batch_t* batch) {
+#if ULOOP_INSTANCE_COUNT > 1
+	mailbox_drain();
+#endif
+	batch->head = event_queue.head;
+	batch->tail = SHARED_LOAD(&event_queue.ready);
+#if (ULOOP_DATA_QUEUE_SIZE > 0) && !defined(ULOOP_SLAB_COUNT)
+	batch->data_popped = false;
+#endif
+}
+
+static inline bool run_batch_step(run_batch_t* batch) {
+	bool executed;
+	if (batch->head != batch->tail) {
+		uloop_event_queue_item_t event = event_queue_take(batch->head);
+#ifdef ULOOP_SLAB_COUNT
+		// slab blocks are released one by one, there is nothing to share
+		if (event.size > 0) {
+			run_event(event, slab_data(event.block));
+			slab_consume(event.block);
+		} else {
+			run_event(event, NULL);
+		}
+#elif ULOOP_DATA_QUEUE_SIZE > 0
+		if (event.size > 0) {
+			run_event(event, &data_queue.data[data_queue.read]);
+			uint32_t read = data_queue.read + ((event.size + 3) & (~3));
+			// a producer wrapping right behind this entry moves the end, so the wrap is decided under the lock
+			ULOOP_ATOMIC_BLOCK_ENTER();
+			if (read > data_queue.end) {
+				ULOOP_ERROR_DQCORR();
+			} else if (read == data_queue.end) {
+				read = 0;
+			} else {
+				// do nothing
+			}
+			data_queue.read = read;
+			ULOOP_ATOMIC_BLOCK_LEAVE();
+			data_queue.retained += data_retain_requests;
+			data_retain_requests = 0;
+			batch->data_popped = true;
+		} else {
+			run_event(event, NULL);
+		}
+#else
+		run_event(event, NULL);
+#endif
+		batch->head = (batch->head + 1) % ULOOP_EVENT_QUEUE_SIZE;
+		executed = true;
+	} else {
+		executed = false;
+	}
+	return executed;
+}
+
+static inline void run_batch_commit(run_batch_t* batch) {
+#if (ULOOP_DATA_QUEUE_SIZE > 0) && !defined(ULOOP_SLAB_COUNT)
+	if (batch->data_popped && (data_queue.retained == 0)) {
+		ULOOP_ATOMIC_BLOCK_ENTER();
+		data_queue_release();
+		ULOOP_ATOMIC_BLOCK_LEAVE();
+	}
+#endif
+	event_queue_release(batch->head);
+}
+
+#else
+
+/* the consumer of the other queue modes is free of critical sections, batches run events one by one */
+typedef uint32_t run_batch_t;
+
+static inline void run_batch_begin(run_batch_t* batch) {
+	(void) batch;
+}
+
+static inline bool run_batch_step(run_batch_t* batch) {
+	(void) batch;
+	return uloop_run();
+}
+
+static inline void run_batch_commit(run_batch_t* batch) {
+	(void) batch;
+}
+
+#endif
+
+uint32_t uloop_run_batch(uint32_t max_events) {
+	run_batch_t batch;
+	uint32_t count = 0;
+	RUN_ENTER(0);
+	run_batch_begin(&batch);
+	while ((count < max_events) && run_batch_step(&batch)) {
+		count += 1;
+	}
+	run_batch_commit(&batch);
+	RUN_LEAVE(0);
+	return count;
+}
+
+uint32_t uloop_run_until_idle() {
+	uint32_t count = 0;
+	uint32_t executed;
+	RUN_ENTER(0);
+	do {
+		executed = uloop_run_batch(UINT32_MAX);
+		count += executed;
+	} while (executed > 0);
+	RUN_LEAVE(0);
+	return count;
+}
+
+#ifdef ULOOP_RUN_FOR_ENABLED
+#ifndef ULOOP_TIMESTAMP
+#error "runForEnabled requires ULOOP_TIMESTAMP() in uloop_platform.h"
+#endif
+
+uint32_t uloop_run_for(uint32_t budget) {
+	uint32_t count = 0;
+	bool running = true;
+	uint32_t start = ULOOP_TIMESTAMP();
+	RUN_ENTER(0);
+	while (running) {
+		run_batch_t batch;
+		bool executed = false;
+		run_batch_begin(&batch);
+		while (running && run_batch_step(&batch)) {
+			count += 1;
+			executed = true;
+			running = ((uint32_t) (ULOOP_TIMESTAMP() - start) < budget);
+		}
+		run_batch_commit(&batch);
+		running = running && executed;
+	}
+	RUN_LEAVE(0);
+	return count;
+}
+#endif
+
+#if !defined(ULOOP_LOCK_FREE_QUEUE) && !defined(ULOOP_PRODUCER_COUNT) && !defined(ULOOP_PRIORITY_COUNT)
+
+#if ULOOP_INSTANCE_COUNT > 1
+/* runs one message of an instance other than 0 right from its mailbox, the senders take turns */
+static bool mailbox_run(uloop_ctx_t* ctx) {
+	bool executed = false;
+	for (uint32_t i = 0; (i < ULOOP_INSTANCE_COUNT) && !executed; i++) {
+		uint32_t sender = (ctx->next + i) % ULOOP_INSTANCE_COUNT;
+		mailbox_t* box = mailbox(ctx->index, sender);
+		uint32_t head = box->head;
+		if (head != ATOMIC_LOAD(&box->tail)) {
+			const mailbox_message_t* message = &box->messages[head & (ULOOP_MAILBOX_SIZE - 1)];
+#if ULOOP_DATA_QUEUE_SIZE > 0
+			uloop_event_queue_item_t event = EVENT_QUEUE_ITEM(message->event, message->size);
+			const uint8_t* data = (message->size > 0) ? (const uint8_t*) message->data : NULL;
+#else
+			uloop_event_queue_item_t event = EVENT_QUEUE_ITEM(message->event, 0);
+			const uint8_t* data = NULL;
+#endif
+#ifdef ULOOP_LATENCY_BUCKETS
+			event.stamp = message->stamp;
+#endif
+			run_event(event, data);
+			ATOMIC_STORE(&box->head, head + 1);
+			ctx->next = (sender + 1) % ULOOP_INSTANCE_COUNT;
+			executed = true;
+		}
+	}
+	return executed;
+}
+#endif
+
+uloop_ctx_t* uloop_ctx_get(uint32_t instance) {
+	ULOOP_DEV_ASSERT(instance < ULOOP_INSTANCE_COUNT);
+	return &instances[instance];
+}
+
+bool uloop_run_ctx(uloop_ctx_t* ctx) {
+	bool executed;
+#if ULOOP_INSTANCE_COUNT > 1
+	if (ctx->index == 0) {
+		executed = uloop_run();
+	} else {
+		RUN_ENTER(ctx->index);
+		executed = mailbox_run(ctx);
+		RUN_LEAVE(ctx->index);
+	}
+#else
+	(void) ctx;
+	executed = uloop_run();
+#endif
+	return executed;
+}
+
+#endif
+
+void uloop_init() {
+#ifdef ULOOP_LOCK_FREE_QUEUE
+	event_queue.head = 0;
+	event_queue.tail = 0;
+	for (uint32_t i = 0; i < ULOOP_EVENT_QUEUE_SIZE; i++) {
+		event_queue.data[i].seq = 0;
+	}
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	data_queue.read = 0;
+	data_queue.retained = 0;
+#endif
+#elif defined(ULOOP_PRODUCER_COUNT)
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		producer_queues[i].head = 0;
+		producer_queues[i].tail = 0;
+		producer_queues[i].alloc = 0;
+		producer_queues[i].reserved = 0;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		producer_queues[i].data_head = 0;
+		producer_queues[i].data_tail = 0;
+		producer_queues[i].data_read = 0;
+		producer_queues[i].data_retained = 0;
+#endif
+	}
+#elif defined(ULOOP_PRIORITY_COUNT)
+	for (uint32_t i = 0; i < ULOOP_PRIORITY_COUNT; i++) {
+		priority_queues[i].head = 0;
+		priority_queues[i].tail = 0;
+		priority_queues[i].ready = 0;
+		priority_queues[i].reserved = 0;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		priority_queues[i].data_head = 0;
+		priority_queues[i].data_tail = 0;
+		priority_queues[i].data_read = 0;
+		priority_queues[i].data_retained = 0;
+#endif
+	}
+	priority_pending = 0;
+#else
+	event_queue.head = 0;
+	event_queue.tail = 0;
+	event_queue.ready = 0;
+	event_queue.reserved = 0;
+#ifdef ULOOP_OVERFLOW_REPLACE
+	event_queue.read = 0;
+#endif
+#ifdef ULOOP_OVERFLOW_RESERVES
+	reserve_free = 0;
+	for (uint32_t i = 0; i < ULOOP_OVERFLOW_RESERVES; i++) {
+		reserve_queued[i] = 0;
+		reserve_free += uloop_overflow_reserves[i];
+	}
+#endif
+#ifdef ULOOP_SLAB_COUNT
+	for (uint32_t i = 0; i < ULOOP_SLAB_COUNT; i++) {
+		const uloop_slab_class_t* slab = &uloop_slab_classes[i];
+		for (uint32_t j = 0; j < slab->count; j++) {
+			slab_next[slab->first + j] = ((j + 1) < slab->count) ? (slab->first + j + 1) : SLAB_NONE;
+		}
+		slab_free_heads[i] = slab->first;
+	}
+	memset(slab_retained, 0, sizeof(slab_retained));
+#ifdef ULOOP_STATISTICS_ENABLED
+	memset(uloop_slab_stats, 0, sizeof(uloop_slab_stats));
+#endif
+#elif ULOOP_DATA_QUEUE_SIZE > 0
+	data_queue.head = 0;
+	data_queue.tail = 0;
+	data_queue.end = ULOOP_DATA_QUEUE_SIZE;
+	data_queue.read = 0;
+	data_queue.retained = 0;
+#endif
+#endif
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	data_retain_requests = 0;
+#endif
+#ifdef ULOOP_COALESCE
+	memset(coalesce_pending, 0, sizeof(coalesce_pending));
+#endif
+#if !defined(ULOOP_LOCK_FREE_QUEUE) && !defined(ULOOP_PRODUCER_COUNT) && !defined(ULOOP_PRIORITY_COUNT)
+	for (uint32_t i = 0; i < ULOOP_INSTANCE_COUNT; i++) {
+		instances[i].index = i;
+#ifdef ULOOP_OVERFLOW
+		run_depth[i] = 0;
+#endif
+#if ULOOP_INSTANCE_COUNT > 1
+		instances[i].next = 0;
+		uloop_instance_active[i] = ULOOP_LISTENER_NONE;
+#endif
+	}
+#if ULOOP_INSTANCE_COUNT > 1
+	for (uint32_t i = 0; i < ((ULOOP_INSTANCE_COUNT * ULOOP_INSTANCE_COUNT) - 1); i++) {
+		mailboxes[i].head = 0;
+		mailboxes[i].tail = 0;
+	}
+#endif
+#endif
+#ifdef ULOOP_SYNC_DEPTH
+	memset(sync_depth, 0, sizeof(sync_depth));
+	memset(uloop_sync_time, 0, sizeof(uloop_sync_time));
+#endif
+#ifdef ULOOP_SUBSCRIPTIONS
+	memcpy(uloop_subscription_mask, uloop_subscription_defaults, sizeof(uloop_subscription_mask));
+	for (uint32_t event = 0; event < ULOOP_EVENT_COUNT; event++) {
+		uint32_t active = 0;
+		for (uint32_t pair = uloop_listener_lut[event]; uloop_listener_table[pair] != ULOOP_LISTENER_NONE; pair++) {
+			active += uloop_subscribed(pair) ? 1 : 0;
+		}
+		subscription_active[event] = (uint8_t) active;
+	}
+#endif
+#ifdef ULOOP_TRACE_SIZE
+	uloop_trace.magic = ULOOP_TRACE_MAGIC;
+	uloop_trace.size = ULOOP_TRACE_SIZE;
+#endif
+	ULOOP_HOOK_INIT();
+}
+
+uloop_event_queue_item_t uloop_event_queue_get(uint32_t offset) {
+	uloop_event_queue_item_t item = EVENT_QUEUE_ITEM(ULOOP_EVENT_NONE, 0);
+#ifdef ULOOP_LOCK_FREE_QUEUE
+	uint16_t head = COUNTER_EVENT(event_queue.head);
+	uint16_t size = COUNTER_EVENT(event_queue.tail) - head;
+	if (size > offset) {
+		item = event_queue.data[(head + offset) & (ULOOP_EVENT_QUEUE_SIZE - 1)].item;
+	}
+#elif defined(ULOOP_PRODUCER_COUNT)
+	uint32_t cursors[ULOOP_PRODUCER_COUNT];
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		cursors[i] = producer_queues[i].head;
+	}
+	while (true) {
+		const event_queue_slot_t* selected = NULL;
+		uint32_t index = 0;
+		for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+			if (cursors[i] != ATOMIC_LOAD(&producer_queues[i].tail)) {
+				const event_queue_slot_t* slot = &producer_queues[i].slots[cursors[i] & (ULOOP_EVENT_QUEUE_SIZE - 1)];
+				if ((selected == NULL) || ((int32_t) (slot->stamp - selected->stamp) < 0)) {
+					selected = slot;
+					index = i;
+				}
+			}
+		}
+		if (selected == NULL) {
+			break;
+		} else if (offset == 0) {
+			item = selected->item;
+			break;
+		} else {
+			cursors[index] += 1;
+			offset -= 1;
+		}
+	}
+#elif defined(ULOOP_PRIORITY_COUNT)
+	for (uint32_t level = ULOOP_PRIORITY_COUNT; level > 0; level--) {
+		const uloop_priority_level_t* config = &uloop_priority_levels[level - 1];
+		const priority_queue_t* queue = &priority_queues[level - 1];
+		uint32_t size = queue->ready - queue->head;
+		if (size > offset) {
+			item = priority_events[config->event_queue_offset + ((queue->head + offset) & (config->event_queue_size - 1))];
+			break;
+		}
+		offset -= size;
+	}
+#else
+	uint32_t size = (event_queue.ready - event_queue.head) & (ULOOP_EVENT_QUEUE_SIZE - 1);
+	if (size > offset) {
+		item = event_queue.data[(event_queue.head + offset) & (ULOOP_EVENT_QUEUE_SIZE - 1)];
+	}
+#endif
 	return item;
 }
@@ -8,6 +8,10 @@
 
 #include "uloop_config.h"
 
+#ifndef ULOOP_INSTANCE_COUNT
+#define ULOOP_INSTANCE_COUNT 1
+#endif
+
 #define ULOOP_LISTENER_NONE  ((uloop_listener_id_t) -1)
 #define ULOOP_EVENT_NONE     ((uloop_event_t) -1)
 
@@ -26,6 +30,19 @@ typedef uint16_t uloop_event_t;
 
 typedef uint8_t uloop_listener_id_t;
 
+#ifdef ULOOP_PRODUCER_COUNT
+typedef uint8_t uloop_producer_t;
+#endif
+
+#ifdef ULOOP_PRIORITY_COUNT
+typedef struct {
+	uint32_t event_queue_offset;
+	uint32_t event_queue_size;
+	uint32_t data_queue_offset;
+	uint32_t data_queue_size;
+} uloop_priority_level_t;
+#endif
+
 #if ULOOP_DATA_QUEUE_SIZE > 0
 typedef void (*uloop_listener_t)(uloop_event_t event, const void* data, uint32_t size);
 #else
@@ -40,21 +57,140 @@ typedef struct {
 
 typedef struct {
 	uint32_t runs;
-	uint32_t time_total;
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+	uint32_t samples;
+#endif
 	uint32_t time_max;
+	uint64_t time_total;
+#ifdef ULOOP_STATISTICS_BUCKETS
+	uint16_t histogram[ULOOP_STATISTICS_BUCKETS];
+#endif
 } uloop_listenter_stats_t;
 
 typedef struct {
 	uint32_t count;
+#if !defined(ULOOP_LOCK_FREE_QUEUE) && !defined(ULOOP_PRODUCER_COUNT) && !defined(ULOOP_PRIORITY_COUNT)
+	/* overflow policies and uloop_try_publish exist in the default queue mode only */
+	uint32_t drops;
+#endif
 } uloop_event_stats_t;
 
+/* what happens when an event does not fit the queues, see uloop_try_publish */
+#define ULOOP_OVERFLOW_FATAL        0
+#define ULOOP_OVERFLOW_DROP_NEW     1
+#define ULOOP_OVERFLOW_DROP_OLDEST  2
+#define ULOOP_OVERFLOW_BLOCK        3
+
+#ifdef ULOOP_OVERFLOW
+typedef struct {
+	uint8_t policy;
+	uint8_t reserve;
+} uloop_overflow_t;
+#endif
+
+#ifdef ULOOP_LATENCY_BUCKETS
+/*
+ * Time events spent queued in ULOOP_TIMESTAMP() units. Bucket 0 counts
+ * zero delays, bucket n delays of [2^(n-1), 2^n) and the last bucket
+ * everything above. When a counter would overflow all counters of the
+ * histogram are halved.
+ */
+typedef struct {
+	uint32_t max;
+	uint16_t histogram[ULOOP_LATENCY_BUCKETS];
+} uloop_event_latency_t;
+#endif
+
+#ifdef ULOOP_TRACE_SIZE
+#define ULOOP_TRACE_MAGIC          0x52544C55 /* "ULTR" */
+#define ULOOP_TRACE_PUBLISH        0
+#define ULOOP_TRACE_PRE_DISPATCH   1
+#define ULOOP_TRACE_POST_DISPATCH  2
+#define ULOOP_TRACE_PRE_EXECUTE    3
+#define ULOOP_TRACE_POST_EXECUTE   4
+
+typedef struct {
+	uint32_t stamp;
+	uint16_t event;
+	uint8_t listener;
+	uint8_t phase;
+} uloop_trace_record_t;
+
+/* head counts all records ever written, the newest is at (head - 1) % size */
+typedef struct {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t head;
+	uloop_trace_record_t records[ULOOP_TRACE_SIZE];
+} uloop_trace_t;
+#endif
+
+#ifdef ULOOP_SLAB_COUNT
+/* block sizes are multiples of 4, blocks of a class are numbered from first on */
+typedef struct {
+	uint32_t size;
+	uint16_t count;
+	uint16_t first;
+	uint32_t offset;
+} uloop_slab_class_t;
+
+typedef struct {
+	uint16_t used;
+	uint16_t peak;
+	uint32_t allocations;
+	uint32_t fallbacks;
+	uint64_t wasted;
+} uloop_slab_stats_t;
+#endif
+
+/* the queue entry only refers to slab blocks, so their payloads are not limited to a byte */
+#ifdef ULOOP_SLAB_COUNT
+#define ULOOP_DATA_SIZE_MAX 65535
+typedef uint16_t uloop_data_size_t;
+#else
+#define ULOOP_DATA_SIZE_MAX 255
+typedef uint8_t uloop_data_size_t;
+#endif
+
 typedef struct {
 	uloop_event_t id;
 #if ULOOP_DATA_QUEUE_SIZE > 0
-	uint8_t size;
+#if ULOOP_EVENT_COUNT > 255
+	/* all 256 ids are events, so aborted reservations are flagged here instead of carrying ULOOP_EVENT_NONE */
+	uint8_t aborted;
+#endif
+	uloop_data_size_t size;
+#endif
+#ifdef ULOOP_SLAB_COUNT
+	uint16_t block;
+#endif
+#ifdef ULOOP_LATENCY_BUCKETS
+	uint32_t stamp;
 #endif
 } uloop_event_queue_item_t;
 
+#ifdef ULOOP_COALESCE_DATA_SIZE
+typedef struct {
+	uint16_t offset;
+	uint8_t size;
+} uloop_coalesce_slot_t;
+#endif
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+typedef struct {
+	void* data;
+	uint32_t slot;
+#ifdef ULOOP_PRODUCER_COUNT
+	uloop_producer_t producer;
+#endif
+	uloop_event_t event;
+	uloop_data_size_t size;
+} uloop_reservation_t;
+#endif
+
+/* a loop instance, instance 0 is the one run by uloop_run */
+typedef struct uloop_ctx uloop_ctx_t;
+
 extern const uloop_listener_t uloop_listeners[ULOOP_LISTENER_COUNT];
 
 #ifdef ULOOP_METADATA_ENABLED
@@ -67,17 +203,130 @@ extern uloop_event_stats_t uloop_event_stats[ULOOP_EVENT_COUNT];
 extern uloop_listenter_stats_t uloop_listener_stats[ULOOP_LISTENER_COUNT];
 #endif
 
+#ifdef ULOOP_LATENCY_BUCKETS
+extern uloop_event_latency_t uloop_event_latency[ULOOP_EVENT_COUNT];
+#endif
+
+#ifdef ULOOP_DISPATCH_SWITCH
+void uloop_dispatch_generated(uloop_event_t event, const void* data, uint32_t size);
+#endif
+
+#if !defined(ULOOP_DISPATCH_SWITCH) || defined(ULOOP_SUBSCRIPTIONS)
 extern const uloop_listener_id_t uloop_listener_table[ULOOP_LISTENER_TABLE_SIZE];
 extern const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT];
+#endif
+
+#ifdef ULOOP_SUBSCRIPTIONS
+extern const uint32_t uloop_subscription_defaults[(ULOOP_LISTENER_TABLE_SIZE + 31) / 32];
+#endif
+
+#ifdef ULOOP_PRIORITY_COUNT
+extern const uloop_priority_level_t uloop_priority_levels[ULOOP_PRIORITY_COUNT];
+extern const uint8_t uloop_event_priority[ULOOP_EVENT_COUNT];
+#endif
+
+#ifdef ULOOP_COALESCE
+extern const uint32_t uloop_coalesce_events[(ULOOP_EVENT_COUNT + 31) / 32];
+#endif
+
+#ifdef ULOOP_COALESCE_DATA_SIZE
+extern const uloop_coalesce_slot_t uloop_coalesce_slots[ULOOP_EVENT_COUNT];
+#endif
+
+#ifdef ULOOP_OVERFLOW
+extern const uloop_overflow_t uloop_event_overflow[ULOOP_EVENT_COUNT];
+#endif
+
+#ifdef ULOOP_PARALLEL
+/* listeners run by the worker pool instead of the loop */
+extern const uint32_t uloop_listener_parallel[(ULOOP_LISTENER_COUNT + 31) / 32];
+#endif
+
+#if ULOOP_INSTANCE_COUNT > 1
+/* the instance an event is dispatched in is the one of its listeners */
+extern const uint8_t uloop_event_instance[ULOOP_EVENT_COUNT];
+extern const uint8_t uloop_listener_instance[ULOOP_LISTENER_COUNT];
+#endif
+
+#ifdef ULOOP_OVERFLOW_RESERVES
+extern const uint16_t uloop_overflow_reserves[ULOOP_OVERFLOW_RESERVES];
+#endif
+
+#ifdef ULOOP_SLAB_COUNT
+extern const uloop_slab_class_t uloop_slab_classes[ULOOP_SLAB_COUNT];
+#ifdef ULOOP_STATISTICS_ENABLED
+extern uloop_slab_stats_t uloop_slab_stats[ULOOP_SLAB_COUNT];
+#endif
+#endif
 
+#ifdef ULOOP_TRACE_SIZE
+extern uloop_trace_t uloop_trace;
+#endif
+
+#if ULOOP_INSTANCE_COUNT > 1
+/* every instance has its own active listener, uloop_listener_active is the one of instance 0 */
+extern uloop_listener_id_t uloop_instance_active[ULOOP_INSTANCE_COUNT];
+#define uloop_listener_active  (uloop_instance_active[0])
+#else
 extern uloop_listener_id_t uloop_listener_active;
+#endif
 
 bool uloop_run(void);
+uint32_t uloop_run_batch(uint32_t max_events);
+uint32_t uloop_run_until_idle(void);
+#ifdef ULOOP_RUN_FOR_ENABLED
+/* budget is in ULOOP_TIMESTAMP() units */
+uint32_t uloop_run_for(uint32_t budget);
+#endif
 void uloop_publish(uloop_event_t event);
 void uloop_init(void);
 
+#if defined(ULOOP_LATENCY_BUCKETS) || defined(ULOOP_STATISTICS_BUCKETS)
+uint32_t uloop_histogram_percentile(const uint16_t* histogram, uint32_t buckets, uint32_t permille);
+#endif
+
 #if ULOOP_DATA_QUEUE_SIZE > 0
 void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size);
+void* uloop_publish_reserve(uloop_reservation_t* reservation, uloop_event_t event, uint32_t size);
+void uloop_publish_commit(const uloop_reservation_t* reservation);
+void uloop_publish_abort(const uloop_reservation_t* reservation);
+void uloop_data_retain(const void* data);
+void uloop_data_release(const void* data);
+#endif
+
+#if !defined(ULOOP_LOCK_FREE_QUEUE) && !defined(ULOOP_PRODUCER_COUNT) && !defined(ULOOP_PRIORITY_COUNT)
+bool uloop_try_publish(uloop_event_t event);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+bool uloop_try_publish_ex(uloop_event_t event, const void* data, uint32_t size);
+#endif
+uloop_ctx_t* uloop_ctx_get(uint32_t instance);
+bool uloop_run_ctx(uloop_ctx_t* ctx);
+void uloop_publish_ctx(uloop_ctx_t* ctx, uloop_event_t event);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex_ctx(uloop_ctx_t* ctx, uloop_event_t event, const void* data, uint32_t size);
+#endif
+#endif
+
+#ifdef ULOOP_SYNC_DEPTH
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_sync(uloop_event_t event, const void* data, uint32_t size);
+#else
+void uloop_publish_sync(uloop_event_t event);
+#endif
+#endif
+
+#ifdef ULOOP_SUBSCRIPTIONS
+void uloop_listener_enable(uloop_listener_id_t listener, uloop_event_t event);
+void uloop_listener_disable(uloop_listener_id_t listener, uloop_event_t event);
+bool uloop_listener_enabled(uloop_listener_id_t listener, uloop_event_t event);
+#endif
+
+#ifdef ULOOP_PRODUCER_COUNT
+void uloop_publish_from(uloop_producer_t producer, uloop_event_t event);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_publish_ex_from(uloop_producer_t producer, uloop_event_t event, const void* data, uint32_t size);
+void* uloop_publish_reserve_from(uloop_producer_t producer, uloop_reservation_t* reservation, uloop_event_t event, uint32_t size);
+#endif
 #endif
 
 uloop_event_queue_item_t uloop_event_queue_get(uint32_t offset);
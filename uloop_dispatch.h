@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "uloop.h"
+#include "uloop_platform.h"
+
+/*
+ * Listener execution shared by the table dispatch in uloop.c and the
+ * generated switch dispatch in uloop_config.c. With a constant listener
+ * the indirect call becomes a direct one once uloop_execute is inlined.
+ */
+
+#define ULOOP_HOOK_NULL  do { /* empty */ } while (false)
+
+#ifndef ULOOP_HOOK_PRE_EXECUTE
+#define ULOOP_HOOK_PRE_EXECUTE(listener, event, data, size)  ULOOP_HOOK_NULL
+#endif
+
+#ifndef ULOOP_HOOK_POST_EXECUTE
+#define ULOOP_HOOK_POST_EXECUTE(listener, event, data, size) ULOOP_HOOK_NULL
+#endif
+
+#ifdef ULOOP_TRACE_SIZE
+/* lock-free, every writer claims its own record before filling it in */
+static inline void uloop_trace_record(uint32_t phase, uloop_event_t event, uint32_t listener) {
+	uint32_t index = __atomic_fetch_add(&uloop_trace.head, 1, __ATOMIC_RELAXED);
+	uloop_trace_record_t* record = &uloop_trace.records[index & (ULOOP_TRACE_SIZE - 1)];
+	record->stamp = ULOOP_TIMESTAMP();
+	record->event = event;
+	record->listener = (uint8_t) listener;
+	record->phase = (uint8_t) phase;
+}
+#define ULOOP_TRACE(phase, event, listener)  uloop_trace_record(phase, event, listener)
+#else
+#define ULOOP_TRACE(phase, event, listener)  ULOOP_HOOK_NULL
+#endif
+
+#ifndef ULOOP_CLZ
+#define ULOOP_CLZ(value)  __builtin_clz(value)
+#endif
+
+#if defined(ULOOP_LATENCY_BUCKETS) || defined(ULOOP_STATISTICS_BUCKETS)
+/* counts value in its log2 bucket, the histogram is halved instead of letting a counter overflow */
+static inline void uloop_histogram_add(uint16_t* histogram, uint32_t buckets, uint32_t value) {
+	uint32_t bucket = (value == 0) ? 0 : (32 - ULOOP_CLZ(value));
+	if (bucket >= buckets) {
+		bucket = buckets - 1;
+	}
+	if (histogram[bucket] == UINT16_MAX) {
+		for (uint32_t i = 0; i < buckets; i++) {
+			histogram[i] >>= 1;
+		}
+	}
+	histogram[bucket] += 1;
+}
+
+/* adds the counts of other to histogram, halved the same way when a sum does not fit */
+static inline void uloop_histogram_merge(uint16_t* histogram, const uint16_t* other, uint32_t buckets) {
+	bool halve = false;
+	for (uint32_t i = 0; i < buckets; i++) {
+		halve = halve || (((uint32_t) histogram[i] + other[i]) > UINT16_MAX);
+	}
+	for (uint32_t i = 0; i < buckets; i++) {
+		uint32_t count = (uint32_t) histogram[i] + other[i];
+		histogram[i] = (uint16_t) (halve ? (count >> 1) : count);
+	}
+}
+#endif
+
+#ifdef ULOOP_SUBSCRIPTIONS
+/* enable bits of the (event, listener) pairs, a pair has the bit of its position in uloop_listener_table */
+extern uint32_t uloop_subscription_mask[(ULOOP_LISTENER_TABLE_SIZE + 31) / 32];
+
+static inline bool uloop_subscribed(uint32_t pair) {
+	return (uloop_subscription_mask[pair / 32] & (1UL << (pair % 32))) != 0;
+}
+#endif
+
+#if ULOOP_INSTANCE_COUNT > 1
+#define ULOOP_INSTANCE_OF(listener)  uloop_listener_instance[listener]
+#define ULOOP_ACTIVE(instance)       uloop_instance_active[instance]
+#else
+#define ULOOP_INSTANCE_OF(listener)  0
+#define ULOOP_ACTIVE(instance)       uloop_listener_active
+#endif
+
+#ifdef ULOOP_SYNC_DEPTH
+/* time of the listeners run by uloop_publish_sync, it is not charged to the publishing listener */
+extern uint32_t uloop_sync_time[ULOOP_INSTANCE_COUNT];
+#endif
+
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+/* runs of each listener left until the next timed one */
+extern uint16_t uloop_listener_countdown[ULOOP_LISTENER_COUNT];
+#endif
+
+#ifdef ULOOP_STATISTICS_ENABLED
+static inline void uloop_update_listener_stats(uloop_listenter_stats_t* stats, uint32_t duration) {
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+	stats->samples += 1;
+#else
+	stats->runs += 1;
+#endif
+	stats->time_total += duration;
+	if (stats->time_max < duration) {
+		stats->time_max = duration;
+	}
+#ifdef ULOOP_STATISTICS_BUCKETS
+	uloop_histogram_add(stats->histogram, ULOOP_STATISTICS_BUCKETS, duration);
+#endif
+}
+#endif
+
+static inline __attribute__((always_inline)) void uloop_call(
+	uint32_t listener, uloop_listener_t function, uloop_event_t event, const void* data, uint32_t size
+) {
+	(void) listener;
+#if ULOOP_DATA_QUEUE_SIZE == 0
+	(void) data;
+	(void) size;
+#endif
+	ULOOP_TRACE(ULOOP_TRACE_PRE_EXECUTE, event, listener);
+	ULOOP_HOOK_PRE_EXECUTE(listener, event, data, size);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	function(event, data, size);
+#else
+	function(event);
+#endif
+	ULOOP_HOOK_POST_EXECUTE(listener, event, data, size);
+	ULOOP_TRACE(ULOOP_TRACE_POST_EXECUTE, event, listener);
+}
+
+static inline __attribute__((always_inline)) void uloop_call_timed(
+	uint32_t listener, uloop_listener_t function, uloop_event_t event, const void* data, uint32_t size
+) {
+	ULOOP_TIMER_START();
+#ifdef ULOOP_SYNC_DEPTH
+	uloop_sync_time[ULOOP_INSTANCE_OF(listener)] = 0;
+#endif
+	uloop_call(listener, function, event, data, size);
+	uint32_t duration = ULOOP_TIMER_STOP();
+#ifdef ULOOP_SYNC_DEPTH
+	duration -= uloop_sync_time[ULOOP_INSTANCE_OF(listener)];
+#endif
+#ifdef ULOOP_STATISTICS_ENABLED
+	uloop_update_listener_stats(&uloop_listener_stats[listener], duration);
+#endif
+#if ULOOP_LISTENER_TIME_LIMIT > 0
+	if (duration > ULOOP_LISTENER_TIME_LIMIT) {
+		ULOOP_ERROR_TMO(duration);
+	}
+#else
+	(void) duration;
+#endif
+}
+
+static inline __attribute__((always_inline)) void uloop_execute_local(
+	uint32_t listener, uloop_listener_t function, uloop_event_t event, const void* data, uint32_t size
+) {
+	ULOOP_ACTIVE(ULOOP_INSTANCE_OF(listener)) = listener;
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+	// only every ULOOP_STATISTICS_SAMPLE_RATE-th run of a listener is timed
+	uint32_t countdown = uloop_listener_countdown[listener];
+	uloop_listener_countdown[listener] = (countdown == 0) ? (ULOOP_STATISTICS_SAMPLE_RATE - 1) : (countdown - 1);
+#ifdef ULOOP_STATISTICS_ENABLED
+	uloop_listener_stats[listener].runs += 1;
+#endif
+	if (countdown == 0) {
+		uloop_call_timed(listener, function, event, data, size);
+	} else {
+		uloop_call(listener, function, event, data, size);
+	}
+#else
+	uloop_call_timed(listener, function, event, data, size);
+#endif
+	ULOOP_ACTIVE(ULOOP_INSTANCE_OF(listener)) = ULOOP_LISTENER_NONE;
+}
+
+#if defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT)
+/* an idle hook of these modes checks the queue again after announcing the sleep, publishes do not take the critical section */
+bool uloop_queue_pending(void);
+#endif
+
+#ifdef ULOOP_PARALLEL
+/* hands a copy of the event to the worker pool of the platform, see uloop_posix.c */
+void uloop_pool_submit(uint32_t listener, uloop_listener_t function, uloop_event_t event, const void* data, uint32_t size);
+
+static inline bool uloop_parallel(uint32_t listener) {
+	return (uloop_listener_parallel[listener / 32] & (1UL << (listener % 32))) != 0;
+}
+#endif
+
+static inline __attribute__((always_inline)) void uloop_execute(
+	uint32_t listener, uloop_listener_t function, uloop_event_t event, const void* data, uint32_t size
+) {
+#ifdef ULOOP_PARALLEL
+	if (uloop_parallel(listener)) {
+		uloop_pool_submit(listener, function, event, data, size);
+	} else {
+		uloop_execute_local(listener, function, event, data, size);
+	}
+#else
+	uloop_execute_local(listener, function, event, data, size);
+#endif
+}
@@ -4,10 +4,13 @@
 /* optional hooks */
 // #define ULOOP_HOOK_INIT()
 // #define ULOOP_HOOK_PUBLISH(event, data, size)
+// #define ULOOP_HOOK_POST_PUBLISH(event, data, size)  /* after the event is queued, for waking up another core */
 // #define ULOOP_HOOK_PRE_DISPATCH(event, data, size)
 // #define ULOOP_HOOK_POST_DISPATCH(event, data, size)
 // #define ULOOP_HOOK_PRE_EXECUTE(listener, event, data, size)
 // #define ULOOP_HOOK_POST_EXECUTE(listener, event, data, size)
+// #define ULOOP_HOOK_IDLE()                  /* called in a critical section, for example __WFI() */
+// #define ULOOP_TIMER_SET_COMPARE(deadline)  /* one-shot compare for tickless operation, fires at once for a passed deadline */
 
 /* error reporting */
 #define ULOOP_ERROR_EQOVF()        do {} while (1)
@@ -28,3 +31,9 @@
 
 /* systick access macro */
 #define ULOOP_SYSTICK()            0 /* should return 32-bit ms from system init */
+
+/* event timestamp macro, only needed when producers are declared or latencyBuckets, traceSize or runForEnabled is set */
+#define ULOOP_TIMESTAMP()          0 /* should return a free running 32-bit counter, for example a cycle counter */
+
+/* instance of the calling core, optional with more than one loop instance */
+// #define ULOOP_INSTANCE_CURRENT()   0 /* for example the core id */
@@ -0,0 +1,60 @@
+#pragma once
+#include "uloop.h"
+#include "uloop_posix.h"
+
+/*
+ * Platform for Linux and other POSIX hosts, include it from uloop_platform.h
+ * and build uloop_posix.c with -pthread. The critical section is a mutex, so
+ * events can be published from any thread.
+ */
+
+/* publishers run on other cores than the loop */
+#define ULOOP_SMP
+
+#ifndef ULOOP_HOOK_INIT
+#define ULOOP_HOOK_INIT()                      uloop_posix_init()
+#endif
+
+/* the loop waits for its fd sources while the queue is empty, leaving the critical section wakes it up */
+#ifndef ULOOP_HOOK_IDLE
+#define ULOOP_HOOK_IDLE()                      uloop_posix_idle()
+#endif
+
+/* these modes publish without the critical section, the loop is woken up once the event is queued */
+#if defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT)
+#ifndef ULOOP_HOOK_POST_PUBLISH
+#define ULOOP_HOOK_POST_PUBLISH(event, data, size)  uloop_posix_wakeup()
+#endif
+#endif
+
+/* the timer deadline arms the timerfd of uloop_fd_timer */
+#ifndef ULOOP_TIMER_SET_COMPARE
+#define ULOOP_TIMER_SET_COMPARE(deadline)      uloop_posix_timer_set(deadline)
+#endif
+
+/* error reporting */
+#define ULOOP_ERROR_EQOVF()        uloop_posix_fail("eqOVF", 0)
+#define ULOOP_ERROR_DQOVF()        uloop_posix_fail("dqOVF", 0)
+#define ULOOP_ERROR_DQCORR()       uloop_posix_fail("dqCORR", 0)
+#define ULOOP_ERROR_TMO(time_us)   uloop_posix_fail("TMO", time_us)
+
+/* development assert macro */
+#ifdef NDEBUG
+#define ULOOP_DEV_ASSERT(cond)     do { (void) sizeof(cond); } while (0)
+#else
+#define ULOOP_DEV_ASSERT(cond)     do { if (!(cond)) { uloop_posix_fail(#cond, __LINE__); } } while (0)
+#endif
+
+/* atomic block macros */
+#define ULOOP_ATOMIC_BLOCK_ENTER() uloop_posix_lock()
+#define ULOOP_ATOMIC_BLOCK_LEAVE() uloop_posix_unlock()
+
+/* microsecond timer macros, the start is a local of the timed block */
+#define ULOOP_TIMER_START()        uint32_t uloop_posix_timer = uloop_posix_us()
+#define ULOOP_TIMER_STOP()         (uloop_posix_us() - uloop_posix_timer)
+
+/* systick access macro */
+#define ULOOP_SYSTICK()            uloop_posix_ms()
+
+/* event timestamp macro */
+#define ULOOP_TIMESTAMP()          uloop_posix_ns()
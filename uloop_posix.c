@@ -0,0 +1,633 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "uloop_posix.h"
+#include "uloop.h"
+#include "uloop_platform.h"
+#include "uloop_dispatch.h"
+
+/*
+ * An idle loop waits in epoll_wait for its fd sources. Other threads queue
+ * events inside the critical section, so the one leaving it first after the
+ * loop went to sleep writes the eventfd. The lock-free and producer modes
+ * publish without the critical section, their ULOOP_HOOK_POST_PUBLISH wakeup
+ * looks at the flag after the event is queued and the loop looks at the queue
+ * again after setting it, so one of both sees the other.
+ */
+
+/* epoll data of the eventfd, the fd sources use their index */
+#define SOURCE_WAKEUP  UINT32_MAX
+#define SOURCE_BATCH   16
+
+#define SOURCE_FREE    0
+#define SOURCE_EVENT   1
+#define SOURCE_READ    2
+#define SOURCE_TIMER   3
+
+typedef struct {
+	int fd;
+	uint8_t kind;
+	uloop_event_t event;
+	uint32_t read_size;
+} fd_source_t;
+
+static pthread_mutex_t loop_lock = PTHREAD_MUTEX_INITIALIZER;
+static int loop_epoll = -1;
+static int loop_eventfd = -1;
+/* set while the loop is in epoll_wait, whoever clears it writes the eventfd */
+static bool loop_sleeping;
+
+static fd_source_t sources[ULOOP_FD_SOURCE_COUNT];
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static uint8_t source_buffer[ULOOP_DATA_SIZE_MAX];
+#endif
+
+static int timer_fd = -1;
+static uint32_t timer_deadline;
+static bool timer_set;
+
+static inline bool take_sleeping(void) {
+	return __atomic_load_n(&loop_sleeping, __ATOMIC_ACQUIRE) && __atomic_exchange_n(&loop_sleeping, false, __ATOMIC_ACQ_REL);
+}
+
+static void eventfd_signal(void) {
+	uint64_t count = 1;
+	ssize_t written = write(loop_eventfd, &count, sizeof(count));
+	(void) written;
+}
+
+void uloop_posix_init(void) {
+	if (loop_epoll < 0) {
+		loop_epoll = epoll_create1(EPOLL_CLOEXEC);
+		loop_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		struct epoll_event wakeup;
+		memset(&wakeup, 0, sizeof(wakeup));
+		wakeup.events = EPOLLIN;
+		wakeup.data.u32 = SOURCE_WAKEUP;
+		if ((loop_epoll < 0) || (loop_eventfd < 0) || (epoll_ctl(loop_epoll, EPOLL_CTL_ADD, loop_eventfd, &wakeup) != 0)) {
+			uloop_posix_fail("epoll", (uint32_t) errno);
+		}
+	}
+}
+
+void uloop_posix_lock(void) {
+	pthread_mutex_lock(&loop_lock);
+}
+
+void uloop_posix_unlock(void) {
+	// only a sleeping loop costs a syscall
+	bool sleeping = take_sleeping();
+	pthread_mutex_unlock(&loop_lock);
+	if (sleeping) {
+		eventfd_signal();
+	}
+}
+
+void uloop_posix_wakeup(void) {
+	// the queued event goes before the look at the flag
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (take_sleeping()) {
+		eventfd_signal();
+	}
+}
+
+static uint32_t source_find(int fd) {
+	uint32_t index = 0;
+	while ((index < ULOOP_FD_SOURCE_COUNT) && ((sources[index].kind == SOURCE_FREE) || (sources[index].fd != fd))) {
+		index += 1;
+	}
+	return index;
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+static void source_read(fd_source_t* source) {
+	ssize_t size = read(source->fd, source_buffer, source->read_size);
+	if (size > 0) {
+		uloop_publish_ex(source->event, source_buffer, (uint32_t) size);
+	} else if ((size == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))) {
+		// the end of the stream is published once without data, the fd is not watched anymore
+		uloop_fd_remove(source->fd);
+		uloop_publish(source->event);
+	} else {
+		// do nothing
+	}
+}
+#endif
+
+static void source_ready(uint32_t index) {
+	uint64_t count;
+	if (index == SOURCE_WAKEUP) {
+		// the eventfd only ends the wait
+		ssize_t size = read(loop_eventfd, &count, sizeof(count));
+		(void) size;
+	} else if (sources[index].kind == SOURCE_TIMER) {
+		ssize_t size = read(sources[index].fd, &count, sizeof(count));
+		if (size == sizeof(count)) {
+			uloop_publish(sources[index].event);
+		}
+	} else if (sources[index].kind == SOURCE_EVENT) {
+		// one-shot, the listener calls uloop_fd_arm once it handled the fd
+		uloop_publish(sources[index].event);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	} else if (sources[index].kind == SOURCE_READ) {
+		source_read(&sources[index]);
+#endif
+	} else {
+		// removed by an earlier fd of the same batch
+	}
+}
+
+/* called by uloop_run with the lock held, a publish after this point sees loop_sleeping when it leaves its critical section */
+void uloop_posix_idle(void) {
+	struct epoll_event ready[SOURCE_BATCH];
+	__atomic_store_n(&loop_sleeping, true, __ATOMIC_SEQ_CST);
+	int timeout = -1;
+#if defined(ULOOP_LOCK_FREE_QUEUE) || defined(ULOOP_PRODUCER_COUNT)
+	// an event queued before the flag was set did not wake anybody, the fd sources are still polled
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (uloop_queue_pending()) {
+		timeout = 0;
+	}
+#endif
+	pthread_mutex_unlock(&loop_lock);
+	int count = epoll_wait(loop_epoll, ready, SOURCE_BATCH, timeout);
+	__atomic_store_n(&loop_sleeping, false, __ATOMIC_RELEASE);
+	for (int i = 0; i < count; i++) {
+		source_ready(ready[i].data.u32);
+	}
+	pthread_mutex_lock(&loop_lock);
+}
+
+static bool source_add(int fd, uloop_event_t event, uint8_t kind, uint32_t read_size) {
+	uloop_posix_init();
+	uint32_t index = 0;
+	while ((index < ULOOP_FD_SOURCE_COUNT) && (sources[index].kind != SOURCE_FREE)) {
+		index += 1;
+	}
+	bool added = false;
+	if (index < ULOOP_FD_SOURCE_COUNT) {
+		struct epoll_event watch;
+		memset(&watch, 0, sizeof(watch));
+		watch.events = (kind == SOURCE_EVENT) ? (EPOLLIN | EPOLLONESHOT) : EPOLLIN;
+		watch.data.u32 = index;
+		added = (epoll_ctl(loop_epoll, EPOLL_CTL_ADD, fd, &watch) == 0);
+	}
+	if (added) {
+		sources[index].fd = fd;
+		sources[index].kind = kind;
+		sources[index].event = event;
+		sources[index].read_size = read_size;
+	}
+	return added;
+}
+
+bool uloop_fd_add(int fd, uloop_event_t event, uint32_t read_size) {
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	ULOOP_DEV_ASSERT(read_size <= ULOOP_DATA_SIZE_MAX);
+#else
+	ULOOP_DEV_ASSERT(read_size == 0);
+#endif
+	return source_add(fd, event, (read_size > 0) ? SOURCE_READ : SOURCE_EVENT, read_size);
+}
+
+void uloop_fd_arm(int fd) {
+	uint32_t index = source_find(fd);
+	ULOOP_DEV_ASSERT((index < ULOOP_FD_SOURCE_COUNT) && (sources[index].kind == SOURCE_EVENT));
+	struct epoll_event watch;
+	memset(&watch, 0, sizeof(watch));
+	watch.events = EPOLLIN | EPOLLONESHOT;
+	watch.data.u32 = index;
+	epoll_ctl(loop_epoll, EPOLL_CTL_MOD, fd, &watch);
+}
+
+void uloop_fd_remove(int fd) {
+	uint32_t index = source_find(fd);
+	if (index < ULOOP_FD_SOURCE_COUNT) {
+		epoll_ctl(loop_epoll, EPOLL_CTL_DEL, fd, NULL);
+		if (sources[index].kind == SOURCE_TIMER) {
+			timer_fd = -1;
+		}
+		sources[index].kind = SOURCE_FREE;
+	}
+}
+
+static inline uint64_t clock_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec;
+}
+
+/* the systick counts the milliseconds of CLOCK_MONOTONIC, a deadline that passed fires right away */
+static void timer_arm(void) {
+	uint64_t now = clock_ns();
+	int32_t delay = (int32_t) (timer_deadline - (uint32_t) (now / 1000000u));
+	// a deadline that already passed expires right away
+	uint64_t expiry = (delay > 0) ? (((now / 1000000u) + (uint64_t) delay) * 1000000u) : now;
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = (time_t) (expiry / 1000000000u);
+	spec.it_value.tv_nsec = (long) (expiry % 1000000000u);
+	timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+int uloop_fd_timer(uloop_event_t event) {
+	ULOOP_DEV_ASSERT(timer_fd < 0);
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	// the loop reads the expirations itself, the timerfd is never armed by a listener
+	bool added = (fd >= 0) && source_add(fd, event, SOURCE_TIMER, 0);
+	if (added) {
+		timer_fd = fd;
+		if (timer_set) {
+			timer_arm();
+		}
+	} else if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+void uloop_posix_timer_set(uint32_t deadline) {
+	timer_deadline = deadline;
+	timer_set = true;
+	if (timer_fd >= 0) {
+		timer_arm();
+	}
+}
+
+uint32_t uloop_posix_us(void) {
+	return (uint32_t) (clock_ns() / 1000u);
+}
+
+uint32_t uloop_posix_ms(void) {
+	return (uint32_t) (clock_ns() / 1000000u);
+}
+
+uint32_t uloop_posix_ns(void) {
+	return (uint32_t) clock_ns();
+}
+
+void uloop_posix_fail(const char* reason, uint32_t value) {
+	fprintf(stderr, "uloop: %s (%u)\n", reason, (unsigned) value);
+	abort();
+}
+
+#ifdef ULOOP_PARALLEL
+
+/*
+ * Worker pool for the listeners marked as parallel. Every listener has a
+ * FIFO of jobs and is scheduled on at most one worker at a time, so its
+ * events are still run one after another and in publishing order. A
+ * scheduled listener sits in the deque of a worker, the owner takes the
+ * newest one and idle workers steal the oldest ones of the others. Each
+ * worker keeps its own listener statistics, they are only summed up when
+ * read, so workers never write to a shared counter. A reader copies a shard
+ * under its sequence counter and retries when the worker updated it meanwhile.
+ */
+
+typedef struct pool_job {
+	struct pool_job* next;
+	uloop_listener_t function;
+	uloop_event_t event;
+	uint32_t size;
+	/* followed by a copy of the event data */
+} pool_job_t;
+
+typedef struct {
+	pthread_mutex_t lock;
+	pool_job_t* head;
+	pool_job_t* tail;
+	bool scheduled;
+} pool_listener_t;
+
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	uint32_t first;
+	uint32_t count;
+	uloop_listener_id_t deque[ULOOP_LISTENER_COUNT];
+#ifdef ULOOP_STATISTICS_ENABLED
+	uint32_t stats_seq;  /* odd while the worker updates stats */
+	uloop_listenter_stats_t stats[ULOOP_LISTENER_COUNT];
+#endif
+} pool_worker_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_ready_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done_cond = PTHREAD_COND_INITIALIZER;
+
+static pool_listener_t pool_listeners[ULOOP_LISTENER_COUNT];
+static pool_worker_t* pool_workers;
+static uint32_t pool_worker_count;
+static uint32_t pool_next_worker;
+static bool pool_running;
+/* listeners waiting in the deques, only raised with pool_lock held so sleeping workers can not miss it */
+static uint32_t pool_ready;
+/* jobs submitted and not run yet */
+static uint32_t pool_outstanding;
+
+static void deque_push(pool_worker_t* worker, uloop_listener_id_t listener, bool newest) {
+	pthread_mutex_lock(&worker->lock);
+	if (newest) {
+		worker->deque[(worker->first + worker->count) % ULOOP_LISTENER_COUNT] = listener;
+	} else {
+		worker->first = (worker->first + ULOOP_LISTENER_COUNT - 1) % ULOOP_LISTENER_COUNT;
+		worker->deque[worker->first] = listener;
+	}
+	worker->count += 1;
+	pthread_mutex_unlock(&worker->lock);
+	pthread_mutex_lock(&pool_lock);
+	__atomic_add_fetch(&pool_ready, 1, __ATOMIC_RELAXED);
+	pthread_cond_signal(&pool_ready_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static bool deque_take(pool_worker_t* worker, bool newest, uloop_listener_id_t* listener) {
+	pthread_mutex_lock(&worker->lock);
+	bool found = (worker->count > 0);
+	if (found) {
+		worker->count -= 1;
+		if (newest) {
+			*listener = worker->deque[(worker->first + worker->count) % ULOOP_LISTENER_COUNT];
+		} else {
+			*listener = worker->deque[worker->first];
+			worker->first = (worker->first + 1) % ULOOP_LISTENER_COUNT;
+		}
+	}
+	pthread_mutex_unlock(&worker->lock);
+	if (found) {
+		__atomic_sub_fetch(&pool_ready, 1, __ATOMIC_RELAXED);
+	}
+	return found;
+}
+
+#ifdef ULOOP_STATISTICS_ENABLED
+static void stats_add(uloop_listenter_stats_t* stats, const uloop_listenter_stats_t* shard) {
+	stats->runs += shard->runs;
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+	stats->samples += shard->samples;
+#endif
+	stats->time_total += shard->time_total;
+	if (stats->time_max < shard->time_max) {
+		stats->time_max = shard->time_max;
+	}
+#ifdef ULOOP_STATISTICS_BUCKETS
+	uloop_histogram_merge(stats->histogram, shard->histogram, ULOOP_STATISTICS_BUCKETS);
+#endif
+}
+
+/* only the worker itself writes its shard, the stores of the update can not pass the odd counter */
+static inline void stats_write_begin(pool_worker_t* worker) {
+	__atomic_store_n(&worker->stats_seq, worker->stats_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void stats_write_end(pool_worker_t* worker) {
+	__atomic_store_n(&worker->stats_seq, worker->stats_seq + 1, __ATOMIC_RELEASE);
+}
+
+/* a consistent copy of the shard of a running worker */
+static void stats_read(const pool_worker_t* worker, uloop_listener_id_t listener, uloop_listenter_stats_t* shard) {
+	uint32_t seq;
+	do {
+		seq = __atomic_load_n(&worker->stats_seq, __ATOMIC_ACQUIRE);
+		memcpy(shard, &worker->stats[listener], sizeof(*shard));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (((seq & 1) != 0) || (seq != __atomic_load_n(&worker->stats_seq, __ATOMIC_RELAXED)));
+}
+#endif
+
+/* uloop_execute_local for a worker, the statistics go to the shard of the worker */
+static void worker_call(pool_worker_t* worker, uloop_listener_id_t listener, const pool_job_t* job) {
+	const void* data = (job->size > 0) ? (const void*) (job + 1) : NULL;
+	bool timed = true;
+#ifdef ULOOP_STATISTICS_SAMPLE_RATE
+	uint32_t countdown = uloop_listener_countdown[listener];
+	uloop_listener_countdown[listener] = (countdown == 0) ? (ULOOP_STATISTICS_SAMPLE_RATE - 1) : (countdown - 1);
+#ifdef ULOOP_STATISTICS_ENABLED
+	stats_write_begin(worker);
+	worker->stats[listener].runs += 1;
+	stats_write_end(worker);
+#endif
+	timed = (countdown == 0);
+#endif
+	if (timed) {
+		ULOOP_TIMER_START();
+		uloop_call(listener, job->function, job->event, data, job->size);
+		uint32_t duration = ULOOP_TIMER_STOP();
+#ifdef ULOOP_STATISTICS_ENABLED
+		stats_write_begin(worker);
+		uloop_update_listener_stats(&worker->stats[listener], duration);
+		stats_write_end(worker);
+#else
+		(void) worker;
+#endif
+#if ULOOP_LISTENER_TIME_LIMIT > 0
+		if (duration > ULOOP_LISTENER_TIME_LIMIT) {
+			ULOOP_ERROR_TMO(duration);
+		}
+#else
+		(void) duration;
+#endif
+	} else {
+		uloop_call(listener, job->function, job->event, data, job->size);
+	}
+}
+
+/* runs the oldest job of a scheduled listener and puts the listener back when it has more */
+static void worker_run(pool_worker_t* worker, uloop_listener_id_t listener) {
+	pool_listener_t* entry = &pool_listeners[listener];
+	pthread_mutex_lock(&entry->lock);
+	pool_job_t* job = entry->head;
+	entry->head = job->next;
+	pthread_mutex_unlock(&entry->lock);
+	worker_call(worker, listener, job);
+	free(job);
+	pthread_mutex_lock(&entry->lock);
+	entry->scheduled = (entry->head != NULL);
+	bool more = entry->scheduled;
+	pthread_mutex_unlock(&entry->lock);
+	if (more) {
+		// behind the listeners already waiting, a busy listener can not hold the worker
+		deque_push(worker, listener, false);
+	}
+	if (__atomic_sub_fetch(&pool_outstanding, 1, __ATOMIC_ACQ_REL) == 0) {
+		pthread_mutex_lock(&pool_lock);
+		pthread_cond_broadcast(&pool_done_cond);
+		pthread_mutex_unlock(&pool_lock);
+	}
+}
+
+static void* worker_main(void* arg) {
+	pool_worker_t* worker = (pool_worker_t*) arg;
+	uint32_t index = (uint32_t) (worker - pool_workers);
+	while (__atomic_load_n(&pool_running, __ATOMIC_ACQUIRE)) {
+		uloop_listener_id_t listener = ULOOP_LISTENER_NONE;
+		bool found = deque_take(worker, true, &listener);
+		for (uint32_t i = 1; !found && (i < pool_worker_count); i++) {
+			found = deque_take(&pool_workers[(index + i) % pool_worker_count], false, &listener);
+		}
+		if (found) {
+			worker_run(worker, listener);
+		} else {
+			pthread_mutex_lock(&pool_lock);
+			while (__atomic_load_n(&pool_running, __ATOMIC_RELAXED) && (__atomic_load_n(&pool_ready, __ATOMIC_RELAXED) == 0)) {
+				pthread_cond_wait(&pool_ready_cond, &pool_lock);
+			}
+			pthread_mutex_unlock(&pool_lock);
+		}
+	}
+	return NULL;
+}
+
+void uloop_pool_submit(uint32_t listener, uloop_listener_t function, uloop_event_t event, const void* data, uint32_t size) {
+	if (pool_worker_count == 0) {
+		uloop_execute_local(listener, function, event, data, size);
+	} else {
+		// the data of the event is released once the dispatch returns, the job keeps a copy
+		pool_job_t* job = (pool_job_t*) malloc(sizeof(pool_job_t) + size);
+		if (job == NULL) {
+			uloop_posix_fail("pool", size);
+		}
+		job->next = NULL;
+		job->function = function;
+		job->event = event;
+		job->size = size;
+		if (size > 0) {
+			memcpy(job + 1, data, size);
+		}
+		__atomic_add_fetch(&pool_outstanding, 1, __ATOMIC_ACQ_REL);
+		pool_listener_t* entry = &pool_listeners[listener];
+		pthread_mutex_lock(&entry->lock);
+		if (entry->head == NULL) {
+			entry->head = job;
+		} else {
+			entry->tail->next = job;
+		}
+		entry->tail = job;
+		bool schedule = !entry->scheduled;
+		entry->scheduled = true;
+		pthread_mutex_unlock(&entry->lock);
+		if (schedule) {
+			// loop instances can submit from their own threads
+			uint32_t worker = __atomic_fetch_add(&pool_next_worker, 1, __ATOMIC_RELAXED) % pool_worker_count;
+			deque_push(&pool_workers[worker], (uloop_listener_id_t) listener, true);
+		}
+	}
+}
+
+void uloop_pool_start(uint32_t workers) {
+	ULOOP_DEV_ASSERT(pool_worker_count == 0);
+	if (workers == 0) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		workers = (online > 1) ? (uint32_t) (online - 1) : 0;
+	}
+	if (workers > 0) {
+		pool_workers = (pool_worker_t*) calloc(workers, sizeof(pool_worker_t));
+		if (pool_workers == NULL) {
+			uloop_posix_fail("pool", workers);
+		}
+		for (uint32_t i = 0; i < ULOOP_LISTENER_COUNT; i++) {
+			pthread_mutex_init(&pool_listeners[i].lock, NULL);
+			pool_listeners[i].head = NULL;
+			pool_listeners[i].tail = NULL;
+			pool_listeners[i].scheduled = false;
+		}
+		pool_next_worker = 0;
+		pool_ready = 0;
+		pool_outstanding = 0;
+		pool_running = true;
+		pool_worker_count = workers;
+		// every deque is ready before the first worker can steal from it
+		for (uint32_t i = 0; i < workers; i++) {
+			pthread_mutex_init(&pool_workers[i].lock, NULL);
+		}
+		for (uint32_t i = 0; i < workers; i++) {
+			if (pthread_create(&pool_workers[i].thread, NULL, worker_main, &pool_workers[i]) != 0) {
+				uloop_posix_fail("pool", i);
+			}
+		}
+	}
+}
+
+void uloop_pool_wait(void) {
+	pthread_mutex_lock(&pool_lock);
+	while (__atomic_load_n(&pool_outstanding, __ATOMIC_ACQUIRE) != 0) {
+		pthread_cond_wait(&pool_done_cond, &pool_lock);
+	}
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void uloop_pool_stop(void) {
+	if (pool_worker_count > 0) {
+		uloop_pool_wait();
+		pthread_mutex_lock(&pool_lock);
+		__atomic_store_n(&pool_running, false, __ATOMIC_RELEASE);
+		pthread_cond_broadcast(&pool_ready_cond);
+		pthread_mutex_unlock(&pool_lock);
+		for (uint32_t i = 0; i < pool_worker_count; i++) {
+			pthread_join(pool_workers[i].thread, NULL);
+		}
+		// a worker steals from the others until it stops, so no deque lock goes before all are joined
+		for (uint32_t i = 0; i < pool_worker_count; i++) {
+			pthread_mutex_destroy(&pool_workers[i].lock);
+#ifdef ULOOP_STATISTICS_ENABLED
+			// nothing is lost, the loop owns the statistics again
+			for (uint32_t listener = 0; listener < ULOOP_LISTENER_COUNT; listener++) {
+				stats_add(&uloop_listener_stats[listener], &pool_workers[i].stats[listener]);
+			}
+#endif
+		}
+		for (uint32_t i = 0; i < ULOOP_LISTENER_COUNT; i++) {
+			pthread_mutex_destroy(&pool_listeners[i].lock);
+		}
+		free(pool_workers);
+		pool_workers = NULL;
+		pool_worker_count = 0;
+	}
+}
+
+#ifdef ULOOP_STATISTICS_ENABLED
+void uloop_pool_listener_stats(uloop_listener_id_t listener, uloop_listenter_stats_t* stats) {
+	*stats = uloop_listener_stats[listener];
+	for (uint32_t i = 0; i < pool_worker_count; i++) {
+		uloop_listenter_stats_t shard;
+		stats_read(&pool_workers[i], listener, &shard);
+		stats_add(stats, &shard);
+	}
+}
+#endif
+
+#else
+
+void uloop_pool_start(uint32_t workers) {
+	(void) workers;
+}
+
+void uloop_pool_stop(void) {
+}
+
+void uloop_pool_wait(void) {
+}
+
+#ifdef ULOOP_STATISTICS_ENABLED
+void uloop_pool_listener_stats(uloop_listener_id_t listener, uloop_listenter_stats_t* stats) {
+	*stats = uloop_listener_stats[listener];
+}
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uloop.h"
+
+/*
+ * Linux host runtime, see uloop_platform_posix.h for the platform macros
+ * built on it. The loop itself keeps running on one thread, listeners
+ * marked as parallel are handed to the worker pool.
+ */
+
+/* fd sources, define it in uloop_platform.h before including uloop_platform_posix.h to change it */
+#ifndef ULOOP_FD_SOURCE_COUNT
+#define ULOOP_FD_SOURCE_COUNT  16
+#endif
+
+/* platform services used by the macros of uloop_platform_posix.h */
+void uloop_posix_init(void);
+void uloop_posix_lock(void);
+void uloop_posix_unlock(void);
+void uloop_posix_idle(void);
+void uloop_posix_wakeup(void);
+uint32_t uloop_posix_us(void);
+uint32_t uloop_posix_ms(void);
+uint32_t uloop_posix_ns(void);
+void uloop_posix_fail(const char* reason, uint32_t value);
+void uloop_posix_timer_set(uint32_t deadline);
+
+/*
+ * Watches fd while the loop is idle, the functions below are called from the
+ * loop thread. With read_size 0 the readiness is published once and the
+ * listener calls uloop_fd_arm after handling the fd, otherwise up to
+ * read_size bytes are read and published as the event data. The end of the
+ * stream is published without data and the fd is removed.
+ */
+bool uloop_fd_add(int fd, uloop_event_t event, uint32_t read_size);
+void uloop_fd_arm(int fd);
+void uloop_fd_remove(int fd);
+
+/* returns a timerfd publishing event at every ULOOP_TIMER_SET_COMPARE deadline, normally E_ULOOP_TIMER_UPDATE */
+int uloop_fd_timer(uloop_event_t event);
+
+/* starts the workers, 0 starts one per online CPU but the one of the loop */
+void uloop_pool_start(uint32_t workers);
+
+/* waits for the submitted jobs and stops the workers */
+void uloop_pool_stop(void);
+
+/* waits until every submitted job was run */
+void uloop_pool_wait(void);
+
+#ifdef ULOOP_STATISTICS_ENABLED
+/* statistics of a listener including the ones kept by the workers */
+void uloop_pool_listener_stats(uloop_listener_id_t listener, uloop_listenter_stats_t* stats);
+#endif
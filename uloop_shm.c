@@ -0,0 +1,325 @@
+// SPDX-License-Identifier: MIT
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "uloop_shm.h"
+#include "uloop.h"
+#include "uloop_platform.h"
+
+#ifndef ULOOP_SMP
+#error "the bridge publishes from its own thread, use a platform with ULOOP_SMP like uloop_platform_posix.h"
+#endif
+
+#define SHM_MAGIC      0x75736D31u
+#define SHM_ALIGN      8u
+#define SHM_ROUND(x)   (((x) + (SHM_ALIGN - 1)) & ~(SHM_ALIGN - 1))
+#define SHM_HEADER     SHM_ROUND((uint32_t) sizeof(uloop_event_queue_item_t))
+#define SHM_ENTRY(n)   (SHM_HEADER + SHM_ROUND(n))
+
+/* an event that did not fit the local queues is retried after a yield, later after a sleep */
+#define RETRY_YIELDS   1000
+#define RETRY_NS       100000
+
+#if defined(ULOOP_PRODUCER_COUNT) || defined(ULOOP_PRIORITY_COUNT)
+#error "the bridge publishes from its own thread, which needs the default or the lock-free queue mode"
+#endif
+
+#ifndef ULOOP_LOCK_FREE_QUEUE
+#define SHM_TRY_PUBLISH
+#endif
+
+/*
+ * Positions are free running byte counters, the tail is only written by the
+ * producer and the head only by the consumer, each on its own cache line.
+ * An entry never wraps, when it does not fit the end of the ring an entry
+ * with ULOOP_EVENT_NONE skips the rest of it.
+ */
+typedef struct {
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t head __attribute__((aligned(64)));
+	/* futex word, 1 while the consumer sleeps */
+	uint32_t waiting __attribute__((aligned(64)));
+} shm_ring_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t ring_size;
+	shm_ring_t rings[2];
+	/* followed by the data of both rings */
+} shm_segment_t;
+
+struct uloop_shm {
+	shm_segment_t* segment;
+	size_t length;
+	shm_ring_t* tx;
+	uint8_t* tx_data;
+	shm_ring_t* rx;
+	uint8_t* rx_data;
+	uint32_t mask;
+	/* tail after the open reservation */
+	uint32_t reserved;
+	pthread_t thread;
+	bool running;
+	uloop_shm_stats_t stats;
+};
+
+static uloop_shm_t* routes[ULOOP_EVENT_COUNT];
+
+static inline void futex_wait(uint32_t* word, uint32_t value) {
+	syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static inline void futex_wake(uint32_t* word) {
+	syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static inline uloop_event_queue_item_t* ring_item(uint8_t* data, uint32_t mask, uint32_t position) {
+	return (uloop_event_queue_item_t*) (data + (position & mask));
+}
+
+static inline uint32_t item_size(const uloop_event_queue_item_t* item) {
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	return item->size;
+#else
+	(void) item;
+	return 0;
+#endif
+}
+
+static bool deliver(const uloop_event_queue_item_t* item) {
+#ifdef SHM_TRY_PUBLISH
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	return uloop_try_publish_ex(item->id, ((const uint8_t*) item) + SHM_HEADER, item->size);
+#else
+	return uloop_try_publish(item->id);
+#endif
+#else
+	// the lock-free mode has no overflow policies, an event that does not fit is fatal
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	uloop_publish_ex(item->id, ((const uint8_t*) item) + SHM_HEADER, item->size);
+#else
+	uloop_publish(item->id);
+#endif
+	return true;
+#endif
+}
+
+/* publishes everything in the ring, returns false when the local loop has no room left */
+static bool receive(uloop_shm_t* bridge, uint32_t tail) {
+	uint32_t head = bridge->rx->head;
+	bool delivered = true;
+	while ((head != tail) && delivered) {
+		const uloop_event_queue_item_t* item = ring_item(bridge->rx_data, bridge->mask, head);
+		if (item->id == ULOOP_EVENT_NONE) {
+			head += (bridge->mask + 1) - (head & bridge->mask);
+		} else if (item->id >= ULOOP_EVENT_COUNT) {
+			// not an event of this process, the peer uses another configuration
+			head += SHM_ENTRY(item_size(item));
+		} else {
+			delivered = deliver(item);
+			if (delivered) {
+				head += SHM_ENTRY(item_size(item));
+				__atomic_add_fetch(&bridge->stats.received, 1, __ATOMIC_RELAXED);
+			}
+		}
+		__atomic_store_n(&bridge->rx->head, head, __ATOMIC_RELEASE);
+	}
+	return delivered;
+}
+
+static void* receiver_main(void* arg) {
+	uloop_shm_t* bridge = (uloop_shm_t*) arg;
+	uint32_t retries = 0;
+	while (__atomic_load_n(&bridge->running, __ATOMIC_SEQ_CST)) {
+		uint32_t tail = __atomic_load_n(&bridge->rx->tail, __ATOMIC_ACQUIRE);
+		if (tail != bridge->rx->head) {
+			if (receive(bridge, tail)) {
+				retries = 0;
+			} else if (retries < RETRY_YIELDS) {
+				retries += 1;
+				sched_yield();
+			} else {
+				struct timespec retry = {0, RETRY_NS};
+				nanosleep(&retry, NULL);
+			}
+		} else {
+			// the producer sees the flag after its tail store, or this sees the new tail
+			__atomic_store_n(&bridge->rx->waiting, 1, __ATOMIC_SEQ_CST);
+			if ((__atomic_load_n(&bridge->rx->tail, __ATOMIC_SEQ_CST) == bridge->rx->head) && __atomic_load_n(&bridge->running, __ATOMIC_SEQ_CST)) {
+				futex_wait(&bridge->rx->waiting, 1);
+			}
+			__atomic_store_n(&bridge->rx->waiting, 0, __ATOMIC_SEQ_CST);
+		}
+	}
+	return NULL;
+}
+
+uloop_shm_t* uloop_shm_map(int fd, uint32_t ring_size, uint32_t side) {
+	ULOOP_DEV_ASSERT((side < 2) && (ring_size >= (2 * SHM_ALIGN)) && ((ring_size & (ring_size - 1)) == 0));
+	size_t length = sizeof(shm_segment_t) + (2 * (size_t) ring_size);
+	struct stat info;
+	bool sized = (side == 0) ? (ftruncate(fd, (off_t) length) == 0) : ((fstat(fd, &info) == 0) && ((size_t) info.st_size == length));
+	void* memory = sized ? mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	if (memory == MAP_FAILED) {
+		return NULL;
+	}
+	shm_segment_t* segment = (shm_segment_t*) memory;
+	if (side == 0) {
+		memset(segment, 0, sizeof(shm_segment_t));
+		segment->ring_size = ring_size;
+		__atomic_store_n(&segment->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+	} else if ((__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) || (segment->ring_size != ring_size)) {
+		munmap(memory, length);
+		return NULL;
+	} else {
+		// attached to a segment set up by side 0
+	}
+	uloop_shm_t* bridge = (uloop_shm_t*) calloc(1, sizeof(uloop_shm_t));
+	if (bridge == NULL) {
+		munmap(memory, length);
+		return NULL;
+	}
+	uint8_t* data = ((uint8_t*) memory) + sizeof(shm_segment_t);
+	bridge->segment = segment;
+	bridge->length = length;
+	bridge->tx = &segment->rings[side];
+	bridge->tx_data = data + ((size_t) side * ring_size);
+	bridge->rx = &segment->rings[side ^ 1];
+	bridge->rx_data = data + ((size_t) (side ^ 1) * ring_size);
+	bridge->mask = ring_size - 1;
+	bridge->reserved = bridge->tx->tail;
+	bridge->running = true;
+	if (pthread_create(&bridge->thread, NULL, receiver_main, bridge) != 0) {
+		munmap(memory, length);
+		free(bridge);
+		bridge = NULL;
+	}
+	return bridge;
+}
+
+uloop_shm_t* uloop_shm_open(const char* name, uint32_t ring_size, uint32_t side) {
+	int fd = shm_open(name, (side == 0) ? (O_RDWR | O_CREAT) : O_RDWR, 0600);
+	uloop_shm_t* bridge = NULL;
+	if (fd >= 0) {
+		// the mapping stays valid without the fd
+		bridge = uloop_shm_map(fd, ring_size, side);
+		close(fd);
+	}
+	return bridge;
+}
+
+void uloop_shm_close(uloop_shm_t* bridge) {
+	for (uint32_t event = 0; event < ULOOP_EVENT_COUNT; event++) {
+		if (routes[event] == bridge) {
+			routes[event] = NULL;
+		}
+	}
+	__atomic_store_n(&bridge->running, false, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&bridge->rx->waiting, 0, __ATOMIC_SEQ_CST);
+	futex_wake(&bridge->rx->waiting);
+	pthread_join(bridge->thread, NULL);
+	munmap(bridge->segment, bridge->length);
+	free(bridge);
+}
+
+void* uloop_shm_reserve(uloop_shm_t* bridge, uloop_event_t event, uint32_t size) {
+	ULOOP_DEV_ASSERT(event != ULOOP_EVENT_NONE);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	ULOOP_DEV_ASSERT(size <= ULOOP_DATA_SIZE_MAX);
+#else
+	ULOOP_DEV_ASSERT(size == 0);
+#endif
+	uint32_t tail = bridge->tx->tail;
+	uint32_t head = __atomic_load_n(&bridge->tx->head, __ATOMIC_ACQUIRE);
+	uint32_t length = SHM_ENTRY(size);
+	uint32_t room = (bridge->mask + 1) - (tail & bridge->mask);
+	uint32_t needed = (room < length) ? (room + length) : length;
+	if (((bridge->mask + 1) - (tail - head)) < needed) {
+		bridge->stats.drops += 1;
+		return NULL;
+	}
+	if (room < length) {
+		// not visible before the commit, the consumer stops at the old tail
+		ring_item(bridge->tx_data, bridge->mask, tail)->id = ULOOP_EVENT_NONE;
+		tail += room;
+	}
+	uloop_event_queue_item_t* item = ring_item(bridge->tx_data, bridge->mask, tail);
+	memset(item, 0, sizeof(uloop_event_queue_item_t));
+	item->id = event;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	item->size = (uloop_data_size_t) size;
+#endif
+	bridge->reserved = tail + length;
+	return ((uint8_t*) item) + SHM_HEADER;
+}
+
+void uloop_shm_commit(uloop_shm_t* bridge) {
+	uint32_t tail = bridge->tx->tail;
+	__atomic_store_n(&bridge->tx->tail, bridge->reserved, __ATOMIC_SEQ_CST);
+	bridge->stats.sent += 1;
+	// the consumer only sleeps on an empty ring, a ring that had entries needs no wakeup
+	if ((__atomic_load_n(&bridge->tx->head, __ATOMIC_SEQ_CST) == tail) && (__atomic_load_n(&bridge->tx->waiting, __ATOMIC_SEQ_CST) != 0)) {
+		__atomic_store_n(&bridge->tx->waiting, 0, __ATOMIC_SEQ_CST);
+		futex_wake(&bridge->tx->waiting);
+		bridge->stats.wakeups += 1;
+	}
+}
+
+bool uloop_shm_publish(uloop_shm_t* bridge, uloop_event_t event) {
+	bool reserved = (uloop_shm_reserve(bridge, event, 0) != NULL);
+	if (reserved) {
+		uloop_shm_commit(bridge);
+	}
+	return reserved;
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+bool uloop_shm_publish_ex(uloop_shm_t* bridge, uloop_event_t event, const void* data, uint32_t size) {
+	void* payload = uloop_shm_reserve(bridge, event, size);
+	if (payload != NULL) {
+		memcpy(payload, data, size);
+		uloop_shm_commit(bridge);
+	}
+	return payload != NULL;
+}
+#endif
+
+void uloop_shm_forward(uloop_shm_t* bridge, uloop_event_t event) {
+	ULOOP_DEV_ASSERT(event < ULOOP_EVENT_COUNT);
+	routes[event] = bridge;
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_shm_listener(uloop_event_t event, const void* data, uint32_t size) {
+	if (routes[event] != NULL) {
+		uloop_shm_publish_ex(routes[event], event, data, size);
+	}
+}
+#else
+void uloop_shm_listener(uloop_event_t event) {
+	if (routes[event] != NULL) {
+		uloop_shm_publish(routes[event], event);
+	}
+}
+#endif
+
+void uloop_shm_stats(const uloop_shm_t* bridge, uloop_shm_stats_t* stats) {
+	stats->sent = bridge->stats.sent;
+	stats->received = __atomic_load_n(&bridge->stats.received, __ATOMIC_RELAXED);
+	stats->drops = bridge->stats.drops;
+	stats->wakeups = bridge->stats.wakeups;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uloop.h"
+
+/*
+ * Event bridge between two processes running uloop on Linux. A shared
+ * memory segment holds one single producer ring per direction, entries are
+ * a uloop_event_queue_item_t followed by the payload. Events written by one
+ * side are published into the loop of the other side by its receiving
+ * thread, which sleeps on a futex while its ring is empty. Both processes
+ * have to use the same event ids for the bridged events.
+ */
+
+typedef struct uloop_shm uloop_shm_t;
+
+typedef struct {
+	uint32_t sent;
+	uint32_t received;
+	uint32_t drops;
+	uint32_t wakeups;
+} uloop_shm_stats_t;
+
+/* maps the segment name, side 0 creates it, side 1 attaches to it, ring_size is a power of two */
+uloop_shm_t* uloop_shm_open(const char* name, uint32_t ring_size, uint32_t side);
+
+/* same as uloop_shm_open on a fd from memfd_create, the fd is not closed */
+uloop_shm_t* uloop_shm_map(int fd, uint32_t ring_size, uint32_t side);
+
+/* stops the receiving thread and unmaps the segment */
+void uloop_shm_close(uloop_shm_t* bridge);
+
+/* space for size bytes of payload in the outgoing ring, NULL when it is full */
+void* uloop_shm_reserve(uloop_shm_t* bridge, uloop_event_t event, uint32_t size);
+
+/* makes the reserved event visible to the peer */
+void uloop_shm_commit(uloop_shm_t* bridge);
+
+bool uloop_shm_publish(uloop_shm_t* bridge, uloop_event_t event);
+#if ULOOP_DATA_QUEUE_SIZE > 0
+bool uloop_shm_publish_ex(uloop_shm_t* bridge, uloop_event_t event, const void* data, uint32_t size);
+#endif
+
+/* events dispatched to uloop_shm_listener are sent over bridge, NULL stops sending them */
+void uloop_shm_forward(uloop_shm_t* bridge, uloop_event_t event);
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_shm_listener(uloop_event_t event, const void* data, uint32_t size);
+#else
+void uloop_shm_listener(uloop_event_t event);
+#endif
+
+void uloop_shm_stats(const uloop_shm_t* bridge, uloop_shm_stats_t* stats);
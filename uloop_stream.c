@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: MIT
+
+#include <string.h>
+
+#include "uloop_stream.h"
+#include "uloop.h"
+#include "uloop_platform.h"
+
+#define FRAME_HEADER   3
+#define FRAME_LENGTH   0xFFFF
+#define LEB_MAX        3
+
+#define FLUSH_DONE     0
+#define FLUSH_PENDING  1
+#define FLUSH_BROKEN   2
+
+static uloop_stream_t* routes[ULOOP_EVENT_COUNT];
+
+/* CRC-16/CCITT-FALSE, bitwise so that no table is needed on small targets */
+static uint16_t crc16(const uint8_t* data, uint32_t size) {
+	uint16_t crc = 0xFFFF;
+	for (uint32_t i = 0; i < size; i++) {
+		crc ^= (uint16_t) data[i] << 8;
+		for (uint32_t bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+		}
+	}
+	return crc;
+}
+
+static inline uint32_t leb_write(uint8_t* data, uint32_t value) {
+	uint32_t length = 0;
+	while (value >= 0x80) {
+		data[length++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	data[length++] = (uint8_t) value;
+	return length;
+}
+
+/* returns the bytes used, 0 when the value is cut off or too long */
+static inline uint32_t leb_read(const uint8_t* data, uint32_t size, uint32_t* value) {
+	uint32_t length = 0;
+	uint32_t result = 0;
+	bool more = true;
+	while (more && (length < size) && (length < LEB_MAX)) {
+		result |= (uint32_t) (data[length] & 0x7F) << (7 * length);
+		more = (data[length] & 0x80) != 0;
+		length += 1;
+	}
+	*value = result;
+	return more ? 0 : length;
+}
+
+static inline uint32_t frame_capacity(const uloop_stream_t* stream) {
+	uint32_t size = (stream->config.tx_size < stream->config.rx_size) ? stream->config.tx_size : stream->config.rx_size;
+	size -= ULOOP_STREAM_OVERHEAD;
+	return (size > FRAME_LENGTH) ? FRAME_LENGTH : size;
+}
+
+/* writes the frame on from tx_sent until the link takes no more, returns false on a broken link */
+static bool link_write(uloop_stream_t* stream, uint32_t size) {
+	int32_t written = 1;
+	while ((stream->tx_sent < size) && (written > 0)) {
+		written = stream->config.write(stream->config.context, stream->config.tx_buffer + stream->tx_sent, size - stream->tx_sent);
+		if (written > 0) {
+			stream->tx_sent += (uint32_t) written;
+		}
+	}
+	return written >= 0;
+}
+
+static inline void batch_reset(uloop_stream_t* stream) {
+	stream->tx_used = 0;
+	stream->tx_events = 0;
+	stream->tx_sent = 0;
+}
+
+/*
+ * Writes the batch as a frame. A frame the link did not take completely is
+ * kept as it is and continued by the next call, new events wait for it. On
+ * a broken link the frame is dropped together with its events.
+ */
+static uint32_t frame_write(uloop_stream_t* stream) {
+	uint32_t length = stream->tx_used;
+	uint32_t status = FLUSH_DONE;
+	if (length > 0) {
+		uint8_t* tx = stream->config.tx_buffer;
+		if (stream->tx_sent == 0) {
+			tx[0] = ULOOP_STREAM_SYNC;
+			tx[1] = (uint8_t) length;
+			tx[2] = (uint8_t) (length >> 8);
+			uint16_t crc = crc16(tx + 1, length + 2);
+			tx[FRAME_HEADER + length] = (uint8_t) crc;
+			tx[FRAME_HEADER + length + 1] = (uint8_t) (crc >> 8);
+		}
+		if (!link_write(stream, length + ULOOP_STREAM_OVERHEAD)) {
+			stream->stats.drops += stream->tx_events;
+			batch_reset(stream);
+			status = FLUSH_BROKEN;
+		} else if (stream->tx_sent == (length + ULOOP_STREAM_OVERHEAD)) {
+			stream->stats.frames_sent += 1;
+			batch_reset(stream);
+		} else {
+			status = FLUSH_PENDING;
+		}
+	}
+	return status;
+}
+
+static void publish_records(uloop_stream_t* stream, const uint8_t* data, uint32_t length) {
+	uint32_t position = 0;
+	while (position < length) {
+		uint32_t event;
+		uint32_t size = 0;
+		uint32_t used = leb_read(data + position, length - position, &event);
+		uint32_t used_size = (used > 0) ? leb_read(data + position + used, length - position - used, &size) : 0;
+		if ((used_size == 0) || (size > (length - position - used - used_size))) {
+			// the CRC matched, the peer wrote a broken frame and the rest of it is dropped
+			stream->stats.drops += 1;
+			position = length;
+			continue;
+		}
+		position += used + used_size;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+		if ((event < ULOOP_EVENT_COUNT) && (size <= ULOOP_DATA_SIZE_MAX)) {
+			uloop_publish_ex((uloop_event_t) event, data + position, size);
+#else
+		if ((event < ULOOP_EVENT_COUNT) && (size == 0)) {
+			uloop_publish((uloop_event_t) event);
+#endif
+			stream->stats.events_received += 1;
+		} else {
+			// not an event of this side, the peer uses another configuration
+			stream->stats.drops += 1;
+		}
+		position += size;
+	}
+}
+
+static void receive(uloop_stream_t* stream) {
+	const uint8_t* rx = stream->config.rx_buffer;
+	uint32_t used = stream->rx_used;
+	uint32_t start = 0;
+	uint32_t capacity = frame_capacity(stream);
+	bool complete = true;
+	while (complete) {
+		while ((start < used) && (rx[start] != ULOOP_STREAM_SYNC)) {
+			start += 1;
+			stream->stats.skipped += 1;
+		}
+		complete = (used - start) >= FRAME_HEADER;
+		uint32_t length = complete ? (rx[start + 1] | ((uint32_t) rx[start + 2] << 8)) : 0;
+		if (!complete) {
+			// wait for the length
+		} else if (length > capacity) {
+			// not a frame start, the sync byte was part of something else
+			start += 1;
+			stream->stats.skipped += 1;
+		} else if ((used - start) < (length + ULOOP_STREAM_OVERHEAD)) {
+			complete = false;
+		} else if (crc16(rx + start + 1, length + 2) != (rx[start + FRAME_HEADER + length] | ((uint32_t) rx[start + FRAME_HEADER + length + 1] << 8))) {
+			stream->stats.crc_errors += 1;
+			start += 1;
+		} else {
+			publish_records(stream, rx + start + FRAME_HEADER, length);
+			stream->stats.frames_received += 1;
+			start += length + ULOOP_STREAM_OVERHEAD;
+		}
+	}
+	memmove(stream->config.rx_buffer, rx + start, used - start);
+	stream->rx_used = used - start;
+}
+
+void uloop_stream_init(uloop_stream_t* stream, const uloop_stream_config_t* config) {
+	ULOOP_DEV_ASSERT((config->tx_size > ULOOP_STREAM_OVERHEAD) && (config->rx_size > ULOOP_STREAM_OVERHEAD));
+	memset(stream, 0, sizeof(uloop_stream_t));
+	stream->config = *config;
+}
+
+bool uloop_stream_flush(uloop_stream_t* stream) {
+	return frame_write(stream) == FLUSH_DONE;
+}
+
+bool uloop_stream_send(uloop_stream_t* stream, uloop_event_t event, const void* data, uint32_t size) {
+	uint8_t header[2 * LEB_MAX];
+	uint32_t length = leb_write(header, event);
+	length += leb_write(header + length, size);
+	uint32_t capacity = frame_capacity(stream);
+	bool sent = (length + size) <= capacity;
+	if (sent && ((stream->tx_sent > 0) || ((stream->tx_used + length + size) > capacity))) {
+		sent = (frame_write(stream) == FLUSH_DONE);
+	}
+	if (sent) {
+		uint8_t* record = stream->config.tx_buffer + FRAME_HEADER + stream->tx_used;
+		if (stream->tx_used == 0) {
+			stream->tx_since = ULOOP_SYSTICK();
+		}
+		memcpy(record, header, length);
+		if (size > 0) {
+			memcpy(record + length, data, size);
+		}
+		stream->tx_used += length + size;
+		stream->tx_events += 1;
+		stream->stats.events_sent += 1;
+		if (stream->tx_used >= stream->config.batch_size) {
+			// a frame the link did not take completely still carries the event
+			sent = (frame_write(stream) != FLUSH_BROKEN);
+		}
+	} else {
+		stream->stats.drops += 1;
+	}
+	return sent;
+}
+
+bool uloop_stream_poll(uloop_stream_t* stream) {
+	bool received = false;
+	if ((stream->config.read != NULL) && (stream->rx_used < stream->config.rx_size)) {
+		int32_t count = stream->config.read(stream->config.context, stream->config.rx_buffer + stream->rx_used, stream->config.rx_size - stream->rx_used);
+		if (count > 0) {
+			stream->rx_used += (uint32_t) count;
+			receive(stream);
+			received = true;
+		}
+	}
+	if ((stream->tx_sent > 0) || ((stream->tx_used > 0) && ((uint32_t) (ULOOP_SYSTICK() - stream->tx_since) >= stream->config.flush_ticks))) {
+		(void) frame_write(stream);
+	}
+	return received;
+}
+
+void uloop_stream_forward(uloop_stream_t* stream, uloop_event_t event) {
+	ULOOP_DEV_ASSERT(event < ULOOP_EVENT_COUNT);
+	routes[event] = stream;
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_stream_listener(uloop_event_t event, const void* data, uint32_t size) {
+	if (routes[event] != NULL) {
+		uloop_stream_send(routes[event], event, data, size);
+	}
+}
+#else
+void uloop_stream_listener(uloop_event_t event) {
+	if (routes[event] != NULL) {
+		uloop_stream_send(routes[event], event, NULL, 0);
+	}
+}
+#endif
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uloop.h"
+
+/*
+ * Mirrors events over a byte stream like a UART or USB-CDC link. Events are
+ * collected into a batch that is sent as one frame once it reaches
+ * batch_size bytes or waited flush_ticks systicks. A frame is
+ *
+ *   0x7E | length (16 bit, little endian) | records | CRC-16/CCITT (little endian)
+ *
+ * with a record being the event id and the data size as LEB128 followed by
+ * the data, the CRC covers the length and the records. The receiving side
+ * republishes the events, frames with a bad CRC are dropped and the stream
+ * is scanned for the next 0x7E. Both sides have to use the same event ids.
+ */
+
+#define ULOOP_STREAM_SYNC      0x7E
+#define ULOOP_STREAM_OVERHEAD  5
+
+/* returns the amount of bytes taken, 0 when the link takes nothing right now and a negative value on a broken link */
+typedef int32_t (*uloop_stream_write_t)(void* context, const uint8_t* data, uint32_t size);
+
+/* returns the amount of bytes read, 0 when nothing is available and a negative value on a broken link */
+typedef int32_t (*uloop_stream_read_t)(void* context, uint8_t* data, uint32_t size);
+
+typedef struct {
+	uloop_stream_write_t write;
+	uloop_stream_read_t read;
+	void* context;
+	/* the largest frame is limited by the smaller of the two buffers */
+	uint8_t* tx_buffer;
+	uint32_t tx_size;
+	uint8_t* rx_buffer;
+	uint32_t rx_size;
+	/* record bytes that are sent right away, 0 sends every event on its own */
+	uint32_t batch_size;
+	/* time a batch waits for more events, checked by uloop_stream_poll */
+	uint32_t flush_ticks;
+} uloop_stream_config_t;
+
+typedef struct {
+	uint32_t events_sent;
+	uint32_t events_received;
+	uint32_t frames_sent;
+	uint32_t frames_received;
+	uint32_t drops;
+	uint32_t crc_errors;
+	uint32_t skipped;
+} uloop_stream_stats_t;
+
+typedef struct {
+	uloop_stream_config_t config;
+	uint32_t tx_used;
+	uint32_t tx_events;
+	/* bytes of the current frame the link took so far */
+	uint32_t tx_sent;
+	uint32_t tx_since;
+	uint32_t rx_used;
+	uloop_stream_stats_t stats;
+} uloop_stream_t;
+
+void uloop_stream_init(uloop_stream_t* stream, const uloop_stream_config_t* config);
+
+/* adds an event to the batch, false when it was dropped as it can not fit into a frame or the link is busy or broken */
+bool uloop_stream_send(uloop_stream_t* stream, uloop_event_t event, const void* data, uint32_t size);
+
+/* sends the pending batch, false while the link did not take all of it or when it broke */
+bool uloop_stream_flush(uloop_stream_t* stream);
+
+/*
+ * Reads the link once, publishes the events of the complete frames, sends
+ * a batch that waited long enough and goes on with a frame the link did not
+ * take completely. Returns true when something was read, a single call
+ * publishes at most the events that fit into rx_size.
+ */
+bool uloop_stream_poll(uloop_stream_t* stream);
+
+/* events dispatched to uloop_stream_listener are sent over stream, NULL stops sending them */
+void uloop_stream_forward(uloop_stream_t* stream, uloop_event_t event);
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_stream_listener(uloop_event_t event, const void* data, uint32_t size);
+#else
+void uloop_stream_listener(uloop_event_t event);
+#endif
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: MIT
 
+#include <string.h>
+
 #include "uloop_timer.h"
 #include "uloop.h"
 #include "uloop_platform.h"
@@ -7,35 +9,272 @@
 
 #define RUN_THRESHOLD ((int32_t)0xFFFF0000)
 
-#if ULOOP_TIMER_COUNT > 1
-static uint32_t timeouts[ULOOP_TIMER_COUNT];
+#ifndef ULOOP_TIMER_SET_COMPARE
+#define ULOOP_TIMER_SET_COMPARE(deadline) do { /* empty */ } while (false)
+#endif
+
+/* pool timers are scheduled as timers ULOOP_TIMER_COUNT and up */
+#ifdef ULOOP_TIMER_POOL_SIZE
+#define TIMER_SLOTS (ULOOP_TIMER_COUNT + ULOOP_TIMER_POOL_SIZE)
+#else
+#define TIMER_SLOTS ULOOP_TIMER_COUNT
+#endif
+
+#if TIMER_SLOTS > 1
+static uint32_t timeouts[TIMER_SLOTS];
 #else
 static uint32_t timeouts[1];
 #endif
 
+#ifdef ULOOP_TIMER_PERIODIC
+/* reload value of each timer, zero for one-shot timers */
+static uint32_t periods[sizeof(timeouts) / sizeof(timeouts[0])];
+#endif
+
 volatile uint32_t uloop_timer_current;
 
+/* the deadline handed to the port may already have passed, the port has to fire right away then */
+static inline void set_current(uint32_t value) {
+	uloop_timer_current = value;
+	ULOOP_TIMER_SET_COMPARE(value + 1);
+}
+
+#ifdef ULOOP_TIMER_PERIODIC
+/*
+ * Moves the timeout of a expired periodic timer forward by whole periods,
+ * counting from the previous deadline and not from the current systick so
+ * that listener latency does not accumulate. Periods that already passed
+ * are coalesced into a single expiry, their count is reported to the
+ * listener as event data.
+ */
+static inline void expire_periodic(uloop_timer_t timer, uint32_t systick) {
+	uint32_t period = periods[timer];
+	uint32_t timeout = timeouts[timer] + period;
+	uint32_t missed = 0;
+	if ((int32_t)(timeout - systick) < 0) {
+		missed = ((systick - timeout) + period - 1) / period;
+		timeout += missed * period;
+	}
+	timeouts[timer] = timeout;
+#if ULOOP_DATA_QUEUE_SIZE > 0
+	if (missed > 0) {
+		uloop_publish_ex(uloop_timer_events[timer], &missed, sizeof(missed));
+	} else {
+		uloop_publish(uloop_timer_events[timer]);
+	}
+#else
+	uloop_publish(uloop_timer_events[timer]);
+#endif
+}
+#endif
+
+#ifdef ULOOP_TIMER_POOL_SIZE
+
+#define POOL_NONE    ((uint16_t)-1)
+#define POOL_HANDLE(index) (((uint32_t) pool[index].generation << 16) | (index))
+
+/*
+ * Anonymous timers backing uloop_publish_delayed. Free entries are linked
+ * through next, so allocating and freeing an entry is O(1). The generation
+ * is bumped on every free, a handle carries it to detect a stale cancel.
+ */
+typedef struct {
+	uint16_t generation;
+	uint16_t next;
+	uloop_event_t event;
+#if ULOOP_TIMER_POOL_DATA_SIZE > 0
+	uint8_t size;
+	uint8_t data[ULOOP_TIMER_POOL_DATA_SIZE];
+#endif
+} pool_entry_t;
+
+static pool_entry_t pool[ULOOP_TIMER_POOL_SIZE];
+static uint16_t pool_free;
+
+static inline void pool_release(uint32_t index) {
+	pool[index].generation += 1;
+	pool[index].next = pool_free;
+	pool_free = index;
+}
+
+static inline void pool_expire(uint32_t index) {
+	pool_release(index);
+	// the entry is not reused before the publish returns, the payload is still intact
+#if ULOOP_TIMER_POOL_DATA_SIZE > 0
+	uloop_publish_ex(pool[index].event, pool[index].data, pool[index].size);
+#else
+	uloop_publish(pool[index].event);
+#endif
+}
+
+#endif
+
+static inline void expire(uloop_timer_t timer) {
+#ifdef ULOOP_TIMER_POOL_SIZE
+	if (timer >= ULOOP_TIMER_COUNT) {
+		pool_expire(timer - ULOOP_TIMER_COUNT);
+	} else {
+		uloop_publish(uloop_timer_events[timer]);
+	}
+#else
+	uloop_publish(uloop_timer_events[timer]);
+#endif
+}
+
+#ifdef ULOOP_TIMER_HEAP
+
+#define HEAP_NONE ((uint32_t)-1)
+
+/*
+ * Running timers are kept in a binary min-heap ordered by their timeouts.
+ * heap_position maps a timer back to its heap slot (or HEAP_NONE when the
+ * timer is stopped) so that restarting and stopping a timer does not need
+ * a search. Start and stop are O(log n), the listener only touches the
+ * expired timers.
+ */
+static uloop_timer_t heap[sizeof(timeouts) / sizeof(timeouts[0])];
+static uint32_t heap_position[sizeof(timeouts) / sizeof(timeouts[0])];
+static uint32_t heap_size;
+
+static inline bool heap_before(uloop_timer_t a, uloop_timer_t b) {
+	return (int32_t)(timeouts[a] - timeouts[b]) < 0;
+}
+
+static inline void heap_set(uint32_t position, uloop_timer_t timer) {
+	heap[position] = timer;
+	heap_position[timer] = position;
+}
+
+static void heap_sift_up(uint32_t position) {
+	uloop_timer_t timer = heap[position];
+	while (position > 0) {
+		uint32_t parent = (position - 1) / 2;
+		if (!heap_before(timer, heap[parent])) {
+			break;
+		}
+		heap_set(position, heap[parent]);
+		position = parent;
+	}
+	heap_set(position, timer);
+}
+
+static void heap_sift_down(uint32_t position) {
+	uloop_timer_t timer = heap[position];
+	while (true) {
+		uint32_t child = (2 * position) + 1;
+		if (child >= heap_size) {
+			break;
+		}
+		if (((child + 1) < heap_size) && heap_before(heap[child + 1], heap[child])) {
+			child += 1;
+		}
+		if (!heap_before(heap[child], timer)) {
+			break;
+		}
+		heap_set(position, heap[child]);
+		position = child;
+	}
+	heap_set(position, timer);
+}
+
+/* restores the heap order after the timeout of the timer at position changed */
+static void heap_update(uint32_t position) {
+	if ((position > 0) && heap_before(heap[position], heap[(position - 1) / 2])) {
+		heap_sift_up(position);
+	} else {
+		heap_sift_down(position);
+	}
+}
+
+static void heap_remove(uloop_timer_t timer) {
+	uint32_t position = heap_position[timer];
+	heap_position[timer] = HEAP_NONE;
+	heap_size -= 1;
+	if (position < heap_size) {
+		heap_set(position, heap[heap_size]);
+		heap_update(position);
+	}
+}
+
+bool uloop_timer_running(uloop_timer_t timer) {
+	ULOOP_DEV_ASSERT(timer < ULOOP_TIMER_COUNT);
+	return heap_position[timer] != HEAP_NONE;
+}
+
+static void schedule(uloop_timer_t timer, uint32_t timeout) {
+	timeouts[timer] = timeout;
+	if (heap_position[timer] == HEAP_NONE) {
+		heap_set(heap_size, timer);
+		heap_size += 1;
+		heap_sift_up(heap_size - 1);
+	} else {
+		heap_update(heap_position[timer]);
+	}
+	if ((int32_t)(timeout - uloop_timer_current) < 0) {
+		set_current(timeout);
+	}
+}
+
+static void unschedule(uloop_timer_t timer) {
+	if (heap_position[timer] != HEAP_NONE) {
+		heap_remove(timer);
+	}
+}
+
+#if ULOOP_DATA_QUEUE_SIZE > 0
+void uloop_timer_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) data;
+	(void) size;
+	ULOOP_DEV_ASSERT(size == 0);
+#else
+void uloop_timer_listener(uloop_event_t event) {
+#endif
+	(void) event;
+	ULOOP_DEV_ASSERT(event == E_ULOOP_TIMER_UPDATE);
+	uint32_t systick = ULOOP_SYSTICK();
+	uint32_t next = systick + ULOOP_TIMER_UPDATE_PERIOD - 1;
+	while ((heap_size > 0) && ((int32_t)(timeouts[heap[0]] - systick) < 0)) {
+		uloop_timer_t timer = heap[0];
+#ifdef ULOOP_TIMER_PERIODIC
+		if (periods[timer] > 0) {
+			expire_periodic(timer, systick);
+			heap_sift_down(0);
+			continue;
+		}
+#endif
+		heap_remove(timer);
+		expire(timer);
+	}
+	if ((heap_size > 0) && ((int32_t)(next - timeouts[heap[0]]) > 0)) {
+		next = timeouts[heap[0]];
+	}
+	set_current(next);
+}
+
+static void reset(uint32_t systick) {
+	for (uint32_t i = 0; i < TIMER_SLOTS; i++) {
+		heap_position[i] = HEAP_NONE;
+	}
+	heap_size = 0;
+	set_current(systick + ULOOP_TIMER_UPDATE_PERIOD - 1);
+}
+
+#else
+
 bool uloop_timer_running(uloop_timer_t timer) {
 	ULOOP_DEV_ASSERT(timer < ULOOP_TIMER_COUNT);
 	int32_t diff = timeouts[timer] - ULOOP_SYSTICK();
 	return diff > RUN_THRESHOLD;
 }
 
-void uloop_timer_start_ex(uloop_timer_t timer, uint32_t value, bool relative) {
-	uint32_t systick = ULOOP_SYSTICK();
-	ULOOP_DEV_ASSERT(
-		(timer < ULOOP_TIMER_COUNT) &&
-		(!relative || (value <= ULOOP_TIMER_MAX_PERIOD))
-	);
-	uint32_t timeout = (relative ? (systick + value) : value) - 1;
+static void schedule(uloop_timer_t timer, uint32_t timeout) {
 	timeouts[timer] = timeout;
 	if ((int32_t)(timeout - uloop_timer_current) < 0) {
-		uloop_timer_current = timeout;
+		set_current(timeout);
 	}
 }
 
-void uloop_timer_stop(uloop_timer_t timer) {
-	ULOOP_DEV_ASSERT(timer < ULOOP_TIMER_COUNT);
+static void unschedule(uloop_timer_t timer) {
 	timeouts[timer] = ULOOP_SYSTICK() + RUN_THRESHOLD;
 }
 
@@ -52,23 +291,120 @@ void uloop_timer_listener(uloop_event_t event) {
 	uint32_t systick = ULOOP_SYSTICK();
 	uint32_t off_value = systick + RUN_THRESHOLD;
 	uint32_t next = systick + ULOOP_TIMER_UPDATE_PERIOD - 1;
-	for (uint32_t i = 0; i < ULOOP_TIMER_COUNT; i++) {
+	for (uint32_t i = 0; i < TIMER_SLOTS; i++) {
 		int32_t diff = timeouts[i] - systick;
 		if (diff < 0) {
-			if (diff > RUN_THRESHOLD) {
-				uloop_publish(uloop_timer_events[i]);
+#ifdef ULOOP_TIMER_PERIODIC
+			if ((periods[i] > 0) && (diff > RUN_THRESHOLD)) {
+				expire_periodic(i, systick);
+				if ((int32_t)(next - timeouts[i]) > 0) {
+					next = timeouts[i];
+				}
+				continue;
 			}
+#endif
 			timeouts[i] = off_value;
+			if (diff > RUN_THRESHOLD) {
+				expire(i);
+			}
 		} else if ((int32_t)(next - timeouts[i]) > 0) {
 			next = timeouts[i];
 		}
 	}
-	uloop_timer_current = next;
+	set_current(next);
 }
 
+static void reset(uint32_t systick) {
+	for (uint32_t i = 0; i < TIMER_SLOTS; i++) {
+		timeouts[i] = systick + RUN_THRESHOLD;
+	}
+	set_current(systick + ULOOP_TIMER_UPDATE_PERIOD - 1);
+}
+
+#endif
+
 void uloop_timer_init(uint32_t systick) {
+	reset(systick);
+#ifdef ULOOP_TIMER_POOL_SIZE
+	for (uint32_t i = 0; i < ULOOP_TIMER_POOL_SIZE; i++) {
+		pool[i].next = i + 1;
+	}
+	pool[ULOOP_TIMER_POOL_SIZE - 1].next = POOL_NONE;
+	pool_free = 0;
+#endif
+#ifdef ULOOP_TIMER_PERIODIC
 	for (uint32_t i = 0; i < ULOOP_TIMER_COUNT; i++) {
-		timeouts[i] = systick + RUN_THRESHOLD;
+		periods[i] = uloop_timer_periods[i];
+		if (periods[i] > 0) {
+			schedule(i, (systick + periods[i]) - 1);
+		}
+	}
+#endif
+}
+
+void uloop_timer_start_ex(uloop_timer_t timer, uint32_t value, bool relative) {
+	uint32_t systick = ULOOP_SYSTICK();
+	ULOOP_DEV_ASSERT(
+		(timer < ULOOP_TIMER_COUNT) &&
+		(!relative || (value <= ULOOP_TIMER_MAX_PERIOD))
+	);
+#ifdef ULOOP_TIMER_PERIODIC
+	periods[timer] = 0;
+#endif
+	schedule(timer, (relative ? (systick + value) : value) - 1);
+}
+
+void uloop_timer_stop(uloop_timer_t timer) {
+	ULOOP_DEV_ASSERT(timer < ULOOP_TIMER_COUNT);
+	unschedule(timer);
+}
+
+#ifdef ULOOP_TIMER_PERIODIC
+void uloop_timer_start_periodic(uloop_timer_t timer, uint32_t period, uint32_t phase) {
+	uint32_t systick = ULOOP_SYSTICK();
+	ULOOP_DEV_ASSERT(
+		(timer < ULOOP_TIMER_COUNT) &&
+		(period > 0) && (period <= ULOOP_TIMER_MAX_PERIOD) &&
+		(phase <= ULOOP_TIMER_MAX_PERIOD)
+	);
+	periods[timer] = period;
+	schedule(timer, (systick + phase) - 1);
+}
+#endif
+
+#ifdef ULOOP_TIMER_POOL_SIZE
+#if ULOOP_TIMER_POOL_DATA_SIZE > 0
+uloop_timer_handle_t uloop_publish_delayed(uloop_event_t event, const void* data, uint32_t size, uint32_t delay) {
+#else
+uloop_timer_handle_t uloop_publish_delayed(uloop_event_t event, uint32_t delay) {
+#endif
+	uint32_t systick = ULOOP_SYSTICK();
+	ULOOP_DEV_ASSERT((event < ULOOP_EVENT_COUNT) && (delay <= ULOOP_TIMER_MAX_PERIOD));
+	uloop_timer_handle_t handle = ULOOP_TIMER_HANDLE_NONE;
+	if (pool_free != POOL_NONE) {
+		uint32_t index = pool_free;
+		pool_free = pool[index].next;
+		pool[index].event = event;
+#if ULOOP_TIMER_POOL_DATA_SIZE > 0
+		ULOOP_DEV_ASSERT((size <= ULOOP_TIMER_POOL_DATA_SIZE) && ((size == 0) || (data != NULL)));
+		pool[index].size = size;
+		if (size > 0) {
+			memcpy(pool[index].data, data, size);
+		}
+#endif
+		schedule(ULOOP_TIMER_COUNT + index, (systick + delay) - 1);
+		handle = POOL_HANDLE(index);
 	}
-	uloop_timer_current = systick + ULOOP_TIMER_UPDATE_PERIOD - 1;
+	return handle;
 }
+
+bool uloop_publish_delayed_cancel(uloop_timer_handle_t handle) {
+	uint32_t index = handle & 0xFFFF;
+	bool valid = (index < ULOOP_TIMER_POOL_SIZE) && (POOL_HANDLE(index) == handle);
+	if (valid) {
+		unschedule(ULOOP_TIMER_COUNT + index);
+		pool_release(index);
+	}
+	return valid;
+}
+#endif
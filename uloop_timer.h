@@ -12,21 +12,49 @@
 
 typedef uint32_t uloop_timer_t;
 
+#ifdef ULOOP_TIMER_POOL_SIZE
+typedef uint32_t uloop_timer_handle_t;
+#define ULOOP_TIMER_HANDLE_NONE ((uloop_timer_handle_t) -1)
+#endif
+
 extern volatile uint32_t uloop_timer_current;
 extern const uloop_event_t uloop_timer_events[ULOOP_TIMER_COUNT];
+#ifdef ULOOP_TIMER_PERIODIC
+extern const uint32_t uloop_timer_periods[ULOOP_TIMER_COUNT];
+#endif
 
 void uloop_timer_start_ex(uloop_timer_t timer, uint32_t value, bool relative);
 void uloop_timer_stop(uloop_timer_t timer);
 bool uloop_timer_running(uloop_timer_t timer);
 void uloop_timer_init(uint32_t systick);
+#ifdef ULOOP_TIMER_PERIODIC
+void uloop_timer_start_periodic(uloop_timer_t timer, uint32_t period, uint32_t phase);
+#endif
+#ifdef ULOOP_TIMER_POOL_SIZE
+#if ULOOP_TIMER_POOL_DATA_SIZE > 0
+uloop_timer_handle_t uloop_publish_delayed(uloop_event_t event, const void* data, uint32_t size, uint32_t delay);
+#else
+uloop_timer_handle_t uloop_publish_delayed(uloop_event_t event, uint32_t delay);
+#endif
+bool uloop_publish_delayed_cancel(uloop_timer_handle_t handle);
+#endif
 
 static inline void uloop_timer_start(uloop_timer_t timer, uint32_t value) {
 	uloop_timer_start_ex(timer, value, true);
 }
 
+/* returns the systick value at which uloop_timer_update has to be called next */
+static inline uint32_t uloop_timer_next_deadline(void) {
+	return uloop_timer_current + 1;
+}
+
 static inline void uloop_timer_update(uint32_t systick) {
 	if ((int32_t)(uloop_timer_current - systick) < 0) {
 		uloop_timer_current += ULOOP_TIMER_UPDATE_PERIOD;
+#ifdef ULOOP_TIMER_PRODUCER
+		uloop_publish_from(ULOOP_TIMER_PRODUCER, E_ULOOP_TIMER_UPDATE);
+#else
 		uloop_publish(E_ULOOP_TIMER_UPDATE);
+#endif
 	}
 }
@@ -7,4 +7,5 @@
 #define ULOOP_LISTENER_COUNT      1
 #define ULOOP_LISTENER_TABLE_SIZE 2
 #define ULOOP_EVENT_COUNT         256
-#define ULOOP_STATISTICS_ENABLED
\ No newline at end of file
+#define ULOOP_STATISTICS_ENABLED
+#define ULOOP_RUN_FOR_ENABLED
\ No newline at end of file
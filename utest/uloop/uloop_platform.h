@@ -9,8 +9,10 @@ extern void mock_atomic_block_start(void);
 extern void mock_atomic_block_stop(void);
 extern void mock_dev_assert(void);
 extern uint32_t mock_systick(void);
+extern uint32_t mock_timestamp;
 
 #define ULOOP_SYSTICK()             mock_systick
+#define ULOOP_TIMESTAMP()           mock_timestamp
 
 #define ULOOP_ERROR_EQOVF()         mock_fail("eqOVF");
 #define ULOOP_ERROR_DQOVF()         mock_fail("dqOVF");
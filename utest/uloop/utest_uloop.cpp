@@ -16,7 +16,7 @@ static void mock_listener(uloop_event_t id, const void* data, uint32_t size);
 const uloop_listener_t uloop_listeners[1] = {mock_listener};
 
 const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
-const uint16_t uloop_listener_lut[256] = {0};
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {0};
 
 uint64_t xorshift64s(uint64_t* state) {
 	uint64_t x = state[0];
@@ -27,10 +27,23 @@ uint64_t xorshift64s(uint64_t* state) {
 	return x * 0x2545F4914F6CDD1DLL;
 }
 
+uint32_t mock_timestamp;
+
+static bool retain_data = false;
+static const void* retained_data = NULL;
+
+static uint32_t listener_time = 0;
+
 static void mock_listener(uloop_event_t event, const void* data, uint32_t size) {
+	mock_timestamp += listener_time;
 	mock().actualCall(__FUNCTION__)
 		.withParameter("event", event)
 		.withMemoryBufferParameter("data", (const uint8_t*)data, size);
+	if (retain_data) {
+		uloop_data_retain(data);
+		retained_data = data;
+		retain_data = false;
+	}
 }
 
 void mock_fail(const char* reason) {
@@ -53,7 +66,17 @@ uint32_t mock_timer_stop() {
 	return mock().actualCall(__FUNCTION__).returnUnsignedIntValue();
 }
 
+static uint32_t isr_size = 0;
+
 void mock_atomic_block_start() {
+	if (isr_size > 0) {
+		// an interrupt publishing right before the lock is taken
+		uint8_t data[ULOOP_DATA_SIZE_MAX];
+		uint32_t size = isr_size;
+		isr_size = 0;
+		memset(data, 0xEE, size);
+		uloop_publish_ex(200, data, size);
+	}
 	mock().actualCall(__FUNCTION__);
 }
 
@@ -69,6 +92,9 @@ void mock_dev_assert() {
 TEST_GROUP(uloop)
 {
 	void setup() {
+		mock_timestamp = 0;
+		listener_time = 0;
+		isr_size = 0;
 		uloop_init();
 	}
 	void teardown() {
@@ -133,19 +159,19 @@ TEST(uloop, event_queue_rand) {
 		uint32_t push_count = xorshift64s(&seed) % (ULOOP_EVENT_QUEUE_SIZE - events);
 		for (uint32_t i = 0; i < push_count; i++) {
 			push_event(tail);
-			tail += 1;
+			tail = (tail + 1) % ULOOP_EVENT_NONE;
 			events += 1;
 		}
 		uint32_t pop_count = xorshift64s(&seed) % (events + 1);
 		for (uint32_t i = 0; i < pop_count; i++) {
 			expect_event(head);
-			head += 1;
+			head = (head + 1) % ULOOP_EVENT_NONE;
 			events -= 1;
 		}
 	}
 	while(events > 0) {
 		expect_event(head);
-		head += 1;
+		head = (head + 1) % ULOOP_EVENT_NONE;
 		events -= 1;
 	}
 	CHECK_FALSE(uloop_run());
@@ -174,7 +200,7 @@ TEST(uloop, data_queue_rand) {
 			bytes += (size + 3) & ~3;
 			push_event(tail, data, size);
 			sizes.push(size);
-			tail += 1;
+			tail = (tail + 1) % ULOOP_EVENT_NONE;
 			events += 1;
 		}
 		uint32_t pop_count = xorshift64s(&seed) % (events + 1);
@@ -183,7 +209,7 @@ TEST(uloop, data_queue_rand) {
 			expect_event(head, data, sizes.front());
 			bytes -= (sizes.front() + 3) & ~3;
 			sizes.pop();
-			head += 1;
+			head = (head + 1) % ULOOP_EVENT_NONE;
 			events -= 1;
 		}
 	}
@@ -191,7 +217,7 @@ TEST(uloop, data_queue_rand) {
 		memset(data, head, sizes.front());
 		expect_event(head, data, sizes.front());
 		sizes.pop();
-		head += 1;
+		head = (head + 1) % ULOOP_EVENT_NONE;
 		events -= 1;
 	}
 	CHECK_FALSE(uloop_run());
@@ -244,6 +270,285 @@ TEST(uloop, data_queue_overflow3) {
 	CHECK_THROWS(std::exception, push_event(0, data, 64));
 }
 
+void expect_listener(uloop_event_t event, const uint8_t* data = NULL, uint32_t size = 0, uint32_t duration = 0) {
+	mock().expectOneCall("mock_timer_start");
+	mock().expectOneCall("mock_listener")
+		.withParameter("event", event)
+		.withMemoryBufferParameter("data", data, size);
+	mock().expectOneCall("mock_timer_stop").andReturnValue(duration);
+	if (size > 0) {
+		mock().expectOneCall("mock_atomic_block_start");
+		mock().expectOneCall("mock_atomic_block_stop");
+	}
+}
+
+TEST(uloop, run_batch) {
+	uint8_t data[16];
+	for (uint32_t i = 0; i < 8; i++) {
+		memset(data, i, sizeof(data));
+		push_event(i, data, (i % 2) ? sizeof(data) : 0);
+	}
+	mock().strictOrder();
+	for (uint32_t i = 0; i < 5; i++) {
+		memset(data, i, sizeof(data));
+		expect_listener(i, data, (i % 2) ? sizeof(data) : 0);
+	}
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	CHECK_EQUAL(uloop_run_batch(5), 5);
+	mock().checkExpectations();
+	mock().clear();
+	mock().strictOrder();
+	for (uint32_t i = 5; i < 8; i++) {
+		memset(data, i, sizeof(data));
+		expect_listener(i, data, (i % 2) ? sizeof(data) : 0);
+	}
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	CHECK_EQUAL(uloop_run_batch(100), 3);
+	mock().checkExpectations();
+	CHECK_EQUAL(uloop_run_batch(100), 0);
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop, run_batch_no_data) {
+	for (uint32_t i = 0; i < 4; i++) {
+		push_event(i);
+	}
+	mock().strictOrder();
+	for (uint32_t i = 0; i < 4; i++) {
+		expect_listener(i);
+	}
+	CHECK_EQUAL(uloop_run_until_idle(), 4);
+	mock().checkExpectations();
+}
+
+TEST(uloop, run_batch_data_wrap) {
+	uint8_t data[252];
+	std::queue<uint32_t> sizes;
+	uint32_t tail = 0;
+	uint32_t head = 0;
+	for (uint32_t n = 0; n < 32; n++) {
+		for (uint32_t i = 0; i < 3; i++) {
+			uint32_t size = 100 + ((tail * 37) % 150);
+			memset(data, tail, size);
+			push_event(tail, data, size);
+			sizes.push(size);
+			tail = (tail + 1) % ULOOP_EVENT_NONE;
+		}
+		mock().strictOrder();
+		while (head < tail) {
+			memset(data, head, sizes.front());
+			expect_listener(head, data, sizes.front());
+			sizes.pop();
+			head = (head + 1) % ULOOP_EVENT_NONE;
+		}
+		mock().expectOneCall("mock_atomic_block_start");
+		mock().expectOneCall("mock_atomic_block_stop");
+		CHECK_EQUAL(uloop_run_batch(UINT32_MAX), 3);
+		mock().checkExpectations();
+		mock().clear();
+	}
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop, run_batch_data_wrap_mid_batch) {
+	const uint32_t sizes[4] = {252, 252, 252, 200};
+	uint8_t data[252];
+	for (uint32_t i = 0; i < 4; i++) {
+		memset(data, i, sizes[i]);
+		push_event(i, data, sizes[i]);
+	}
+	mock().strictOrder();
+	for (uint32_t i = 0; i < 3; i++) {
+		memset(data, i, sizes[i]);
+		expect_listener(i, data, sizes[i]);
+	}
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	CHECK_EQUAL(uloop_run_batch(3), 3);
+	mock().checkExpectations();
+	mock().clear();
+	// the entry of event 3 ends at the tail, the interrupt wraps the queue right behind it
+	isr_size = 100;
+	mock().strictOrder();
+	memset(data, 3, sizes[3]);
+	mock().expectOneCall("mock_timer_start");
+	mock().expectOneCall("mock_listener")
+		.withParameter("event", 3)
+		.withMemoryBufferParameter("data", data, sizes[3]);
+	mock().expectOneCall("mock_timer_stop");
+	for (uint32_t i = 0; i < 3; i++) {
+		mock().expectOneCall("mock_atomic_block_start");
+		mock().expectOneCall("mock_atomic_block_stop");
+	}
+	CHECK_EQUAL(uloop_run_batch(UINT32_MAX), 1);
+	mock().checkExpectations();
+	mock().clear();
+	memset(data, 0xEE, 100);
+	expect_event(200, data, 100);
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop, run_for_budget) {
+	for (uint32_t i = 0; i < 6; i++) {
+		push_event(i);
+	}
+	mock_timestamp = 0xFFFFFFF0;
+	listener_time = 40;
+	mock().strictOrder();
+	for (uint32_t i = 0; i < 3; i++) {
+		expect_listener(i);
+	}
+	CHECK_EQUAL(uloop_run_for(100), 3);
+	mock().checkExpectations();
+	mock().clear();
+	listener_time = 0;
+	mock().strictOrder();
+	for (uint32_t i = 3; i < 6; i++) {
+		expect_listener(i);
+	}
+	CHECK_EQUAL(uloop_run_for(100), 3);
+	mock().checkExpectations();
+}
+
+void* reserve_event(uloop_reservation_t* reservation, uloop_event_t event, uint32_t size) {
+	mock().strictOrder();
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	void* ptr = uloop_publish_reserve(reservation, event, size);
+	mock().checkExpectations();
+	mock().clear();
+	return ptr;
+}
+
+void commit_event(const uloop_reservation_t* reservation, bool abort = false) {
+	mock().strictOrder();
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	if (abort) {
+		uloop_publish_abort(reservation);
+	} else {
+		uloop_publish_commit(reservation);
+	}
+	mock().checkExpectations();
+	mock().clear();
+}
+
+TEST(uloop, reserve_commit) {
+	uloop_reservation_t reservation;
+	uint8_t data[13];
+	memset(data, 0xA5, sizeof(data));
+	uint8_t* ptr = (uint8_t*) reserve_event(&reservation, 7, sizeof(data));
+	CHECK_TRUE(ptr != NULL);
+	CHECK_EQUAL(((uintptr_t) ptr) & 3, 0);
+	memcpy(ptr, data, sizeof(data));
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(uloop_event_queue_get(0).id, ULOOP_EVENT_NONE);
+	commit_event(&reservation);
+	CHECK_EQUAL(uloop_event_queue_get(0).id, 7);
+	expect_event(7, data, sizeof(data));
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop, reserve_blocks_later_events) {
+	uloop_reservation_t first;
+	uloop_reservation_t second;
+	uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	memcpy(reserve_event(&first, 1, sizeof(data)), data, sizeof(data));
+	push_event(2, data, 4);
+	memcpy(reserve_event(&second, 3, sizeof(data)), data, sizeof(data));
+	commit_event(&second);
+	CHECK_FALSE(uloop_run());
+	commit_event(&first);
+	expect_event(1, data, sizeof(data));
+	expect_event(2, data, 4);
+	expect_event(3, data, sizeof(data));
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop, reserve_abort) {
+	uloop_reservation_t reservation;
+	uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	CHECK_TRUE(reserve_event(&reservation, 1, 100) != NULL);
+	push_event(2, data, sizeof(data));
+	commit_event(&reservation, true);
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	CHECK_TRUE(uloop_run());
+	mock().checkExpectations();
+	mock().clear();
+	expect_event(2, data, sizeof(data));
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop, reserve_abort_last_event) {
+	// 255 is an event of its own, an aborted reservation must not look like it
+	uloop_reservation_t reservation;
+	uint8_t data[4] = {1, 2, 3, 4};
+	CHECK_TRUE(reserve_event(&reservation, 255, 8) != NULL);
+	commit_event(&reservation, true);
+	memcpy(reserve_event(&reservation, 255, sizeof(data)), data, sizeof(data));
+	commit_event(&reservation);
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	CHECK_TRUE(uloop_run());
+	mock().checkExpectations();
+	mock().clear();
+	expect_event(255, data, sizeof(data));
+	CHECK_FALSE(uloop_run());
+}
+
+void expect_retained_event(uloop_event_t event, const uint8_t* data, uint32_t size) {
+	retain_data = true;
+	expect_event(event, data, size);
+	CHECK_FALSE(retain_data);
+}
+
+TEST(uloop, data_retain) {
+	uint8_t data[60];
+	memset(data, 0x5A, sizeof(data));
+	push_event(1, data, 8);
+	expect_retained_event(1, data, 8);
+	// the retained block stays in place while the queue is cycled
+	for (uint32_t i = 0; i < 16; i++) {
+		memset(data, i, sizeof(data));
+		push_event(2, data, sizeof(data));
+		expect_event(2, data, sizeof(data));
+	}
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	mock().expectOneCall("mock_fail")
+		.withParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, uloop_publish_ex(2, data, sizeof(data)));
+}
+
+TEST(uloop, data_release) {
+	uint8_t data[60];
+	uint8_t retained[8];
+	memset(retained, 0x5A, sizeof(retained));
+	push_event(1, retained, sizeof(retained));
+	expect_retained_event(1, retained, sizeof(retained));
+	for (uint32_t i = 0; i < 8; i++) {
+		memset(data, i, sizeof(data));
+		push_event(2, data, sizeof(data));
+		expect_event(2, data, sizeof(data));
+	}
+	MEMCMP_EQUAL(retained, retained_data, sizeof(retained));
+	mock().expectOneCall("mock_atomic_block_start");
+	mock().expectOneCall("mock_atomic_block_stop");
+	uloop_data_release(retained_data);
+	mock().checkExpectations();
+	mock().clear();
+	// released space is reused after the queue wraps
+	for (uint32_t i = 0; i < 64; i++) {
+		memset(data, i, sizeof(data));
+		push_event(2, data, sizeof(data));
+		expect_event(2, data, sizeof(data));
+	}
+	CHECK_FALSE(uloop_run());
+}
+
 int main(int ac, char** av) {
 	return CommandLineTestRunner::RunAllTests(ac, av);
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define PLAIN      0
+#define DIRTY      1
+#define LATEST     2
+#define LATEST16   3
+#define FIFO       4
+
+static void test_listener(uloop_event_t id, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[1] = {test_listener};
+
+const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[64] = {0};
+
+/* DIRTY, LATEST and LATEST16 coalesce, the last two keep their latest value in a slot */
+const uint32_t uloop_coalesce_events[2] = {0x0000000E, 0};
+const uloop_coalesce_slot_t uloop_coalesce_slots[64] = {{0, 0}, {0, 0}, {0, 6}, {12, 16}};
+
+static std::vector<uint32_t> events;
+static std::vector<std::string> payloads;
+static uint32_t republish;
+static uint32_t atomic_depth;
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	events.push_back(event);
+	payloads.push_back(std::string((const char*) data, size));
+	if (republish > 0) {
+		republish -= 1;
+		uloop_publish(event);
+	}
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	CHECK_EQUAL(atomic_depth, 0);
+	atomic_depth += 1;
+}
+
+void mock_atomic_block_stop() {
+	CHECK_EQUAL(atomic_depth, 1);
+	atomic_depth -= 1;
+}
+
+static void publish(uloop_event_t event, const char* text = NULL) {
+	if (text != NULL) {
+		uloop_publish_ex(event, text, strlen(text));
+	} else {
+		uloop_publish(event);
+	}
+}
+
+static uint32_t run_all() {
+	uint32_t count = 0;
+	while (uloop_run()) {
+		count += 1;
+	}
+	return count;
+}
+
+TEST_GROUP(uloop_coalesce)
+{
+	void setup() {
+		uloop_init();
+		events.clear();
+		payloads.clear();
+		republish = 0;
+		atomic_depth = 0;
+	}
+	void teardown() {
+		mock().clear();
+	}
+};
+
+TEST(uloop_coalesce, burst_merged) {
+	for (uint32_t i = 0; i < 100; i++) {
+		publish(DIRTY);
+	}
+	CHECK_EQUAL(uloop_event_queue_get(0).id, DIRTY);
+	CHECK_EQUAL(uloop_event_queue_get(1).id, ULOOP_EVENT_NONE);
+	CHECK_EQUAL(run_all(), 1);
+	publish(DIRTY);
+	CHECK_EQUAL(run_all(), 1);
+}
+
+TEST(uloop_coalesce, order_kept) {
+	publish(PLAIN);
+	publish(DIRTY);
+	publish(PLAIN);
+	publish(DIRTY);
+	publish(FIFO, "abc");
+	CHECK_EQUAL(run_all(), 4);
+	const uint32_t order[] = {PLAIN, DIRTY, PLAIN, FIFO};
+	for (uint32_t i = 0; i < 4; i++) {
+		CHECK_EQUAL(events[i], order[i]);
+	}
+	CHECK(payloads[3] == "abc");
+}
+
+TEST(uloop_coalesce, publish_from_listener) {
+	republish = 1;
+	publish(DIRTY);
+	CHECK_EQUAL(run_all(), 2);
+}
+
+TEST(uloop_coalesce, latest_value_wins) {
+	publish(LATEST, "first");
+	publish(LATEST16, "0123456789abcdef");
+	publish(LATEST, "second");
+	publish(LATEST, "third");
+	CHECK_EQUAL(run_all(), 2);
+	CHECK_EQUAL(events[0], LATEST);
+	CHECK(payloads[0] == "third");
+	CHECK_EQUAL(events[1], LATEST16);
+	CHECK(payloads[1] == "0123456789abcdef");
+}
+
+TEST(uloop_coalesce, latest_value_bypasses_data_queue) {
+	for (uint32_t i = 0; i < 1000; i++) {
+		publish(LATEST, "value");
+	}
+	publish(FIFO, "0123456789");
+	CHECK_EQUAL(run_all(), 2);
+	CHECK(payloads[0] == "value");
+	CHECK(payloads[1] == "0123456789");
+}
+
+TEST(uloop_coalesce, latest_value_too_large) {
+	mock().expectOneCall("mock_dev_assert");
+	CHECK_THROWS(std::exception, publish(LATEST, "1234567"));
+	mock().checkExpectations();
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,12 @@
+#define ULOOP_EVENT_QUEUE_SIZE    8
+#define ULOOP_DATA_QUEUE_SIZE     64
+#define ULOOP_LISTENER_TIME_LIMIT 10
+#define ULOOP_METADATA_NAME_SIZE  4
+
+#define ULOOP_LISTENER_COUNT      3
+#define ULOOP_LISTENER_TABLE_SIZE 8
+#define ULOOP_EVENT_COUNT         4
+
+#define ULOOP_STATISTICS_ENABLED
+#define ULOOP_DISPATCH_SWITCH
+#define ULOOP_TRACE_SIZE          8
@@ -0,0 +1,30 @@
+#pragma once
+#include "uloop.h"
+
+extern void mock_fail(const char* reason);
+extern void mock_dev_assert(void);
+extern uint32_t mock_timer_stop(void);
+extern uint32_t mock_timestamp;
+extern void mock_pre_execute(uint32_t listener, uloop_event_t event);
+extern void mock_post_execute(uint32_t listener, uloop_event_t event);
+
+#define ULOOP_ERROR_EQOVF()         mock_fail("eqOVF");
+#define ULOOP_ERROR_DQOVF()         mock_fail("dqOVF");
+#define ULOOP_ERROR_DQCORR()        mock_fail("dqCORR");
+#define ULOOP_ERROR_TMO(time)       mock_fail("TMO");
+
+#define ULOOP_DEV_ASSERT(cond)     \
+	do { \
+		if (!(cond)) { \
+			mock_dev_assert(); \
+		} \
+	} while (0)
+
+#define ULOOP_TIMER_START()         do {} while (0)
+#define ULOOP_TIMER_STOP()          mock_timer_stop()
+#define ULOOP_TIMESTAMP()           (mock_timestamp += 1)
+#define ULOOP_ATOMIC_BLOCK_ENTER()  do {} while (0)
+#define ULOOP_ATOMIC_BLOCK_LEAVE()  do {} while (0)
+
+#define ULOOP_HOOK_PRE_EXECUTE(listener, event, data, size)   mock_pre_execute(listener, event)
+#define ULOOP_HOOK_POST_EXECUTE(listener, event, data, size)  mock_post_execute(listener, event)
@@ -0,0 +1,192 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_dispatch.h"
+
+#define ONE      0
+#define TWO      1
+#define NONE     2
+#define SHARED   3
+
+static std::vector<uint32_t> calls;
+static std::vector<std::string> payloads;
+static uint32_t duration;
+uint32_t mock_timestamp;
+
+static void listener_a(uloop_event_t event, const void* data, uint32_t size) {
+	CHECK_EQUAL(0, uloop_listener_active);
+	calls.push_back(0x100 | event);
+	payloads.push_back(std::string((const char*) data, size));
+}
+
+static void listener_b(uloop_event_t event, const void* data, uint32_t size) {
+	CHECK_EQUAL(1, uloop_listener_active);
+	calls.push_back(0x200 | event);
+	payloads.push_back(std::string((const char*) data, size));
+}
+
+static void listener_c(uloop_event_t event, const void* data, uint32_t size) {
+	(void) data;
+	(void) size;
+	CHECK_EQUAL(2, uloop_listener_active);
+	calls.push_back(0x300 | event);
+}
+
+const uloop_listener_t uloop_listeners[3] = {listener_a, listener_b, listener_c};
+
+/* the shape of what uloop_config.c.template emits for "dispatch": "switch" */
+void uloop_dispatch_generated(uloop_event_t event, const void* data, uint32_t size) {
+	switch (event) {
+		case ONE:
+			uloop_execute(0, listener_a, event, data, size);
+			break;
+		case TWO:
+		case SHARED:
+			uloop_execute(1, listener_b, event, data, size);
+			uloop_execute(2, listener_c, event, data, size);
+			break;
+		default:
+			(void) data;
+			(void) size;
+			break;
+	}
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+uint32_t mock_timer_stop() {
+	return duration;
+}
+
+void mock_pre_execute(uint32_t listener, uloop_event_t event) {
+	mock().actualCall(__FUNCTION__)
+		.withParameter("listener", listener)
+		.withParameter("event", event);
+}
+
+void mock_post_execute(uint32_t listener, uloop_event_t event) {
+	mock().actualCall(__FUNCTION__)
+		.withParameter("listener", listener)
+		.withParameter("event", event);
+}
+
+static void expect_execute(uint32_t listener, uloop_event_t event) {
+	mock().expectOneCall("mock_pre_execute")
+		.withParameter("listener", listener)
+		.withParameter("event", event);
+	mock().expectOneCall("mock_post_execute")
+		.withParameter("listener", listener)
+		.withParameter("event", event);
+}
+
+TEST_GROUP(uloop_dispatch) {
+	void setup() {
+		calls.clear();
+		payloads.clear();
+		duration = 0;
+		memset(uloop_listener_stats, 0, sizeof(uloop_listener_stats));
+		memset(uloop_trace.records, 0, sizeof(uloop_trace.records));
+		uloop_trace.head = 0;
+		mock_timestamp = 0;
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_dispatch, listener_order) {
+	uloop_publish_ex(TWO, "ab", 2);
+	uloop_publish(NONE);
+	uloop_publish_ex(ONE, "c", 1);
+	uloop_publish(SHARED);
+	expect_execute(1, TWO);
+	expect_execute(2, TWO);
+	expect_execute(0, ONE);
+	expect_execute(1, SHARED);
+	expect_execute(2, SHARED);
+	CHECK_EQUAL(4, uloop_run_until_idle());
+	const uint32_t expected[] = {0x201, 0x301, 0x100, 0x203, 0x303};
+	CHECK_EQUAL(5, calls.size());
+	for (uint32_t i = 0; i < 5; i++) {
+		CHECK_EQUAL(expected[i], calls[i]);
+	}
+	CHECK_EQUAL(3, payloads.size());
+	STRCMP_EQUAL("ab", payloads[0].c_str());
+	STRCMP_EQUAL("c", payloads[1].c_str());
+	STRCMP_EQUAL("", payloads[2].c_str());
+	CHECK_EQUAL(ULOOP_LISTENER_NONE, uloop_listener_active);
+}
+
+TEST(uloop_dispatch, statistics_and_time_limit) {
+	mock().ignoreOtherCalls();
+	duration = 7;
+	uloop_publish(TWO);
+	uloop_publish(SHARED);
+	CHECK_EQUAL(2, uloop_run_until_idle());
+	CHECK_EQUAL(0, uloop_listener_stats[0].runs);
+	CHECK_EQUAL(2, uloop_listener_stats[1].runs);
+	CHECK_EQUAL(14, uloop_listener_stats[2].time_total);
+	CHECK_EQUAL(7, uloop_listener_stats[2].time_max);
+	duration = 11;
+	uloop_publish(ONE);
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "TMO");
+	CHECK_THROWS(std::exception, uloop_run());
+	CHECK_EQUAL(1, uloop_listener_stats[0].runs);
+	CHECK_EQUAL(11, uloop_listener_stats[0].time_max);
+}
+
+static void check_record(uint32_t index, uint32_t stamp, uint32_t phase, uloop_event_t event, uint32_t listener) {
+	const uloop_trace_record_t* record = &uloop_trace.records[index % ULOOP_TRACE_SIZE];
+	CHECK_EQUAL(stamp, record->stamp);
+	CHECK_EQUAL(phase, record->phase);
+	CHECK_EQUAL(event, record->event);
+	CHECK_EQUAL(listener, record->listener);
+}
+
+TEST(uloop_dispatch, trace) {
+	mock().ignoreOtherCalls();
+	CHECK_EQUAL(ULOOP_TRACE_MAGIC, uloop_trace.magic);
+	CHECK_EQUAL(ULOOP_TRACE_SIZE, uloop_trace.size);
+	uloop_publish(TWO);
+	uloop_publish(ONE);
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(8, uloop_trace.head);
+	check_record(0, 1, ULOOP_TRACE_PUBLISH, TWO, ULOOP_LISTENER_NONE);
+	check_record(1, 2, ULOOP_TRACE_PUBLISH, ONE, ULOOP_LISTENER_NONE);
+	check_record(2, 3, ULOOP_TRACE_PRE_DISPATCH, TWO, ULOOP_LISTENER_NONE);
+	check_record(3, 4, ULOOP_TRACE_PRE_EXECUTE, TWO, 1);
+	check_record(4, 5, ULOOP_TRACE_POST_EXECUTE, TWO, 1);
+	check_record(5, 6, ULOOP_TRACE_PRE_EXECUTE, TWO, 2);
+	check_record(6, 7, ULOOP_TRACE_POST_EXECUTE, TWO, 2);
+	check_record(7, 8, ULOOP_TRACE_POST_DISPATCH, TWO, ULOOP_LISTENER_NONE);
+	// the ring wraps over the oldest records
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(12, uloop_trace.head);
+	check_record(8, 9, ULOOP_TRACE_PRE_DISPATCH, ONE, ULOOP_LISTENER_NONE);
+	check_record(11, 12, ULOOP_TRACE_POST_DISPATCH, ONE, ULOOP_LISTENER_NONE);
+	check_record(4, 5, ULOOP_TRACE_POST_EXECUTE, TWO, 1);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,20 @@
+#define ULOOP_EVENT_QUEUE_SIZE    8
+#define ULOOP_DATA_QUEUE_SIZE     64
+#define ULOOP_LISTENER_TIME_LIMIT 0
+#define ULOOP_METADATA_NAME_SIZE  4
+#define ULOOP_MAILBOX_SIZE        4
+#define ULOOP_MAILBOX_DATA_SIZE   8
+
+#define ULOOP_LISTENER_COUNT      3
+#define ULOOP_LISTENER_TABLE_SIZE 8
+#define ULOOP_EVENT_COUNT         4
+
+#define ULOOP_STATISTICS_ENABLED
+#define ULOOP_LATENCY_BUCKETS     8
+
+#define ULOOP_OVERFLOW
+
+#define ULOOP_INSTANCE_COUNT      3
+#define ULOOP_INSTANCE_MAIN       0
+#define ULOOP_INSTANCE_DSP        1
+#define ULOOP_INSTANCE_IO         2
@@ -0,0 +1,280 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define MAIN_EVENT 0
+#define DSP_EVENT  1
+#define DSP_DROP   2
+#define IO_EVENT   3
+
+#define MAIN_LISTENER 0
+#define DSP_LISTENER  1
+#define IO_LISTENER   2
+
+static void main_listener(uloop_event_t event, const void* data, uint32_t size);
+static void dsp_listener(uloop_event_t event, const void* data, uint32_t size);
+static void io_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[3] = {main_listener, dsp_listener, io_listener};
+
+const uloop_listener_id_t uloop_listener_table[8] = {
+	0, ULOOP_LISTENER_NONE, 1, ULOOP_LISTENER_NONE, 1, ULOOP_LISTENER_NONE, 2, ULOOP_LISTENER_NONE
+};
+const uloop_listener_lut_t uloop_listener_lut[4] = {0, 2, 4, 6};
+
+const uloop_overflow_t uloop_event_overflow[4] = {
+	{ULOOP_OVERFLOW_FATAL, 0xFF},
+	{ULOOP_OVERFLOW_FATAL, 0xFF},
+	{ULOOP_OVERFLOW_DROP_NEW, 0xFF},
+	{ULOOP_OVERFLOW_FATAL, 0xFF}
+};
+
+const uint8_t uloop_event_instance[4] = {ULOOP_INSTANCE_MAIN, ULOOP_INSTANCE_DSP, ULOOP_INSTANCE_DSP, ULOOP_INSTANCE_IO};
+const uint8_t uloop_listener_instance[3] = {ULOOP_INSTANCE_MAIN, ULOOP_INSTANCE_DSP, ULOOP_INSTANCE_IO};
+
+static std::vector<std::string> calls;
+static std::vector<const void*> retained;
+static bool main_retain;
+static bool dsp_reply;
+static bool dsp_retain;
+static bool dsp_global;
+static uint32_t atomic_depth;
+uint32_t mock_timestamp;
+
+static std::string payload(const void* data, uint32_t size) {
+	return (size > 0) ? std::string((const char*) data, size) : std::string();
+}
+
+static void main_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	CHECK_EQUAL(MAIN_LISTENER, uloop_listener_active);
+	calls.push_back("main " + payload(data, size));
+	if (main_retain) {
+		uloop_data_retain(data);
+		retained.push_back(data);
+	}
+}
+
+static void dsp_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	// instance 0 is not running a listener, only the dsp instance is
+	CHECK_EQUAL(DSP_LISTENER, uloop_instance_active[ULOOP_INSTANCE_DSP]);
+	CHECK_EQUAL(ULOOP_LISTENER_NONE, uloop_listener_active);
+	calls.push_back("dsp " + payload(data, size));
+	if (dsp_reply) {
+		uloop_publish_ex_ctx(uloop_ctx_get(ULOOP_INSTANCE_DSP), MAIN_EVENT, data, size);
+	}
+	if (dsp_retain) {
+		uloop_data_retain(data);
+	}
+	if (dsp_global) {
+		uloop_publish(MAIN_EVENT);
+	}
+}
+
+static void io_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	calls.push_back("io " + payload(data, size));
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	CHECK_EQUAL(atomic_depth, 0);
+	atomic_depth += 1;
+}
+
+void mock_atomic_block_stop() {
+	CHECK_EQUAL(atomic_depth, 1);
+	atomic_depth -= 1;
+}
+
+static uint32_t run_all(uloop_ctx_t* ctx) {
+	uint32_t count = 0;
+	while (uloop_run_ctx(ctx)) {
+		count += 1;
+	}
+	return count;
+}
+
+static void publish(uint32_t instance, uloop_event_t event, const char* text) {
+	uloop_publish_ex_ctx(uloop_ctx_get(instance), event, text, strlen(text));
+}
+
+TEST_GROUP(uloop_instances) {
+	uloop_ctx_t* main_ctx;
+	uloop_ctx_t* dsp_ctx;
+	uloop_ctx_t* io_ctx;
+
+	void setup() {
+		calls.clear();
+		retained.clear();
+		main_retain = false;
+		dsp_reply = false;
+		dsp_retain = false;
+		dsp_global = false;
+		atomic_depth = 0;
+		mock_timestamp = 0;
+		memset(uloop_event_stats, 0, sizeof(uloop_event_stats));
+		memset(uloop_event_latency, 0, sizeof(uloop_event_latency));
+		uloop_init();
+		main_ctx = uloop_ctx_get(ULOOP_INSTANCE_MAIN);
+		dsp_ctx = uloop_ctx_get(ULOOP_INSTANCE_DSP);
+		io_ctx = uloop_ctx_get(ULOOP_INSTANCE_IO);
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_instances, global_api_is_instance_0) {
+	uloop_publish_ex(MAIN_EVENT, "abc", 3);
+	CHECK_TRUE(uloop_run_ctx(main_ctx));
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(1, calls.size());
+	STRCMP_EQUAL("main abc", calls[0].c_str());
+}
+
+TEST(uloop_instances, global_api_from_other_instance) {
+	// without ULOOP_INSTANCE_CURRENT the global API would write the queue of instance 0 from the dsp core
+	dsp_global = true;
+	publish(ULOOP_INSTANCE_MAIN, DSP_EVENT, "d0");
+	mock().expectOneCall("mock_dev_assert");
+	CHECK_THROWS(std::exception, uloop_run_ctx(dsp_ctx));
+}
+
+TEST(uloop_instances, routed_to_instance) {
+	uloop_publish_ex(DSP_EVENT, "abc", 3);
+	uloop_publish(IO_EVENT);
+	// nothing is queued for instance 0 itself
+	CHECK_EQUAL(0, uloop_run_until_idle());
+	CHECK_EQUAL(1, run_all(io_ctx));
+	CHECK_EQUAL(1, run_all(dsp_ctx));
+	CHECK_EQUAL(2, calls.size());
+	STRCMP_EQUAL("io ", calls[0].c_str());
+	STRCMP_EQUAL("dsp abc", calls[1].c_str());
+	CHECK_EQUAL(1, uloop_event_stats[DSP_EVENT].count);
+	CHECK_EQUAL(ULOOP_LISTENER_NONE, uloop_instance_active[ULOOP_INSTANCE_DSP]);
+}
+
+TEST(uloop_instances, reply_to_instance_0) {
+	dsp_reply = true;
+	main_retain = true;
+	uloop_publish_ex(DSP_EVENT, "xy", 2);
+	CHECK_EQUAL(1, run_all(dsp_ctx));
+	CHECK_EQUAL(1, run_all(main_ctx));
+	STRCMP_EQUAL("main xy", calls[1].c_str());
+	// the message was moved into the data queue, so it can be retained like any other
+	CHECK_EQUAL(1, retained.size());
+	STRCMP_EQUAL("xy", payload(retained[0], 2).c_str());
+	uloop_data_release(retained[0]);
+}
+
+TEST(uloop_instances, local_publish) {
+	publish(ULOOP_INSTANCE_DSP, DSP_EVENT, "self");
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(1, run_all(dsp_ctx));
+	STRCMP_EQUAL("dsp self", calls[0].c_str());
+}
+
+TEST(uloop_instances, senders_take_turns) {
+	publish(ULOOP_INSTANCE_MAIN, DSP_EVENT, "a0");
+	publish(ULOOP_INSTANCE_MAIN, DSP_EVENT, "a1");
+	publish(ULOOP_INSTANCE_DSP, DSP_EVENT, "b0");
+	publish(ULOOP_INSTANCE_IO, DSP_EVENT, "c0");
+	CHECK_EQUAL(4, run_all(dsp_ctx));
+	STRCMP_EQUAL("dsp a0", calls[0].c_str());
+	STRCMP_EQUAL("dsp b0", calls[1].c_str());
+	STRCMP_EQUAL("dsp c0", calls[2].c_str());
+	STRCMP_EQUAL("dsp a1", calls[3].c_str());
+}
+
+TEST(uloop_instances, mailbox_full) {
+	for (uint32_t i = 0; i < ULOOP_MAILBOX_SIZE; i++) {
+		uloop_publish(DSP_EVENT);
+	}
+	// other senders have their own mailbox
+	publish(ULOOP_INSTANCE_IO, DSP_EVENT, "io");
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "eqOVF");
+	CHECK_THROWS(std::exception, uloop_publish(DSP_EVENT));
+}
+
+TEST(uloop_instances, mailbox_full_drop) {
+	for (uint32_t i = 0; i <= ULOOP_MAILBOX_SIZE; i++) {
+		uloop_publish(DSP_DROP);
+	}
+	CHECK_EQUAL(1, uloop_event_stats[DSP_DROP].drops);
+	CHECK_EQUAL(ULOOP_MAILBOX_SIZE, run_all(dsp_ctx));
+}
+
+TEST(uloop_instances, message_too_large) {
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, uloop_publish_ex(DSP_EVENT, "123456789", 9));
+}
+
+TEST(uloop_instances, backpressure) {
+	// the event queue of instance 0 is full, the messages wait in the mailbox
+	for (uint32_t i = 0; i < (ULOOP_EVENT_QUEUE_SIZE - 1); i++) {
+		uloop_publish(MAIN_EVENT);
+	}
+	publish(ULOOP_INSTANCE_DSP, MAIN_EVENT, "d0");
+	publish(ULOOP_INSTANCE_DSP, MAIN_EVENT, "d1");
+	CHECK_EQUAL(ULOOP_EVENT_QUEUE_SIZE + 1, run_all(main_ctx));
+	STRCMP_EQUAL("main d0", calls[ULOOP_EVENT_QUEUE_SIZE - 1].c_str());
+	STRCMP_EQUAL("main d1", calls[ULOOP_EVENT_QUEUE_SIZE].c_str());
+}
+
+TEST(uloop_instances, drained_latency) {
+	// the time in the mailbox counts, the stamp is not taken again when the message is moved
+	mock_timestamp = 100;
+	publish(ULOOP_INSTANCE_DSP, MAIN_EVENT, "d0");
+	mock_timestamp = 150;
+	CHECK_EQUAL(1, run_all(main_ctx));
+	CHECK_EQUAL(50, uloop_event_latency[MAIN_EVENT].max);
+}
+
+TEST(uloop_instances, batch_drains_mailboxes) {
+	publish(ULOOP_INSTANCE_IO, MAIN_EVENT, "i0");
+	uloop_publish_ex(MAIN_EVENT, "m0", 2);
+	CHECK_EQUAL(2, uloop_run_batch(10));
+	STRCMP_EQUAL("main m0", calls[0].c_str());
+	STRCMP_EQUAL("main i0", calls[1].c_str());
+}
+
+TEST(uloop_instances, reserve_other_instance) {
+	uloop_reservation_t reservation;
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "eqOVF");
+	CHECK_THROWS(std::exception, uloop_publish_reserve(&reservation, DSP_EVENT, 0));
+}
+
+TEST(uloop_instances, retain_other_instance) {
+	// the retain counter is shared with instance 0, a retain from a mailbox would corrupt it
+	dsp_retain = true;
+	publish(ULOOP_INSTANCE_MAIN, DSP_EVENT, "d0");
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "dqCORR");
+	CHECK_THROWS(std::exception, uloop_run_ctx(dsp_ctx));
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
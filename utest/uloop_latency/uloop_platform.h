@@ -0,0 +1,24 @@
+#pragma once
+#include "uloop.h"
+
+extern void mock_fail(const char* reason);
+extern void mock_dev_assert(void);
+extern uint32_t mock_timestamp;
+
+#define ULOOP_TIMESTAMP()           mock_timestamp
+
+#define ULOOP_ERROR_EQOVF()         mock_fail("eqOVF");
+#define ULOOP_ERROR_DQOVF()         mock_fail("dqOVF");
+#define ULOOP_ERROR_DQCORR()        mock_fail("dqCORR");
+
+#define ULOOP_DEV_ASSERT(cond)     \
+	do { \
+		if (!(cond)) { \
+			mock_dev_assert(); \
+		} \
+	} while (0)
+
+#define ULOOP_TIMER_START()         do {} while (0)
+#define ULOOP_TIMER_STOP()          0
+#define ULOOP_ATOMIC_BLOCK_ENTER()  do {} while (0)
+#define ULOOP_ATOMIC_BLOCK_LEAVE()  do {} while (0)
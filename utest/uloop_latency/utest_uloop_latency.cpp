@@ -0,0 +1,103 @@
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+static void listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[1] = {listener};
+
+const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {0};
+
+uint32_t mock_timestamp;
+
+static void listener(uloop_event_t event, const void* data, uint32_t size) {
+	mock().actualCall(__FUNCTION__)
+		.withParameter("event", event)
+		.withMemoryBufferParameter("data", (const uint8_t*)data, size);
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+static void expect_event(uloop_event_t event, const uint8_t* data = NULL, uint32_t size = 0) {
+	mock().expectOneCall("listener")
+		.withParameter("event", event)
+		.withMemoryBufferParameter("data", data, size);
+	CHECK_TRUE(uloop_run());
+	mock().checkExpectations();
+	mock().clear();
+}
+
+static void expect_latency(uloop_event_t event, uint32_t published, uint32_t dispatched) {
+	mock_timestamp = published;
+	uloop_publish(event);
+	mock_timestamp = dispatched;
+	expect_event(event);
+}
+
+TEST_GROUP(uloop_latency) {
+	void setup() {
+		mock_timestamp = 0;
+		memset(uloop_event_latency, 0, sizeof(uloop_event_latency));
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_latency, histogram) {
+	expect_latency(5, 100, 100);
+	expect_latency(5, 100, 101);
+	expect_latency(5, 100, 103);
+	expect_latency(5, 100, 104);
+	expect_latency(5, 100, 1100);
+	expect_latency(5, 0xFFFFFFF0, 0x10);
+	const uint16_t histogram[8] = {1, 1, 1, 1, 0, 0, 1, 1};
+	MEMCMP_EQUAL(histogram, uloop_event_latency[5].histogram, sizeof(histogram));
+	CHECK_EQUAL(1000, uloop_event_latency[5].max);
+	CHECK_EQUAL(0, uloop_event_latency[6].max);
+	// the histogram is halved before a counter overflows
+	uloop_event_latency[5].histogram[0] = UINT16_MAX;
+	uloop_event_latency[5].histogram[1] = 5;
+	expect_latency(5, 7, 7);
+	CHECK_EQUAL(32768, uloop_event_latency[5].histogram[0]);
+	CHECK_EQUAL(2, uloop_event_latency[5].histogram[1]);
+	CHECK_EQUAL(0, uloop_histogram_percentile(uloop_event_latency[5].histogram, 8, 500));
+	CHECK_EQUAL(1, uloop_histogram_percentile(uloop_event_latency[5].histogram, 8, 1000));
+}
+
+TEST(uloop_latency, reservation) {
+	uloop_reservation_t reservation;
+	uint8_t data[4] = {1, 2, 3, 4};
+	mock_timestamp = 10;
+	memcpy(uloop_publish_reserve(&reservation, 3, sizeof(data)), data, sizeof(data));
+	mock_timestamp = 50;
+	uloop_publish_commit(&reservation);
+	mock_timestamp = 54;
+	expect_event(3, data, sizeof(data));
+	CHECK_EQUAL(4, uloop_event_latency[3].max);
+	CHECK_EQUAL(1, uloop_event_latency[3].histogram[3]);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,9 @@
+#define ULOOP_EVENT_QUEUE_SIZE    64
+#define ULOOP_DATA_QUEUE_SIZE     4096
+#define ULOOP_LISTENER_TIME_LIMIT 0
+#define ULOOP_METADATA_NAME_SIZE  4
+#define ULOOP_LOCK_FREE_QUEUE
+
+#define ULOOP_LISTENER_COUNT      1
+#define ULOOP_LISTENER_TABLE_SIZE 2
+#define ULOOP_EVENT_COUNT         256
@@ -0,0 +1,18 @@
+#pragma once
+#include "uloop.h"
+
+extern void lockfree_fail(const char* reason);
+
+#define ULOOP_ERROR_EQOVF()         lockfree_fail("eqOVF");
+#define ULOOP_ERROR_DQOVF()         lockfree_fail("dqOVF");
+#define ULOOP_ERROR_DQCORR()        lockfree_fail("dqCORR");
+
+#define ULOOP_DEV_ASSERT(cond)     \
+	do { \
+		if (!(cond)) { \
+			lockfree_fail("assert"); \
+		} \
+	} while (0)
+
+#define ULOOP_TIMER_START()         do {} while (0)
+#define ULOOP_TIMER_STOP()          0
@@ -0,0 +1,241 @@
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define PRODUCERS     4
+#define SAMPLES       50000
+#define IN_FLIGHT     ((ULOOP_EVENT_QUEUE_SIZE / PRODUCERS) - 1)
+#define EVENT_NODATA  128
+
+typedef struct {
+	uint32_t producer;
+	uint32_t seq;
+	uint8_t fill[40];
+} sample_t;
+
+static void test_listener(uloop_event_t id, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[1] = {test_listener};
+
+const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {0};
+
+static struct {
+	uint32_t received[PRODUCERS];
+	uint32_t errors;
+	std::vector<uint32_t> events;
+} state;
+
+static const char* fail_reason;
+static bool use_reserve;
+
+void lockfree_fail(const char* reason) {
+	fail_reason = reason;
+	throw std::exception();
+}
+
+static uint32_t sample_size(uint32_t seq) {
+	return 8 + (seq % (sizeof(((sample_t*) NULL)->fill) + 1));
+}
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	state.events.push_back(event);
+	if (event >= EVENT_NODATA) {
+		uint32_t producer = event - EVENT_NODATA;
+		if ((producer >= PRODUCERS) || (size != 0) || (data != NULL)) {
+			state.errors += 1;
+			return;
+		}
+		__atomic_store_n(&state.received[producer], state.received[producer] + 1, __ATOMIC_RELEASE);
+		return;
+	}
+	const sample_t* sample = (const sample_t*) data;
+	if ((event >= PRODUCERS) || (sample->producer != event) || (((uintptr_t) data & 3) != 0)) {
+		state.errors += 1;
+		return;
+	}
+	if ((sample->seq != state.received[event]) || (size != sample_size(sample->seq))) {
+		state.errors += 1;
+	}
+	for (uint32_t i = 0; i < (size - 8); i++) {
+		if (sample->fill[i] != (uint8_t) (sample->seq + i)) {
+			state.errors += 1;
+			break;
+		}
+	}
+	__atomic_store_n(&state.received[event], state.received[event] + 1, __ATOMIC_RELEASE);
+}
+
+static void* producer_thread(void* arg) {
+	uint32_t producer = (uint32_t) (uintptr_t) arg;
+	sample_t sample;
+	for (uint32_t seq = 0; seq < SAMPLES; seq++) {
+		while ((seq - __atomic_load_n(&state.received[producer], __ATOMIC_ACQUIRE)) >= IN_FLIGHT) {
+			sched_yield();
+		}
+		if (producer == (PRODUCERS - 1)) {
+			uloop_publish(EVENT_NODATA + producer);
+		} else {
+			uint32_t size = sample_size(seq);
+			uloop_reservation_t reservation;
+			sample_t* ptr = use_reserve ? (sample_t*) uloop_publish_reserve(&reservation, producer, size) : &sample;
+			ptr->producer = producer;
+			ptr->seq = seq;
+			for (uint32_t i = 0; i < (size - 8); i++) {
+				ptr->fill[i] = (uint8_t) (seq + i);
+			}
+			if (use_reserve) {
+				uloop_publish_commit(&reservation);
+			} else {
+				uloop_publish_ex(producer, &sample, size);
+			}
+		}
+	}
+	return NULL;
+}
+
+TEST_GROUP(uloop_lockfree)
+{
+	void setup() {
+		uloop_init();
+		memset(state.received, 0, sizeof(state.received));
+		state.errors = 0;
+		state.events.clear();
+		fail_reason = NULL;
+		use_reserve = false;
+	}
+	void teardown() {
+		mock().clear();
+	}
+};
+
+TEST(uloop_lockfree, event_queue_fill) {
+	for (uint32_t i = 0; i < ULOOP_EVENT_QUEUE_SIZE; i++) {
+		uloop_publish(EVENT_NODATA);
+	}
+	CHECK_EQUAL(uloop_event_queue_get(ULOOP_EVENT_QUEUE_SIZE - 1).id, EVENT_NODATA);
+	for (uint32_t i = 0; i < ULOOP_EVENT_QUEUE_SIZE; i++) {
+		CHECK_TRUE(uloop_run());
+	}
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(state.received[0], ULOOP_EVENT_QUEUE_SIZE);
+	CHECK_EQUAL(state.errors, 0);
+}
+
+TEST(uloop_lockfree, event_queue_overflow) {
+	for (uint32_t i = 0; i < ULOOP_EVENT_QUEUE_SIZE; i++) {
+		uloop_publish(EVENT_NODATA);
+	}
+	CHECK_THROWS(std::exception, uloop_publish(EVENT_NODATA));
+	STRCMP_EQUAL(fail_reason, "eqOVF");
+}
+
+TEST(uloop_lockfree, data_queue_wrap) {
+	sample_t sample = {0, 0, {0}};
+	for (uint32_t n = 0; n < 1000; n++) {
+		for (uint32_t i = 0; i < 3; i++) {
+			uint32_t size = sample_size(sample.seq);
+			for (uint32_t j = 0; j < (size - 8); j++) {
+				sample.fill[j] = (uint8_t) (sample.seq + j);
+			}
+			uloop_publish_ex(0, &sample, size);
+			sample.seq += 1;
+		}
+		while (uloop_run()) {
+			continue;
+		}
+	}
+	CHECK_EQUAL(state.received[0], 3000);
+	CHECK_EQUAL(state.errors, 0);
+}
+
+TEST(uloop_lockfree, data_queue_overflow) {
+	uint8_t data[252] = {0};
+	for (uint32_t i = 0; i < (ULOOP_DATA_QUEUE_SIZE / 256); i++) {
+		uloop_publish_ex(EVENT_NODATA + 1, data, 252);
+	}
+	CHECK_THROWS(std::exception, uloop_publish_ex(EVENT_NODATA + 1, data, 252));
+	STRCMP_EQUAL(fail_reason, "dqOVF");
+}
+
+TEST(uloop_lockfree, reserve_commit) {
+	uloop_reservation_t reservation;
+	uint8_t data[8] = {0};
+	sample_t* sample = (sample_t*) uloop_publish_reserve(&reservation, 0, sample_size(0));
+	uloop_publish(EVENT_NODATA + 1);
+	CHECK_FALSE(uloop_run());
+	sample->producer = 0;
+	sample->seq = 0;
+	uloop_publish_commit(&reservation);
+	CHECK_TRUE(uloop_run());
+	CHECK_TRUE(uloop_run());
+	CHECK_FALSE(uloop_run());
+	CHECK_TRUE(uloop_publish_reserve(&reservation, 0, sizeof(data)) != NULL);
+	uloop_publish(EVENT_NODATA + 1);
+	uloop_publish_abort(&reservation);
+	CHECK_TRUE(uloop_run());
+	CHECK_TRUE(uloop_run());
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(state.events.size(), 3);
+	CHECK_EQUAL(state.events[0], 0);
+	CHECK_EQUAL(state.events[2], EVENT_NODATA + 1);
+	CHECK_EQUAL(state.received[0], 1);
+	CHECK_EQUAL(state.errors, 0);
+}
+
+TEST(uloop_lockfree, multi_producer_stress) {
+	pthread_t threads[PRODUCERS];
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		CHECK_EQUAL(pthread_create(&threads[i], NULL, producer_thread, (void*) (uintptr_t) i), 0);
+	}
+	uint32_t total = 0;
+	while (total < (PRODUCERS * SAMPLES)) {
+		if (uloop_run()) {
+			total += 1;
+		}
+	}
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(state.errors, 0);
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		CHECK_EQUAL(state.received[i], SAMPLES);
+	}
+}
+
+TEST(uloop_lockfree, multi_producer_reserve_stress) {
+	use_reserve = true;
+	pthread_t threads[PRODUCERS];
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		CHECK_EQUAL(pthread_create(&threads[i], NULL, producer_thread, (void*) (uintptr_t) i), 0);
+	}
+	uint32_t total = 0;
+	while (total < (PRODUCERS * SAMPLES)) {
+		if (uloop_run()) {
+			total += 1;
+		}
+	}
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(state.errors, 0);
+	for (uint32_t i = 0; i < PRODUCERS; i++) {
+		CHECK_EQUAL(state.received[i], SAMPLES);
+	}
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
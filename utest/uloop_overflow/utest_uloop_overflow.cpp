@@ -0,0 +1,270 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define FATAL      0
+#define DROP_NEW   1
+#define OLDEST     2
+#define BLOCK      3
+#define RESERVED   4
+
+#define CAPACITY   (ULOOP_EVENT_QUEUE_SIZE - 1)
+
+static void test_listener(uloop_event_t id, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[1] = {test_listener};
+
+const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[5] = {0};
+
+/* RESERVED keeps two event queue slots for itself and drops what does not fit */
+const uloop_overflow_t uloop_event_overflow[5] = {
+	{ULOOP_OVERFLOW_FATAL, 0xFF},
+	{ULOOP_OVERFLOW_DROP_NEW, 0xFF},
+	{ULOOP_OVERFLOW_DROP_OLDEST, 0xFF},
+	{ULOOP_OVERFLOW_BLOCK, 0xFF},
+	{ULOOP_OVERFLOW_DROP_NEW, 0}
+};
+const uint16_t uloop_overflow_reserves[1] = {2};
+
+static std::vector<uint32_t> events;
+static std::vector<std::string> payloads;
+static uloop_event_t republish;
+static uint32_t atomic_depth;
+static bool isr_armed;
+static bool isr_pending;
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	events.push_back(event);
+	payloads.push_back(std::string((const char*) data, size));
+	if (republish != ULOOP_EVENT_NONE) {
+		uloop_event_t next = republish;
+		republish = ULOOP_EVENT_NONE;
+		uloop_publish(next);
+	}
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	CHECK_EQUAL(atomic_depth, 0);
+	atomic_depth += 1;
+}
+
+static void fill(uloop_event_t event, uint32_t count);
+
+/* the interrupt fills the queue and then publishes an event that blocks */
+static void isr() {
+	fill(FATAL, CAPACITY - 2);
+	uloop_publish(BLOCK);
+}
+
+void mock_atomic_block_stop() {
+	CHECK_EQUAL(atomic_depth, 1);
+	atomic_depth -= 1;
+	if (isr_pending) {
+		isr_pending = false;
+		isr();
+	}
+}
+
+void mock_idle() {
+	// the interrupt that wakes the idle loop runs once the critical section is left
+	isr_pending = isr_armed;
+	isr_armed = false;
+}
+
+static void fill(uloop_event_t event, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		uloop_publish(event);
+	}
+}
+
+static uint32_t run_all() {
+	uint32_t count = 0;
+	while (uloop_run()) {
+		count += 1;
+	}
+	return count;
+}
+
+static uint32_t count(uloop_event_t event) {
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < events.size(); i++) {
+		count += (events[i] == event) ? 1 : 0;
+	}
+	return count;
+}
+
+TEST_GROUP(uloop_overflow) {
+	void setup() {
+		events.clear();
+		payloads.clear();
+		republish = ULOOP_EVENT_NONE;
+		atomic_depth = 0;
+		isr_armed = false;
+		isr_pending = false;
+		uloop_listener_active = ULOOP_LISTENER_NONE;
+		memset(uloop_event_stats, 0, sizeof(uloop_event_stats));
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_overflow, fatal) {
+	fill(FATAL, CAPACITY - 2);
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "eqOVF");
+	CHECK_THROWS(std::exception, uloop_publish(FATAL));
+}
+
+TEST(uloop_overflow, try_publish) {
+	fill(FATAL, CAPACITY - 2);
+	CHECK_FALSE(uloop_try_publish(FATAL));
+	CHECK_FALSE(uloop_try_publish(BLOCK));
+	CHECK_EQUAL(1, uloop_event_stats[FATAL].drops);
+	CHECK_EQUAL(1, uloop_event_stats[BLOCK].drops);
+	CHECK_EQUAL(CAPACITY - 2, run_all());
+	CHECK_TRUE(uloop_try_publish(FATAL));
+	CHECK_EQUAL(1, run_all());
+}
+
+TEST(uloop_overflow, try_publish_data) {
+	char data[60] = {0};
+	CHECK_TRUE(uloop_try_publish_ex(FATAL, data, sizeof(data)));
+	// the event queue has space, the data queue does not
+	CHECK_FALSE(uloop_try_publish_ex(FATAL, data, 8));
+	CHECK_EQUAL(1, uloop_event_stats[FATAL].drops);
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, uloop_publish_ex(FATAL, data, 8));
+}
+
+TEST(uloop_overflow, drop_new) {
+	fill(FATAL, CAPACITY - 2);
+	uloop_publish(DROP_NEW);
+	uloop_publish(DROP_NEW);
+	CHECK_EQUAL(2, uloop_event_stats[DROP_NEW].drops);
+	CHECK_EQUAL(CAPACITY - 2, run_all());
+	CHECK_EQUAL(0, count(DROP_NEW));
+}
+
+TEST(uloop_overflow, drop_oldest) {
+	uloop_publish(OLDEST);
+	fill(FATAL, CAPACITY - 3);
+	// the queue is full, the first entry takes the new publishes
+	uloop_publish(OLDEST);
+	uloop_publish(OLDEST);
+	CHECK_EQUAL(2, uloop_event_stats[OLDEST].drops);
+	CHECK_EQUAL(CAPACITY - 2, run_all());
+	CHECK_EQUAL(1, count(OLDEST));
+	CHECK_EQUAL(OLDEST, events[0]);
+}
+
+TEST(uloop_overflow, drop_oldest_taken) {
+	// the entry being dispatched can not be taken over
+	uloop_publish(OLDEST);
+	fill(FATAL, CAPACITY - 3);
+	republish = OLDEST;
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(1, uloop_event_stats[OLDEST].drops);
+	CHECK_EQUAL(CAPACITY - 3, run_all());
+	CHECK_EQUAL(1, count(OLDEST));
+}
+
+TEST(uloop_overflow, drop_oldest_ring_data) {
+	char data[4] = {1, 2, 3, 4};
+	uloop_publish_ex(OLDEST, data, sizeof(data));
+	fill(FATAL, CAPACITY - 3);
+	// data in the ring can not be exchanged, the new event is dropped
+	uloop_publish_ex(OLDEST, "abcd", 4);
+	CHECK_EQUAL(1, uloop_event_stats[OLDEST].drops);
+	CHECK_EQUAL(CAPACITY - 2, run_all());
+	CHECK_TRUE(payloads[0] == std::string(data, sizeof(data)));
+}
+
+TEST(uloop_overflow, block) {
+	fill(FATAL, CAPACITY - 2);
+	uloop_publish(BLOCK);
+	// one event was dispatched to make space
+	CHECK_EQUAL(1, events.size());
+	CHECK_EQUAL(0, uloop_event_stats[BLOCK].drops);
+	CHECK_EQUAL(CAPACITY - 2, run_all());
+	CHECK_EQUAL(BLOCK, events.back());
+}
+
+TEST(uloop_overflow, block_in_listener) {
+	fill(FATAL, CAPACITY - 2);
+	republish = BLOCK;
+	mock().expectOneCall("mock_dev_assert");
+	CHECK_THROWS(std::exception, uloop_run());
+}
+
+TEST(uloop_overflow, block_in_interrupt_while_idle) {
+	isr_armed = true;
+	mock().expectOneCall("mock_dev_assert");
+	CHECK_THROWS(std::exception, uloop_run());
+}
+
+TEST(uloop_overflow, reserve) {
+	// other events can not take the reserved slots
+	fill(FATAL, CAPACITY - 2);
+	CHECK_FALSE(uloop_try_publish(FATAL));
+	uloop_publish(RESERVED);
+	uloop_publish(RESERVED);
+	uloop_publish(RESERVED);
+	CHECK_EQUAL(1, uloop_event_stats[RESERVED].drops);
+	CHECK_EQUAL(CAPACITY, run_all());
+	CHECK_EQUAL(2, count(RESERVED));
+	// the reserve is back once the loop passed the slots
+	fill(FATAL, CAPACITY - 2);
+	CHECK_FALSE(uloop_try_publish(FATAL));
+}
+
+TEST(uloop_overflow, reserve_beyond) {
+	// a reserving event uses the shared slots once its reserve is used
+	fill(RESERVED, 3);
+	fill(FATAL, CAPACITY - 3);
+	CHECK_FALSE(uloop_try_publish(FATAL));
+	CHECK_FALSE(uloop_try_publish(RESERVED));
+	CHECK_EQUAL(CAPACITY, uloop_run_batch(CAPACITY + 1));
+	// a batch returns the reserve as well
+	fill(FATAL, CAPACITY - 2);
+	CHECK_FALSE(uloop_try_publish(FATAL));
+}
+
+TEST(uloop_overflow, reserve_abort) {
+	uloop_reservation_t reservation;
+	uloop_publish_reserve(&reservation, RESERVED, 0);
+	uloop_publish_abort(&reservation);
+	uloop_publish_reserve(&reservation, RESERVED, 0);
+	uloop_publish_abort(&reservation);
+	CHECK_EQUAL(2, run_all());
+	fill(RESERVED, 2);
+	fill(FATAL, CAPACITY - 2);
+	CHECK_FALSE(uloop_try_publish(FATAL));
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,2 @@
+#pragma once
+#include "uloop_platform_posix.h"
@@ -0,0 +1,348 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+#include "uloop_posix.h"
+
+#define SERIAL_EVENT  0
+#define A_EVENT       1
+#define B_EVENT       2
+#define BOTH_EVENT    3
+#define FD_EVENT      4
+#define PIPE_EVENT    5
+#define TICK_EVENT    6
+
+#define SERIAL_LISTENER 0
+#define A_LISTENER      1
+#define B_LISTENER      2
+#define FD_LISTENER     3
+
+#define WAIT_STEPS  1000
+
+static void serial_listener(uloop_event_t event, const void* data, uint32_t size);
+static void a_listener(uloop_event_t event, const void* data, uint32_t size);
+static void b_listener(uloop_event_t event, const void* data, uint32_t size);
+static void fd_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[4] = {serial_listener, a_listener, b_listener, fd_listener};
+
+const uloop_listener_id_t uloop_listener_table[15] = {
+	0, ULOOP_LISTENER_NONE, 1, ULOOP_LISTENER_NONE, 2, ULOOP_LISTENER_NONE, 1, 2, ULOOP_LISTENER_NONE,
+	3, ULOOP_LISTENER_NONE, 3, ULOOP_LISTENER_NONE, 3, ULOOP_LISTENER_NONE
+};
+const uloop_listener_lut_t uloop_listener_lut[7] = {0, 2, 4, 6, 9, 11, 13};
+
+/* a_listener and b_listener are "parallel": true */
+const uint32_t uloop_listener_parallel[1] = {0x00000006};
+
+static pthread_t loop_thread;
+static std::vector<uint32_t> a_values;
+static std::vector<pthread_t> serial_threads;
+static pthread_t a_thread;
+static uint32_t a_running;
+static uint32_t a_overlaps;
+static uint32_t serial_calls;
+static bool a_waits_for_b;
+static bool a_saw_b;
+static bool b_done;
+static bool a_replies;
+static int pipe_fds[2];
+static std::vector<std::string> fd_data;
+static uint32_t ticks;
+
+static void serial_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	(void) data;
+	(void) size;
+	serial_calls += 1;
+	serial_threads.push_back(pthread_self());
+}
+
+static void a_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	// runs of one listener are never overlapping, whatever worker they are on
+	if (__atomic_add_fetch(&a_running, 1, __ATOMIC_ACQ_REL) != 1) {
+		__atomic_add_fetch(&a_overlaps, 1, __ATOMIC_RELAXED);
+	}
+	a_thread = pthread_self();
+	if (size == sizeof(uint32_t)) {
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		a_values.push_back(value);
+	}
+	if (a_waits_for_b) {
+		for (uint32_t i = 0; (i < WAIT_STEPS) && !__atomic_load_n(&b_done, __ATOMIC_ACQUIRE); i++) {
+			usleep(1000);
+		}
+		a_saw_b = __atomic_load_n(&b_done, __ATOMIC_ACQUIRE);
+	}
+	if (a_replies) {
+		uloop_publish(SERIAL_EVENT);
+	}
+	__atomic_sub_fetch(&a_running, 1, __ATOMIC_ACQ_REL);
+}
+
+static void b_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	(void) data;
+	(void) size;
+	__atomic_store_n(&b_done, true, __ATOMIC_RELEASE);
+}
+
+static void fd_listener(uloop_event_t event, const void* data, uint32_t size) {
+	if (event == FD_EVENT) {
+		// the listener reads the fd itself and arms it again
+		char byte;
+		CHECK_EQUAL(1, read(pipe_fds[0], &byte, 1));
+		fd_data.push_back(std::string(&byte, 1));
+		uloop_fd_arm(pipe_fds[0]);
+	} else if (event == PIPE_EVENT) {
+		fd_data.push_back(std::string((const char*) data, size));
+	} else {
+		ticks += 1;
+	}
+}
+
+static void run_until(const uint32_t* value, uint32_t expected) {
+	for (uint32_t i = 0; (i < WAIT_STEPS) && (*value < expected); i++) {
+		uloop_run();
+	}
+}
+
+static void run_until_data(uint32_t count) {
+	for (uint32_t i = 0; (i < WAIT_STEPS) && (fd_data.size() < count); i++) {
+		uloop_run();
+	}
+}
+
+static void* late_publisher(void* arg) {
+	(void) arg;
+	usleep(20000);
+	uloop_publish(SERIAL_EVENT);
+	return NULL;
+}
+
+static void run_all() {
+	uloop_run_until_idle();
+	uloop_pool_wait();
+	uloop_run_until_idle();
+}
+
+TEST_GROUP(uloop_posix) {
+	void setup() {
+		loop_thread = pthread_self();
+		a_values.clear();
+		serial_threads.clear();
+		a_thread = loop_thread;
+		a_running = 0;
+		a_overlaps = 0;
+		serial_calls = 0;
+		a_waits_for_b = false;
+		a_saw_b = false;
+		b_done = false;
+		a_replies = false;
+		fd_data.clear();
+		ticks = 0;
+		CHECK_EQUAL(0, pipe(pipe_fds));
+		memset(uloop_event_stats, 0, sizeof(uloop_event_stats));
+		memset(uloop_listener_stats, 0, sizeof(uloop_listener_stats));
+		uloop_init();
+	}
+
+	void teardown() {
+		uloop_pool_stop();
+		uloop_fd_remove(pipe_fds[0]);
+		close(pipe_fds[0]);
+		close(pipe_fds[1]);
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_posix, inline_without_pool) {
+	uloop_publish(A_EVENT);
+	CHECK_TRUE(uloop_run());
+	CHECK_TRUE(pthread_equal(loop_thread, a_thread));
+	CHECK_EQUAL(1, uloop_listener_stats[A_LISTENER].runs);
+}
+
+TEST(uloop_posix, serial_stays_on_loop) {
+	uloop_pool_start(2);
+	uloop_publish(SERIAL_EVENT);
+	uloop_publish(A_EVENT);
+	run_all();
+	CHECK_EQUAL(1, serial_calls);
+	CHECK_TRUE(pthread_equal(loop_thread, serial_threads[0]));
+	CHECK_FALSE(pthread_equal(loop_thread, a_thread));
+}
+
+TEST(uloop_posix, order_per_listener) {
+	uloop_pool_start(4);
+	for (uint32_t i = 0; i < 200; i++) {
+		uloop_publish_ex(A_EVENT, &i, sizeof(i));
+		if ((i % 8) == 7) {
+			// the data queue slots are reused while the workers still run, the jobs have copies
+			uloop_run_until_idle();
+		}
+	}
+	run_all();
+	CHECK_EQUAL(0, a_overlaps);
+	CHECK_EQUAL(200, a_values.size());
+	for (uint32_t i = 0; i < 200; i++) {
+		CHECK_EQUAL(i, a_values[i]);
+	}
+}
+
+TEST(uloop_posix, listeners_run_in_parallel) {
+	// a_listener only sees b_listener finish when they run on different workers
+	a_waits_for_b = true;
+	uloop_pool_start(2);
+	uloop_publish(BOTH_EVENT);
+	run_all();
+	CHECK_TRUE(a_saw_b);
+}
+
+TEST(uloop_posix, publish_from_worker) {
+	a_replies = true;
+	uloop_pool_start(2);
+	uloop_publish(A_EVENT);
+	run_all();
+	CHECK_EQUAL(1, serial_calls);
+	CHECK_TRUE(pthread_equal(loop_thread, serial_threads[0]));
+}
+
+TEST(uloop_posix, statistics_merged) {
+	uloop_listenter_stats_t stats;
+	uloop_pool_start(3);
+	for (uint32_t i = 0; i < 10; i++) {
+		uloop_publish(BOTH_EVENT);
+	}
+	run_all();
+	// the workers count in their own shards
+	CHECK_EQUAL(0, uloop_listener_stats[A_LISTENER].runs);
+	uloop_pool_listener_stats(A_LISTENER, &stats);
+	CHECK_EQUAL(10, stats.runs);
+	uloop_pool_listener_stats(B_LISTENER, &stats);
+	CHECK_EQUAL(10, stats.runs);
+	CHECK_EQUAL(10, uloop_event_stats[BOTH_EVENT].count);
+	uloop_pool_stop();
+	CHECK_EQUAL(10, uloop_listener_stats[A_LISTENER].runs);
+	CHECK_EQUAL(10, uloop_listener_stats[B_LISTENER].runs);
+}
+
+TEST(uloop_posix, statistics_while_running) {
+	uloop_listenter_stats_t stats;
+	uint32_t runs = 0;
+	uloop_pool_start(2);
+	for (uint32_t i = 0; i < 50; i++) {
+		uloop_publish(BOTH_EVENT);
+		(void) uloop_run();
+		// the shards are read while the workers update them
+		uloop_pool_listener_stats(A_LISTENER, &stats);
+		CHECK_TRUE((stats.runs >= runs) && (stats.runs <= 50));
+		runs = stats.runs;
+	}
+	run_all();
+	uloop_pool_listener_stats(A_LISTENER, &stats);
+	CHECK_EQUAL(50, stats.runs);
+}
+
+TEST(uloop_posix, idle_wakeup) {
+	uloop_pool_start(1);
+	a_replies = true;
+	uloop_publish(A_EVENT);
+	CHECK_TRUE(uloop_run());
+	// the loop sleeps until the worker publishes the reply
+	for (uint32_t i = 0; (i < WAIT_STEPS) && (serial_calls == 0); i++) {
+		uloop_run();
+	}
+	CHECK_EQUAL(1, serial_calls);
+}
+
+TEST(uloop_posix, wakeup_from_thread) {
+	pthread_t thread;
+	uint32_t start = uloop_posix_ms();
+	pthread_create(&thread, NULL, late_publisher, NULL);
+	// nothing is queued, the loop sleeps in epoll_wait until the eventfd is written
+	run_until(&serial_calls, 1);
+	pthread_join(thread, NULL);
+	CHECK_EQUAL(1, serial_calls);
+	CHECK_TRUE((uloop_posix_ms() - start) < 1000);
+}
+
+TEST(uloop_posix, fd_readiness) {
+	CHECK_TRUE(uloop_fd_add(pipe_fds[0], FD_EVENT, 0));
+	CHECK_EQUAL(2, write(pipe_fds[1], "ab", 2));
+	// one event per readiness, the second byte is seen after the listener armed the fd again
+	run_until_data(2);
+	CHECK_EQUAL(2, fd_data.size());
+	STRCMP_EQUAL("a", fd_data[0].c_str());
+	STRCMP_EQUAL("b", fd_data[1].c_str());
+	CHECK_EQUAL(2, uloop_event_stats[FD_EVENT].count);
+}
+
+TEST(uloop_posix, fd_read_data) {
+	CHECK_TRUE(uloop_fd_add(pipe_fds[0], PIPE_EVENT, 8));
+	CHECK_EQUAL(5, write(pipe_fds[1], "hello", 5));
+	run_until_data(1);
+	STRCMP_EQUAL("hello", fd_data[0].c_str());
+	// longer writes are split into read_size chunks
+	CHECK_EQUAL(10, write(pipe_fds[1], "0123456789", 10));
+	run_until_data(3);
+	STRCMP_EQUAL("01234567", fd_data[1].c_str());
+	STRCMP_EQUAL("89", fd_data[2].c_str());
+}
+
+TEST(uloop_posix, fd_end_of_stream) {
+	CHECK_TRUE(uloop_fd_add(pipe_fds[0], PIPE_EVENT, 8));
+	close(pipe_fds[1]);
+	pipe_fds[1] = -1;
+	run_until_data(1);
+	CHECK_EQUAL(1, fd_data.size());
+	CHECK_EQUAL(0, fd_data[0].size());
+	// the fd was removed, it can be added again
+	CHECK_TRUE(uloop_fd_add(pipe_fds[0], PIPE_EVENT, 8));
+}
+
+TEST(uloop_posix, fd_source_table_full) {
+	int fds[ULOOP_FD_SOURCE_COUNT];
+	for (uint32_t i = 0; i < ULOOP_FD_SOURCE_COUNT; i++) {
+		fds[i] = dup(pipe_fds[0]);
+		CHECK_TRUE(uloop_fd_add(fds[i], FD_EVENT, 0));
+	}
+	CHECK_FALSE(uloop_fd_add(pipe_fds[0], FD_EVENT, 0));
+	for (uint32_t i = 0; i < ULOOP_FD_SOURCE_COUNT; i++) {
+		uloop_fd_remove(fds[i]);
+		close(fds[i]);
+	}
+}
+
+TEST(uloop_posix, fd_timer) {
+	int fd = uloop_fd_timer(TICK_EVENT);
+	CHECK_TRUE(fd >= 0);
+	uint32_t start = uloop_posix_ms();
+	uloop_posix_timer_set(start + 5);
+	run_until(&ticks, 1);
+	CHECK_EQUAL(1, ticks);
+	CHECK_TRUE((uloop_posix_ms() - start) >= 4);
+	// a deadline that passed already fires right away
+	uloop_posix_timer_set(start);
+	run_until(&ticks, 2);
+	CHECK_EQUAL(2, ticks);
+	uloop_fd_remove(fd);
+	close(fd);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,236 @@
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define LOW     0
+#define MEDIUM  64
+#define HIGH    128
+#define RETAIN  (HIGH + 63)
+
+#define R16(p)  p, p, p, p, p, p, p, p, p, p, p, p, p, p, p, p
+#define R64(p)  R16(p), R16(p), R16(p), R16(p)
+
+static void test_listener(uloop_event_t id, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[1] = {test_listener};
+
+const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {0};
+
+/* level 0: 16 events, 256 bytes; level 1: 8 events, no data; level 2: 4 events, 64 bytes */
+const uloop_priority_level_t uloop_priority_levels[ULOOP_PRIORITY_COUNT] = {
+	{0, 16, 0, 256},
+	{16, 8, 256, 0},
+	{24, 4, 256, 64}
+};
+
+const uint8_t uloop_event_priority[ULOOP_EVENT_COUNT] = {R64(0), R64(1), R64(2), R64(2)};
+
+static std::vector<uint32_t> events;
+static std::vector<uint32_t> sizes;
+static const void* retained;
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	events.push_back(event);
+	sizes.push_back(size);
+	if (event == RETAIN) {
+		uloop_data_retain(data);
+		retained = data;
+	}
+	for (uint32_t i = 0; i < size; i++) {
+		CHECK_EQUAL(((const uint8_t*) data)[i], (uint8_t) (event + i));
+	}
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	mock().actualCall(__FUNCTION__);
+}
+
+void mock_atomic_block_stop() {
+	mock().actualCall(__FUNCTION__);
+}
+
+void mock_idle() {
+	mock().actualCall(__FUNCTION__);
+}
+
+static void publish(uloop_event_t event, uint32_t size = 0) {
+	uint8_t data[256];
+	for (uint32_t i = 0; i < size; i++) {
+		data[i] = (uint8_t) (event + i);
+	}
+	uloop_publish_ex(event, data, size);
+}
+
+static uint32_t run_all() {
+	uint32_t count = 0;
+	while (uloop_run()) {
+		count += 1;
+	}
+	return count;
+}
+
+TEST_GROUP(uloop_priority)
+{
+	void setup() {
+		mock().ignoreOtherCalls();
+		uloop_init();
+		events.clear();
+		sizes.clear();
+	}
+	void teardown() {
+		mock().clear();
+	}
+};
+
+TEST(uloop_priority, highest_level_first) {
+	publish(LOW + 1);
+	publish(MEDIUM + 1);
+	publish(LOW + 2);
+	publish(HIGH + 1);
+	publish(MEDIUM + 2);
+	publish(HIGH + 2);
+	const uint32_t order[] = {HIGH + 1, HIGH + 2, MEDIUM + 1, MEDIUM + 2, LOW + 1, LOW + 2};
+	for (uint32_t i = 0; i < 6; i++) {
+		CHECK_EQUAL(uloop_event_queue_get(i).id, order[i]);
+	}
+	CHECK_EQUAL(uloop_event_queue_get(6).id, ULOOP_EVENT_NONE);
+	CHECK_EQUAL(run_all(), 6);
+	for (uint32_t i = 0; i < 6; i++) {
+		CHECK_EQUAL(events[i], order[i]);
+	}
+}
+
+TEST(uloop_priority, preempt_lower_level) {
+	for (uint32_t i = 0; i < 10; i++) {
+		publish(LOW + i);
+	}
+	CHECK_TRUE(uloop_run());
+	CHECK_TRUE(uloop_run());
+	publish(HIGH);
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(events.back(), HIGH);
+	CHECK_EQUAL(run_all(), 8);
+	CHECK_EQUAL(events.back(), LOW + 9);
+}
+
+TEST(uloop_priority, level_data) {
+	for (uint32_t n = 0; n < 100; n++) {
+		publish(LOW + (n % 50), 4 + (n % 60));
+		publish(HIGH + (n % 50), n % 17);
+		publish(MEDIUM + (n % 50));
+		CHECK_EQUAL(run_all(), 3);
+	}
+	CHECK_EQUAL(events.size(), 300);
+	CHECK_EQUAL(events[0], HIGH);
+	CHECK_EQUAL(events[1], MEDIUM);
+	CHECK_EQUAL(events[2], LOW);
+}
+
+TEST(uloop_priority, level_overflow) {
+	for (uint32_t i = 0; i < 4; i++) {
+		publish(HIGH);
+	}
+	publish(LOW);
+	mock().expectOneCall("mock_fail").withParameter("reason", "eqOVF");
+	CHECK_THROWS(std::exception, publish(HIGH));
+	mock().checkExpectations();
+}
+
+TEST(uloop_priority, level_data_overflow) {
+	publish(LOW, 200);
+	publish(HIGH, 60);
+	mock().expectOneCall("mock_fail").withParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, publish(HIGH, 8));
+	mock().checkExpectations();
+}
+
+TEST(uloop_priority, level_without_data) {
+	mock().expectOneCall("mock_fail").withParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, publish(MEDIUM, 4));
+	mock().checkExpectations();
+}
+
+TEST(uloop_priority, reserve_blocks_own_level) {
+	uloop_reservation_t reservation;
+	uint8_t* ptr = (uint8_t*) uloop_publish_reserve(&reservation, HIGH + 1, 8);
+	for (uint32_t i = 0; i < 8; i++) {
+		ptr[i] = (uint8_t) (HIGH + 1 + i);
+	}
+	publish(HIGH + 2);
+	publish(LOW + 1);
+	CHECK_EQUAL(uloop_event_queue_get(0).id, LOW + 1);
+	CHECK_EQUAL(run_all(), 1);
+	uloop_publish_commit(&reservation);
+	CHECK_EQUAL(run_all(), 2);
+	CHECK_EQUAL(events[1], HIGH + 1);
+	CHECK_EQUAL(sizes[1], 8);
+	CHECK_EQUAL(events[2], HIGH + 2);
+}
+
+TEST(uloop_priority, reserve_abort) {
+	uloop_reservation_t reservation;
+	for (uint32_t n = 0; n < 20; n++) {
+		CHECK_TRUE(uloop_publish_reserve(&reservation, HIGH + 1, 60) != NULL);
+		publish(HIGH + 2, 4);
+		uloop_publish_abort(&reservation);
+		CHECK_EQUAL(run_all(), 2);
+	}
+	CHECK_EQUAL(events.size(), 20);
+	CHECK_EQUAL(events[0], HIGH + 2);
+}
+
+TEST(uloop_priority, data_retain) {
+	publish(RETAIN, 24);
+	publish(LOW, 100);
+	CHECK_EQUAL(run_all(), 2);
+	for (uint32_t i = 0; i < 24; i++) {
+		CHECK_EQUAL(((const uint8_t*) retained)[i], (uint8_t) (RETAIN + i));
+	}
+	publish(HIGH + 1, 36);
+	mock().expectOneCall("mock_fail").withParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, publish(HIGH + 1, 8));
+	mock().checkExpectations();
+	mock().clear();
+	mock().ignoreOtherCalls();
+	CHECK_EQUAL(run_all(), 1);
+	uloop_data_release(retained);
+	for (uint32_t n = 0; n < 20; n++) {
+		publish(HIGH + 1, 36);
+		CHECK_EQUAL(run_all(), 1);
+	}
+}
+
+TEST(uloop_priority, idle_hook) {
+	publish(LOW + 1);
+	publish(HIGH + 1);
+	mock().expectOneCall("mock_idle");
+	CHECK_EQUAL(run_all(), 2);
+	mock().checkExpectations();
+	mock().expectOneCall("mock_idle");
+	CHECK_FALSE(uloop_run());
+	mock().checkExpectations();
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
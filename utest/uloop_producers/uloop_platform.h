@@ -0,0 +1,20 @@
+#pragma once
+#include "uloop.h"
+
+extern void producers_fail(const char* reason);
+extern uint32_t producers_timestamp(void);
+
+#define ULOOP_ERROR_EQOVF()         producers_fail("eqOVF");
+#define ULOOP_ERROR_DQOVF()         producers_fail("dqOVF");
+#define ULOOP_ERROR_DQCORR()        producers_fail("dqCORR");
+
+#define ULOOP_DEV_ASSERT(cond)     \
+	do { \
+		if (!(cond)) { \
+			producers_fail("assert"); \
+		} \
+	} while (0)
+
+#define ULOOP_TIMER_START()         do {} while (0)
+#define ULOOP_TIMER_STOP()          0
+#define ULOOP_TIMESTAMP()           producers_timestamp()
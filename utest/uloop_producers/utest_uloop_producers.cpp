@@ -0,0 +1,241 @@
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define SAMPLES       50000
+#define IN_FLIGHT     (ULOOP_EVENT_QUEUE_SIZE - 1)
+
+typedef struct {
+	uint32_t producer;
+	uint32_t seq;
+	uint8_t fill[32];
+} sample_t;
+
+static void test_listener(uloop_event_t id, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[1] = {test_listener};
+
+const uloop_listener_id_t uloop_listener_table[2] = {0, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[ULOOP_EVENT_COUNT] = {0};
+
+static struct {
+	uint32_t received[ULOOP_PRODUCER_COUNT];
+	uint32_t errors;
+	std::vector<uint32_t> events;
+} state;
+
+static const char* fail_reason;
+static uint32_t timestamp;
+
+void producers_fail(const char* reason) {
+	fail_reason = reason;
+	throw std::exception();
+}
+
+uint32_t producers_timestamp() {
+	return __atomic_fetch_add(&timestamp, 1, __ATOMIC_RELAXED);
+}
+
+static uint32_t sample_size(uint32_t seq) {
+	return 8 + (seq % (sizeof(((sample_t*) NULL)->fill) + 1));
+}
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	state.events.push_back(event);
+	if (size == 0) {
+		return;
+	}
+	const sample_t* sample = (const sample_t*) data;
+	if ((event >= ULOOP_PRODUCER_COUNT) || (sample->producer != event) || (((uintptr_t) data & 3) != 0)) {
+		state.errors += 1;
+		return;
+	}
+	if ((sample->seq != state.received[event]) || (size != sample_size(sample->seq))) {
+		state.errors += 1;
+	}
+	for (uint32_t i = 0; i < (size - 8); i++) {
+		if (sample->fill[i] != (uint8_t) (sample->seq + i)) {
+			state.errors += 1;
+			break;
+		}
+	}
+	__atomic_store_n(&state.received[event], state.received[event] + 1, __ATOMIC_RELEASE);
+}
+
+static void* producer_thread(void* arg) {
+	uloop_producer_t producer = (uloop_producer_t) (uintptr_t) arg;
+	sample_t sample;
+	sample.producer = producer;
+	for (uint32_t seq = 0; seq < SAMPLES; seq++) {
+		while ((seq - __atomic_load_n(&state.received[producer], __ATOMIC_ACQUIRE)) >= IN_FLIGHT) {
+			sched_yield();
+		}
+		uint32_t size = sample_size(seq);
+		sample.seq = seq;
+		for (uint32_t i = 0; i < (size - 8); i++) {
+			sample.fill[i] = (uint8_t) (seq + i);
+		}
+		uloop_publish_ex_from(producer, producer, &sample, size);
+	}
+	return NULL;
+}
+
+static void publish_at(uint32_t stamp, uloop_producer_t producer, uloop_event_t event) {
+	timestamp = stamp;
+	uloop_publish_from(producer, event);
+}
+
+TEST_GROUP(uloop_producers)
+{
+	void setup() {
+		uloop_init();
+		memset(state.received, 0, sizeof(state.received));
+		state.errors = 0;
+		state.events.clear();
+		fail_reason = NULL;
+		timestamp = 0;
+	}
+	void teardown() {
+		mock().clear();
+	}
+};
+
+TEST(uloop_producers, merge_order) {
+	publish_at(10, 1, 10);
+	publish_at(30, 1, 30);
+	publish_at(20, 2, 20);
+	publish_at(5, 3, 5);
+	publish_at(25, 0, 25);
+	publish_at(40, 3, 40);
+	const uint32_t order[] = {5, 10, 20, 25, 30, 40};
+	for (uint32_t i = 0; i < 6; i++) {
+		CHECK_EQUAL(uloop_event_queue_get(i).id, order[i]);
+	}
+	CHECK_EQUAL(uloop_event_queue_get(6).id, ULOOP_EVENT_NONE);
+	while (uloop_run()) {
+		continue;
+	}
+	CHECK_EQUAL(state.events.size(), 6);
+	for (uint32_t i = 0; i < 6; i++) {
+		CHECK_EQUAL(state.events[i], order[i]);
+	}
+}
+
+TEST(uloop_producers, merge_stamp_wrap) {
+	publish_at(0xFFFFFFF0, 2, 1);
+	publish_at(0x00000010, 1, 2);
+	publish_at(0xFFFFFFFF, 0, 3);
+	while (uloop_run()) {
+		continue;
+	}
+	CHECK_EQUAL(state.events.size(), 3);
+	CHECK_EQUAL(state.events[0], 1);
+	CHECK_EQUAL(state.events[1], 3);
+	CHECK_EQUAL(state.events[2], 2);
+}
+
+TEST(uloop_producers, merge_tie) {
+	publish_at(7, 3, 3);
+	publish_at(7, 1, 1);
+	publish_at(7, 2, 2);
+	while (uloop_run()) {
+		continue;
+	}
+	CHECK_EQUAL(state.events.size(), 3);
+	for (uint32_t i = 0; i < 3; i++) {
+		CHECK_EQUAL(state.events[i], i + 1);
+	}
+}
+
+TEST(uloop_producers, producer_overflow) {
+	for (uint32_t i = 0; i < ULOOP_EVENT_QUEUE_SIZE; i++) {
+		uloop_publish_from(1, 1);
+	}
+	uloop_publish_from(2, 2);
+	uloop_publish(0);
+	CHECK_THROWS(std::exception, uloop_publish_from(1, 1));
+	STRCMP_EQUAL(fail_reason, "eqOVF");
+	uint32_t count = 0;
+	while (uloop_run()) {
+		count += 1;
+	}
+	CHECK_EQUAL(count, ULOOP_EVENT_QUEUE_SIZE + 2);
+}
+
+TEST(uloop_producers, data_overflow) {
+	uint8_t data[252] = {0};
+	for (uint32_t i = 0; i < (ULOOP_DATA_QUEUE_SIZE / 256); i++) {
+		uloop_publish_ex_from(3, 200, data, 252);
+	}
+	uloop_publish_ex_from(2, 200, data, 252);
+	CHECK_THROWS(std::exception, uloop_publish_ex_from(3, 200, data, 252));
+	STRCMP_EQUAL(fail_reason, "dqOVF");
+}
+
+TEST(uloop_producers, reserve_nested_publish) {
+	uloop_reservation_t reservation;
+	timestamp = 10;
+	uint8_t* ptr = (uint8_t*) uloop_publish_reserve_from(1, &reservation, 1, 8);
+	memset(ptr, 0, 8);
+	publish_at(20, 1, 2);
+	publish_at(30, 2, 3);
+	CHECK_TRUE(uloop_run());
+	CHECK_FALSE(uloop_run());
+	uloop_publish_commit(&reservation);
+	while (uloop_run()) {
+		continue;
+	}
+	CHECK_EQUAL(state.events.size(), 3);
+	CHECK_EQUAL(state.events[0], 3);
+	CHECK_EQUAL(state.events[1], 1);
+	CHECK_EQUAL(state.events[2], 2);
+}
+
+TEST(uloop_producers, reserve_abort) {
+	uloop_reservation_t reservation;
+	for (uint32_t n = 0; n < (2 * ULOOP_EVENT_QUEUE_SIZE); n++) {
+		CHECK_TRUE(uloop_publish_reserve_from(3, &reservation, 3, 200) != NULL);
+		uloop_publish_from(3, 2);
+		uloop_publish_abort(&reservation);
+		CHECK_TRUE(uloop_run());
+		CHECK_TRUE(uloop_run());
+		CHECK_FALSE(uloop_run());
+	}
+	CHECK_EQUAL(state.events.size(), 2 * ULOOP_EVENT_QUEUE_SIZE);
+	CHECK_EQUAL(state.errors, 0);
+}
+
+TEST(uloop_producers, multi_producer_stress) {
+	pthread_t threads[ULOOP_PRODUCER_COUNT];
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		CHECK_EQUAL(pthread_create(&threads[i], NULL, producer_thread, (void*) (uintptr_t) i), 0);
+	}
+	uint32_t total = 0;
+	while (total < (ULOOP_PRODUCER_COUNT * SAMPLES)) {
+		if (uloop_run()) {
+			total += 1;
+		}
+	}
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(state.errors, 0);
+	for (uint32_t i = 0; i < ULOOP_PRODUCER_COUNT; i++) {
+		CHECK_EQUAL(state.received[i], SAMPLES);
+	}
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,10 @@
+#define ULOOP_EVENT_QUEUE_SIZE    16
+#define ULOOP_DATA_QUEUE_SIZE     256
+#define ULOOP_LISTENER_TIME_LIMIT 0
+#define ULOOP_METADATA_NAME_SIZE  4
+
+#define ULOOP_LISTENER_COUNT      2
+#define ULOOP_LISTENER_TABLE_SIZE 7
+#define ULOOP_EVENT_COUNT         3
+
+#define ULOOP_STATISTICS_ENABLED
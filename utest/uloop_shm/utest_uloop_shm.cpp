@@ -0,0 +1,181 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+#include "uloop_posix.h"
+#include "uloop_shm.h"
+
+#define PING_EVENT     0
+#define PONG_EVENT     1
+#define FORWARD_EVENT  2
+
+#define TEST_LISTENER  0
+#define SHM_LISTENER   1
+
+#define RING_SIZE   256
+#define WAIT_STEPS  1000
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[2] = {test_listener, uloop_shm_listener};
+
+/* test_listener runs before uloop_shm_listener */
+const uloop_listener_id_t uloop_listener_table[7] = {
+	0, ULOOP_LISTENER_NONE, 0, ULOOP_LISTENER_NONE, 0, 1, ULOOP_LISTENER_NONE
+};
+const uloop_listener_lut_t uloop_listener_lut[3] = {0, 2, 4};
+
+static std::vector<std::string> calls;
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	calls.push_back(std::string(1, (char) ('0' + event)) + " " + std::string((const char*) data, size));
+	if ((event == FORWARD_EVENT) && (calls.size() == 2)) {
+		// the copy that came back over the bridge is not sent again
+		uloop_shm_forward(NULL, FORWARD_EVENT);
+	}
+}
+
+static void run_until(uint32_t count) {
+	for (uint32_t i = 0; (i < WAIT_STEPS) && (calls.size() < count); i++) {
+		uloop_run();
+	}
+}
+
+TEST_GROUP(uloop_shm) {
+	int fd;
+	uloop_shm_t* side0;
+	uloop_shm_t* side1;
+
+	void setup() {
+		calls.clear();
+		uloop_init();
+		// both sides in one process, the peer publishes into the same loop
+		fd = memfd_create("uloop_shm", 0);
+		side0 = uloop_shm_map(fd, RING_SIZE, 0);
+		side1 = uloop_shm_map(fd, RING_SIZE, 1);
+		CHECK_TRUE(side0 != NULL);
+		CHECK_TRUE(side1 != NULL);
+	}
+
+	void teardown() {
+		uloop_shm_close(side0);
+		uloop_shm_close(side1);
+		close(fd);
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_shm, publish_to_peer) {
+	uloop_shm_stats_t stats;
+	CHECK_TRUE(uloop_shm_publish_ex(side0, PING_EVENT, "abc", 3));
+	run_until(1);
+	CHECK_EQUAL(1, calls.size());
+	STRCMP_EQUAL("0 abc", calls[0].c_str());
+	uloop_shm_stats(side0, &stats);
+	CHECK_EQUAL(1, stats.sent);
+	// counted by the receiving thread after its publish
+	uloop_shm_stats(side1, &stats);
+	for (uint32_t i = 0; (i < WAIT_STEPS) && (stats.received == 0); i++) {
+		usleep(1000);
+		uloop_shm_stats(side1, &stats);
+	}
+	CHECK_EQUAL(1, stats.received);
+}
+
+TEST(uloop_shm, both_directions) {
+	CHECK_TRUE(uloop_shm_publish_ex(side1, PONG_EVENT, "b", 1));
+	CHECK_TRUE(uloop_shm_publish(side0, PING_EVENT));
+	run_until(2);
+	CHECK_EQUAL(2, calls.size());
+}
+
+TEST(uloop_shm, reserve_in_place) {
+	char* payload = (char*) uloop_shm_reserve(side0, PING_EVENT, 4);
+	CHECK_TRUE(payload != NULL);
+	memcpy(payload, "wxyz", 4);
+	uloop_shm_commit(side0);
+	run_until(1);
+	STRCMP_EQUAL("0 wxyz", calls[0].c_str());
+}
+
+TEST(uloop_shm, wrap_in_order) {
+	// entry sizes that do not divide the ring, every lap ends with a skipped tail
+	uint32_t sent = 0;
+	char text[32];
+	for (uint32_t i = 0; i < 300; i++) {
+		uint32_t size = (uint32_t) snprintf(text, sizeof(text), "%u-%.*s", (unsigned) i, (int) (i % 13), "abcdefghijklm");
+		while (!uloop_shm_publish_ex(side0, PING_EVENT, text, size)) {
+			uloop_run_until_idle();
+		}
+		sent += 1;
+		if ((i % 7) == 0) {
+			uloop_run_until_idle();
+		}
+	}
+	run_until(sent);
+	CHECK_EQUAL(300, calls.size());
+	for (uint32_t i = 0; i < 300; i++) {
+		snprintf(text, sizeof(text), "0 %u-%.*s", (unsigned) i, (int) (i % 13), "abcdefghijklm");
+		STRCMP_EQUAL(text, calls[i].c_str());
+	}
+}
+
+TEST(uloop_shm, ring_full) {
+	uloop_shm_stats_t stats;
+	uint32_t sent = 0;
+	// the loop is not run, the event queue and then the ring fill up
+	for (uint32_t i = 0; i < 100; i++) {
+		sent += uloop_shm_publish_ex(side0, PING_EVENT, "12345678", 8) ? 1 : 0;
+	}
+	uloop_shm_stats(side0, &stats);
+	CHECK_TRUE(stats.drops > 0);
+	CHECK_EQUAL(100, stats.sent + stats.drops);
+	// nothing that was accepted is lost
+	run_until(sent);
+	CHECK_EQUAL(sent, calls.size());
+}
+
+TEST(uloop_shm, sleeping_peer_woken_once) {
+	uloop_shm_stats_t stats;
+	usleep(20000);
+	CHECK_TRUE(uloop_shm_publish(side0, PING_EVENT));
+	run_until(1);
+	uloop_shm_stats(side0, &stats);
+	CHECK_EQUAL(1, stats.wakeups);
+	for (uint32_t i = 0; i < 10; i++) {
+		CHECK_TRUE(uloop_shm_publish(side0, PING_EVENT));
+	}
+	run_until(11);
+	uloop_shm_stats(side0, &stats);
+	CHECK_TRUE(stats.wakeups <= 11);
+}
+
+TEST(uloop_shm, forward_listener) {
+	uloop_shm_forward(side0, FORWARD_EVENT);
+	uloop_publish_ex(FORWARD_EVENT, "fw", 2);
+	// dispatched locally, then once more as it arrives from the peer
+	run_until(2);
+	uloop_run_until_idle();
+	CHECK_EQUAL(2, calls.size());
+	STRCMP_EQUAL("2 fw", calls[0].c_str());
+	STRCMP_EQUAL("2 fw", calls[1].c_str());
+}
+
+TEST(uloop_shm, attach_checks_size) {
+	CHECK_TRUE(uloop_shm_map(fd, RING_SIZE * 2, 1) == NULL);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,237 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define PLAIN      0
+#define RETAINED   1
+#define FANOUT     2
+
+static void test_listener(uloop_event_t id, const void* data, uint32_t size);
+static void fanout_listener(uloop_event_t id, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[2] = {test_listener, fanout_listener};
+
+/* FANOUT goes to both listeners, each of them retains the data */
+const uloop_listener_id_t uloop_listener_table[5] = {0, ULOOP_LISTENER_NONE, 0, 1, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[3] = {0, 0, 2};
+
+/* four 6 byte blocks rounded to 8, two 64 byte blocks and a single 2048 byte block */
+const uloop_slab_class_t uloop_slab_classes[3] = {{8, 4, 0, 0}, {64, 2, 4, 32}, {2048, 1, 6, 160}};
+
+static std::vector<std::string> payloads;
+static std::vector<const void*> pointers;
+static std::vector<const void*> retained;
+static uint32_t atomic_depth;
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	payloads.push_back(std::string((const char*) data, size));
+	pointers.push_back(data);
+	if ((event == RETAINED) || (event == FANOUT)) {
+		uloop_data_retain(data);
+		retained.push_back(data);
+	}
+}
+
+static void fanout_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	payloads.push_back(std::string((const char*) data, size));
+	pointers.push_back(data);
+	uloop_data_retain(data);
+	retained.push_back(data);
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	CHECK_EQUAL(atomic_depth, 0);
+	atomic_depth += 1;
+}
+
+void mock_atomic_block_stop() {
+	CHECK_EQUAL(atomic_depth, 1);
+	atomic_depth -= 1;
+}
+
+static void publish(uloop_event_t event, const char* text) {
+	uloop_publish_ex(event, text, strlen(text));
+}
+
+static uint32_t run_all() {
+	uint32_t count = 0;
+	while (uloop_run()) {
+		count += 1;
+	}
+	return count;
+}
+
+TEST_GROUP(uloop_slab) {
+	void setup() {
+		payloads.clear();
+		pointers.clear();
+		retained.clear();
+		atomic_depth = 0;
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_slab, smallest_class) {
+	publish(PLAIN, "abcd");
+	CHECK_EQUAL(1, uloop_slab_stats[0].used);
+	CHECK_EQUAL(0, uloop_slab_stats[1].used);
+	CHECK_EQUAL(1, run_all());
+	CHECK_EQUAL(1, payloads.size());
+	STRCMP_EQUAL("abcd", payloads[0].c_str());
+	CHECK_EQUAL(0, uloop_slab_stats[0].used);
+	CHECK_EQUAL(1, uloop_slab_stats[0].peak);
+	CHECK_EQUAL(1, uloop_slab_stats[0].allocations);
+	CHECK_EQUAL(0, uloop_slab_stats[0].fallbacks);
+	CHECK_TRUE(uloop_slab_stats[0].wasted == 4);
+}
+
+TEST(uloop_slab, large_payload) {
+	publish(PLAIN, "0123456789");
+	CHECK_EQUAL(0, uloop_slab_stats[0].used);
+	CHECK_EQUAL(1, uloop_slab_stats[1].used);
+	CHECK_EQUAL(0, uloop_slab_stats[1].fallbacks);
+	CHECK_EQUAL(1, run_all());
+	STRCMP_EQUAL("0123456789", payloads[0].c_str());
+}
+
+TEST(uloop_slab, fallback_to_larger_class) {
+	const char* texts[5] = {"a", "bb", "ccc", "dddd", "eeeee"};
+	for (uint32_t i = 0; i < 5; i++) {
+		publish(PLAIN, texts[i]);
+	}
+	CHECK_EQUAL(4, uloop_slab_stats[0].used);
+	CHECK_EQUAL(1, uloop_slab_stats[1].used);
+	CHECK_EQUAL(1, uloop_slab_stats[1].fallbacks);
+	CHECK_TRUE(uloop_slab_stats[1].wasted == 59);
+	CHECK_EQUAL(5, run_all());
+	for (uint32_t i = 0; i < 5; i++) {
+		STRCMP_EQUAL(texts[i], payloads[i].c_str());
+	}
+	CHECK_EQUAL(0, uloop_slab_stats[0].used + uloop_slab_stats[1].used);
+}
+
+TEST(uloop_slab, exhausted) {
+	for (uint32_t i = 0; i < 7; i++) {
+		publish(PLAIN, "x");
+	}
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, publish(PLAIN, "x"));
+}
+
+TEST(uloop_slab, too_large) {
+	char text[2050];
+	memset(text, 'x', 2049);
+	text[2049] = 0;
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, publish(PLAIN, text));
+}
+
+TEST(uloop_slab, release_out_of_order) {
+	publish(RETAINED, "first");
+	publish(RETAINED, "second");
+	CHECK_EQUAL(2, run_all());
+	CHECK_EQUAL(2, retained.size());
+	CHECK_EQUAL(2, uloop_slab_stats[0].used);
+	// unlike the ring the later block can be reused before the earlier one is released
+	uloop_data_release(retained[1]);
+	CHECK_EQUAL(1, uloop_slab_stats[0].used);
+	publish(PLAIN, "third");
+	CHECK_EQUAL(1, run_all());
+	STRCMP_EQUAL("first", (const char*) retained[0]);
+	uloop_data_release(retained[0]);
+	CHECK_EQUAL(0, uloop_slab_stats[0].used);
+	CHECK_EQUAL(2, uloop_slab_stats[0].peak);
+}
+
+TEST(uloop_slab, reservation) {
+	uloop_reservation_t commit;
+	uloop_reservation_t abort;
+	char* data = (char*) uloop_publish_reserve(&commit, PLAIN, 3);
+	uloop_publish_reserve(&abort, PLAIN, 40);
+	CHECK_EQUAL(1, uloop_slab_stats[0].used);
+	CHECK_EQUAL(1, uloop_slab_stats[1].used);
+	memcpy(data, "xyz", 3);
+	uloop_publish_commit(&commit);
+	uloop_publish_abort(&abort);
+	CHECK_EQUAL(2, run_all());
+	CHECK_EQUAL(1, payloads.size());
+	STRCMP_EQUAL("xyz", payloads[0].c_str());
+	// the aborted block goes back to its class once the loop passes it
+	CHECK_EQUAL(0, uloop_slab_stats[0].used);
+	CHECK_EQUAL(0, uloop_slab_stats[1].used);
+}
+
+TEST(uloop_slab, batch) {
+	publish(PLAIN, "a");
+	publish(RETAINED, "b");
+	publish(PLAIN, "c");
+	CHECK_EQUAL(3, uloop_run_batch(3));
+	CHECK_EQUAL(3, payloads.size());
+	CHECK_EQUAL(1, uloop_slab_stats[0].used);
+	uloop_data_release(retained[0]);
+	CHECK_EQUAL(0, uloop_slab_stats[0].used);
+}
+
+TEST(uloop_slab, large_payload_fanout) {
+	std::string text(1500, 0);
+	for (uint32_t i = 0; i < text.size(); i++) {
+		text[i] = 'a' + (i % 26);
+	}
+	uloop_publish_ex(FANOUT, text.data(), text.size());
+	CHECK_EQUAL(1, uloop_slab_stats[2].used);
+	CHECK_TRUE(uloop_event_queue_get(0).size == 1500);
+	CHECK_EQUAL(1, run_all());
+	// both listeners see the same block and both hold a reference
+	CHECK_EQUAL(2, payloads.size());
+	CHECK_TRUE(payloads[0] == text);
+	CHECK_TRUE(payloads[1] == text);
+	CHECK_TRUE(pointers[0] == pointers[1]);
+	CHECK_EQUAL(2, retained.size());
+	uloop_data_release(retained[1]);
+	CHECK_EQUAL(1, uloop_slab_stats[2].used);
+	uloop_data_release(retained[0]);
+	CHECK_EQUAL(0, uloop_slab_stats[2].used);
+}
+
+TEST(uloop_slab, large_payload_retained) {
+	std::string text(300, 'z');
+	uloop_publish_ex(RETAINED, text.data(), text.size());
+	CHECK_EQUAL(1, run_all());
+	mock().expectOneCall("mock_fail").withStringParameter("reason", "dqOVF");
+	CHECK_THROWS(std::exception, uloop_publish_ex(PLAIN, text.data(), text.size()));
+	uloop_data_release(retained[0]);
+	uloop_publish_ex(PLAIN, text.data(), text.size());
+	CHECK_EQUAL(1, run_all());
+	CHECK_TRUE(payloads[1] == text);
+	CHECK_EQUAL(0, uloop_slab_stats[2].used);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,134 @@
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+#include "uloop_dispatch.h"
+
+#define SINGLE  0
+#define BOTH    1
+
+static void listener_a(uloop_event_t event);
+static void listener_b(uloop_event_t event);
+
+const uloop_listener_t uloop_listeners[2] = {listener_a, listener_b};
+
+const uloop_listener_id_t uloop_listener_table[5] = {0, ULOOP_LISTENER_NONE, 0, 1, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[2] = {0, 2};
+
+static uint32_t timed;
+static uint32_t duration;
+
+static void listener_a(uloop_event_t event) {
+	(void) event;
+}
+
+static void listener_b(uloop_event_t event) {
+	(void) event;
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_timer_start() {
+	timed += 1;
+}
+
+uint32_t mock_timer_stop() {
+	return duration;
+}
+
+static void run(uloop_event_t event, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		uloop_publish(event);
+		CHECK_TRUE(uloop_run());
+	}
+}
+
+TEST_GROUP(uloop_statistics) {
+	void setup() {
+		timed = 0;
+		duration = 0;
+		memset(uloop_listener_stats, 0, sizeof(uloop_listener_stats));
+		memset(uloop_listener_countdown, 0, sizeof(uloop_listener_countdown));
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_statistics, sampled_timing) {
+	duration = 10;
+	run(SINGLE, 9);
+	CHECK_EQUAL(3, timed);
+	CHECK_EQUAL(9, uloop_listener_stats[0].runs);
+	CHECK_EQUAL(3, uloop_listener_stats[0].samples);
+	CHECK_EQUAL(30, uloop_listener_stats[0].time_total);
+	CHECK_EQUAL(10, uloop_listener_stats[0].time_max);
+	CHECK_EQUAL(3, uloop_listener_stats[0].histogram[4]);
+}
+
+TEST(uloop_statistics, sampled_per_listener) {
+	// listener 0 runs twice per round, listener 1 once, both are sampled on their own schedule
+	run(SINGLE, 1);
+	run(BOTH, 8);
+	CHECK_EQUAL(9, uloop_listener_stats[0].runs);
+	CHECK_EQUAL(3, uloop_listener_stats[0].samples);
+	CHECK_EQUAL(8, uloop_listener_stats[1].runs);
+	CHECK_EQUAL(2, uloop_listener_stats[1].samples);
+}
+
+TEST(uloop_statistics, total_does_not_wrap) {
+	duration = 0x80000000;
+	run(SINGLE, 12);
+	CHECK_EQUAL(3, uloop_listener_stats[0].samples);
+	CHECK_TRUE(uloop_listener_stats[0].time_total == 0x180000000ULL);
+	CHECK_EQUAL(3, uloop_listener_stats[0].histogram[7]);
+}
+
+TEST(uloop_statistics, histogram_percentile) {
+	uint16_t histogram[8] = {0};
+	CHECK_EQUAL(0, uloop_histogram_percentile(histogram, 8, 500));
+	histogram[2] = 50;
+	histogram[3] = 40;
+	histogram[5] = 9;
+	histogram[7] = 1;
+	CHECK_EQUAL(3, uloop_histogram_percentile(histogram, 8, 500));
+	CHECK_EQUAL(7, uloop_histogram_percentile(histogram, 8, 501));
+	CHECK_EQUAL(7, uloop_histogram_percentile(histogram, 8, 900));
+	CHECK_EQUAL(31, uloop_histogram_percentile(histogram, 8, 990));
+	CHECK_EQUAL(UINT32_MAX, uloop_histogram_percentile(histogram, 8, 999));
+}
+
+TEST(uloop_statistics, histogram_merge) {
+	uint16_t histogram[8] = {10, 20};
+	uint16_t other[8] = {1, 2};
+	uloop_histogram_merge(histogram, other, 8);
+	CHECK_EQUAL(11, histogram[0]);
+	CHECK_EQUAL(22, histogram[1]);
+	// a sum that does not fit halves all buckets, like a single count does
+	other[0] = UINT16_MAX;
+	uloop_histogram_merge(histogram, other, 8);
+	CHECK_EQUAL(32773, histogram[0]);
+	CHECK_EQUAL(12, histogram[1]);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,292 @@
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+#include "uloop_stream.h"
+
+#define A_EVENT        0
+#define B_EVENT        1
+#define FORWARD_EVENT  2
+
+#define TEST_LISTENER    0
+#define STREAM_LISTENER  1
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[2] = {test_listener, uloop_stream_listener};
+
+const uloop_listener_id_t uloop_listener_table[7] = {
+	0, ULOOP_LISTENER_NONE, 0, ULOOP_LISTENER_NONE, 1, ULOOP_LISTENER_NONE
+};
+const uloop_listener_lut_t uloop_listener_lut[3] = {0, 2, 4};
+
+uint32_t mock_systick;
+
+static std::vector<std::string> calls;
+static std::string wire;
+static uint32_t wire_read;
+static uint32_t read_chunk;
+static bool link_broken;
+static uint32_t link_space;
+static uint32_t writes;
+
+static void test_listener(uloop_event_t event, const void* data, uint32_t size) {
+	calls.push_back(std::string(1, (char) ('0' + event)) + " " + std::string((const char*) data, size));
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+static int32_t wire_write(void* context, const uint8_t* data, uint32_t size) {
+	(void) context;
+	writes += 1;
+	if (link_broken) {
+		return -1;
+	}
+	size = (size < link_space) ? size : link_space;
+	link_space -= size;
+	wire.append((const char*) data, size);
+	return (int32_t) size;
+}
+
+static int32_t wire_read_some(void* context, uint8_t* data, uint32_t size) {
+	(void) context;
+	uint32_t count = wire.size() - wire_read;
+	count = (count < size) ? count : size;
+	count = (count < read_chunk) ? count : read_chunk;
+	memcpy(data, wire.data() + wire_read, count);
+	wire_read += count;
+	return (int32_t) count;
+}
+
+TEST_GROUP(uloop_stream) {
+	uint8_t tx[64];
+	uint8_t rx[64];
+	uloop_stream_t sender;
+	uloop_stream_t receiver;
+
+	void setup() {
+		calls.clear();
+		wire.clear();
+		wire_read = 0;
+		read_chunk = UINT32_MAX;
+		link_broken = false;
+		link_space = UINT32_MAX;
+		writes = 0;
+		mock_systick = 0;
+		uloop_init();
+		init(32, 10);
+	}
+
+	void init(uint32_t batch_size, uint32_t flush_ticks) {
+		uloop_stream_config_t config;
+		memset(&config, 0, sizeof(config));
+		config.write = wire_write;
+		config.tx_buffer = tx;
+		config.tx_size = sizeof(tx);
+		config.rx_buffer = rx;
+		config.rx_size = sizeof(rx);
+		config.batch_size = batch_size;
+		config.flush_ticks = flush_ticks;
+		uloop_stream_init(&sender, &config);
+		config.write = NULL;
+		config.read = wire_read_some;
+		uloop_stream_init(&receiver, &config);
+	}
+
+	void receive() {
+		while (uloop_stream_poll(&receiver)) {
+			continue;
+		}
+		uloop_run_until_idle();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_stream, batch_in_one_frame) {
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "ab", 2));
+	CHECK_TRUE(uloop_stream_send(&sender, B_EVENT, NULL, 0));
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "c", 1));
+	CHECK_EQUAL(0, writes);
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	// 5 bytes of framing for 3 events
+	CHECK_EQUAL(5 + 4 + 2 + 3, wire.size());
+	receive();
+	CHECK_EQUAL(3, calls.size());
+	STRCMP_EQUAL("0 ab", calls[0].c_str());
+	STRCMP_EQUAL("1 ", calls[1].c_str());
+	STRCMP_EQUAL("0 c", calls[2].c_str());
+	CHECK_EQUAL(1, sender.stats.frames_sent);
+	CHECK_EQUAL(1, receiver.stats.frames_received);
+	CHECK_EQUAL(3, receiver.stats.events_received);
+}
+
+TEST(uloop_stream, flush_on_size) {
+	init(8, 10);
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "12345", 5));
+	CHECK_EQUAL(0, writes);
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "6", 1));
+	CHECK_EQUAL(1, writes);
+	receive();
+	CHECK_EQUAL(2, calls.size());
+}
+
+TEST(uloop_stream, flush_when_full) {
+	// a record that does not fit the frame sends the batch before it
+	char data[40];
+	memset(data, 'x', sizeof(data));
+	init(1000, 10);
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, data, 40));
+	CHECK_TRUE(uloop_stream_send(&sender, B_EVENT, data, 40));
+	CHECK_EQUAL(1, sender.stats.frames_sent);
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(2, calls.size());
+}
+
+TEST(uloop_stream, every_event_without_batch) {
+	init(0, 10);
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "a", 1));
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "b", 1));
+	CHECK_EQUAL(2, sender.stats.frames_sent);
+}
+
+TEST(uloop_stream, flush_on_timeout) {
+	mock_systick = 100;
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "t", 1));
+	mock_systick = 109;
+	uloop_stream_poll(&sender);
+	CHECK_EQUAL(0, writes);
+	mock_systick = 110;
+	uloop_stream_poll(&sender);
+	CHECK_EQUAL(1, writes);
+}
+
+TEST(uloop_stream, byte_by_byte) {
+	read_chunk = 1;
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "slow", 4));
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(1, calls.size());
+	STRCMP_EQUAL("0 slow", calls[0].c_str());
+}
+
+TEST(uloop_stream, crc_error_resync) {
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "bad", 3));
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	wire[5] ^= 0x01;
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "good", 4));
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(1, calls.size());
+	STRCMP_EQUAL("0 good", calls[0].c_str());
+	CHECK_EQUAL(1, receiver.stats.crc_errors);
+}
+
+TEST(uloop_stream, garbage_before_frame) {
+	// noise on the line, including a sync byte with an impossible length
+	wire.append("\x01\x7E\xFF\xFF\x02", 5);
+	CHECK_TRUE(uloop_stream_send(&sender, B_EVENT, "x", 1));
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(1, calls.size());
+	STRCMP_EQUAL("1 x", calls[0].c_str());
+	CHECK_EQUAL(5, receiver.stats.skipped);
+}
+
+TEST(uloop_stream, unknown_event) {
+	CHECK_TRUE(uloop_stream_send(&sender, 200, "?", 1));
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "!", 1));
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(1, calls.size());
+	CHECK_EQUAL(1, receiver.stats.drops);
+}
+
+TEST(uloop_stream, too_large) {
+	char data[64];
+	memset(data, 0, sizeof(data));
+	CHECK_FALSE(uloop_stream_send(&sender, A_EVENT, data, sizeof(data)));
+	CHECK_EQUAL(1, sender.stats.drops);
+	CHECK_EQUAL(0, sender.stats.events_sent);
+}
+
+TEST(uloop_stream, broken_link) {
+	link_broken = true;
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "a", 1));
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "b", 1));
+	CHECK_FALSE(uloop_stream_flush(&sender));
+	CHECK_EQUAL(0, sender.stats.frames_sent);
+	CHECK_EQUAL(2, sender.stats.drops);
+	// the next batch starts empty
+	link_broken = false;
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	CHECK_EQUAL(0, wire.size());
+}
+
+TEST(uloop_stream, busy_link) {
+	link_space = 4;
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "busy", 4));
+	CHECK_FALSE(uloop_stream_flush(&sender));
+	CHECK_EQUAL(4, wire.size());
+	// the frame is on the way, the event has to wait for it
+	CHECK_FALSE(uloop_stream_send(&sender, B_EVENT, "x", 1));
+	CHECK_EQUAL(1, sender.stats.drops);
+	link_space = UINT32_MAX;
+	uloop_stream_poll(&sender);
+	CHECK_EQUAL(1, sender.stats.frames_sent);
+	CHECK_TRUE(uloop_stream_send(&sender, B_EVENT, "y", 1));
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(2, calls.size());
+	STRCMP_EQUAL("0 busy", calls[0].c_str());
+	STRCMP_EQUAL("1 y", calls[1].c_str());
+}
+
+TEST(uloop_stream, busy_link_on_batch_size) {
+	// the event is in the frame, it only waits for the link
+	init(4, 10);
+	link_space = 0;
+	CHECK_TRUE(uloop_stream_send(&sender, A_EVENT, "full", 4));
+	CHECK_EQUAL(0, sender.stats.frames_sent);
+	link_space = UINT32_MAX;
+	CHECK_TRUE(uloop_stream_flush(&sender));
+	receive();
+	CHECK_EQUAL(1, calls.size());
+	STRCMP_EQUAL("0 full", calls[0].c_str());
+}
+
+TEST(uloop_stream, forward_listener) {
+	uloop_stream_forward(&sender, FORWARD_EVENT);
+	uloop_publish_ex(FORWARD_EVENT, "fw", 2);
+	uloop_run_until_idle();
+	CHECK_EQUAL(1, sender.stats.events_sent);
+	uloop_stream_forward(NULL, FORWARD_EVENT);
+	uloop_publish_ex(FORWARD_EVENT, "fw", 2);
+	uloop_run_until_idle();
+	CHECK_EQUAL(1, sender.stats.events_sent);
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,170 @@
+#include <stdexcept>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define SHARED     0
+#define ONLY_A     1
+#define LOW_POWER  2
+
+#define LISTENER_A 0
+#define LISTENER_B 1
+
+static void listener_a(uloop_event_t event, const void* data, uint32_t size);
+static void listener_b(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[2] = {listener_a, listener_b};
+
+const uloop_listener_id_t uloop_listener_table[7] = {0, 1, ULOOP_LISTENER_NONE, 0, ULOOP_LISTENER_NONE, 1, ULOOP_LISTENER_NONE};
+const uloop_listener_lut_t uloop_listener_lut[3] = {0, 3, 5};
+
+/* listener_b starts disabled for LOW_POWER, as with "enabled": false */
+const uint32_t uloop_subscription_defaults[1] = {0x0000000B};
+
+static std::vector<uint32_t> calls;
+static uint32_t atomic_depth;
+static uint32_t atomic_blocks;
+
+static void listener_a(uloop_event_t event, const void* data, uint32_t size) {
+	(void) data;
+	(void) size;
+	calls.push_back(0x100 | event);
+}
+
+static void listener_b(uloop_event_t event, const void* data, uint32_t size) {
+	(void) data;
+	(void) size;
+	calls.push_back(0x200 | event);
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	CHECK_EQUAL(atomic_depth, 0);
+	atomic_depth += 1;
+	atomic_blocks += 1;
+}
+
+void mock_atomic_block_stop() {
+	CHECK_EQUAL(atomic_depth, 1);
+	atomic_depth -= 1;
+}
+
+static uint32_t run_all() {
+	uint32_t count = 0;
+	while (uloop_run()) {
+		count += 1;
+	}
+	return count;
+}
+
+TEST_GROUP(uloop_subscription) {
+	void setup() {
+		calls.clear();
+		atomic_depth = 0;
+		atomic_blocks = 0;
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_subscription, defaults) {
+	CHECK_TRUE(uloop_listener_enabled(LISTENER_A, SHARED));
+	CHECK_TRUE(uloop_listener_enabled(LISTENER_B, SHARED));
+	CHECK_FALSE(uloop_listener_enabled(LISTENER_B, LOW_POWER));
+	// not a pair of the listener table
+	CHECK_FALSE(uloop_listener_enabled(LISTENER_B, ONLY_A));
+	uloop_publish(SHARED);
+	CHECK_EQUAL(1, run_all());
+	CHECK_EQUAL(2, calls.size());
+}
+
+TEST(uloop_subscription, disable_one_listener) {
+	uloop_listener_disable(LISTENER_A, SHARED);
+	uloop_publish(SHARED);
+	uloop_publish(ONLY_A);
+	CHECK_EQUAL(2, run_all());
+	CHECK_EQUAL(2, calls.size());
+	CHECK_EQUAL(0x200 | SHARED, calls[0]);
+	CHECK_EQUAL(0x100 | ONLY_A, calls[1]);
+}
+
+TEST(uloop_subscription, dead_event_is_dropped) {
+	// neither the queue nor a critical section is touched
+	uloop_publish(LOW_POWER);
+	uloop_publish_ex(LOW_POWER, "abc", 3);
+	CHECK_TRUE(uloop_try_publish(LOW_POWER));
+	CHECK_EQUAL(0, atomic_blocks);
+	CHECK_FALSE(uloop_run());
+	CHECK_EQUAL(0, uloop_event_stats[LOW_POWER].drops);
+}
+
+TEST(uloop_subscription, enable) {
+	uloop_listener_enable(LISTENER_B, LOW_POWER);
+	uloop_publish(LOW_POWER);
+	CHECK_EQUAL(1, run_all());
+	CHECK_EQUAL(1, calls.size());
+	CHECK_EQUAL(0x200 | LOW_POWER, calls[0]);
+}
+
+TEST(uloop_subscription, repeated_calls) {
+	uloop_listener_enable(LISTENER_B, LOW_POWER);
+	uloop_listener_enable(LISTENER_B, LOW_POWER);
+	uloop_listener_disable(LISTENER_B, LOW_POWER);
+	uloop_publish(LOW_POWER);
+	CHECK_FALSE(uloop_run());
+	uloop_listener_disable(LISTENER_A, SHARED);
+	uloop_listener_disable(LISTENER_A, SHARED);
+	uloop_publish(SHARED);
+	CHECK_EQUAL(1, run_all());
+	CHECK_EQUAL(1, calls.size());
+}
+
+TEST(uloop_subscription, disabled_while_queued) {
+	uloop_publish(ONLY_A);
+	uloop_listener_disable(LISTENER_A, ONLY_A);
+	// the event is still dispatched, just to no listener
+	CHECK_EQUAL(1, run_all());
+	CHECK_EQUAL(0, calls.size());
+	uloop_publish(ONLY_A);
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop_subscription, unknown_pair) {
+	mock().expectOneCall("mock_dev_assert");
+	CHECK_THROWS(std::exception, uloop_listener_enable(LISTENER_B, ONLY_A));
+}
+
+TEST(uloop_subscription, init_restores_defaults) {
+	uloop_listener_enable(LISTENER_B, LOW_POWER);
+	uloop_listener_disable(LISTENER_A, SHARED);
+	uloop_init();
+	CHECK_TRUE(uloop_listener_enabled(LISTENER_A, SHARED));
+	CHECK_FALSE(uloop_listener_enabled(LISTENER_B, LOW_POWER));
+	uloop_publish(LOW_POWER);
+	CHECK_FALSE(uloop_run());
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,11 @@
+#define ULOOP_EVENT_QUEUE_SIZE    8
+#define ULOOP_DATA_QUEUE_SIZE     64
+#define ULOOP_LISTENER_TIME_LIMIT 10
+#define ULOOP_METADATA_NAME_SIZE  4
+#define ULOOP_SYNC_DEPTH          2
+
+#define ULOOP_LISTENER_COUNT      4
+#define ULOOP_LISTENER_TABLE_SIZE 8
+#define ULOOP_EVENT_COUNT         4
+
+#define ULOOP_STATISTICS_ENABLED
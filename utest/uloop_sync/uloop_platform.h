@@ -0,0 +1,27 @@
+#pragma once
+#include "uloop.h"
+
+extern void mock_fail(const char* reason);
+extern void mock_fail_tmo(uint32_t duration);
+extern void mock_dev_assert(void);
+extern void mock_atomic_block_start(void);
+extern void mock_atomic_block_stop(void);
+extern uint32_t mock_clock;
+
+#define ULOOP_ERROR_EQOVF()         mock_fail("eqOVF");
+#define ULOOP_ERROR_DQOVF()         mock_fail("dqOVF");
+#define ULOOP_ERROR_DQCORR()        mock_fail("dqCORR");
+#define ULOOP_ERROR_TMO(time_us)    mock_fail_tmo(time_us);
+
+#define ULOOP_DEV_ASSERT(cond)     \
+	do { \
+		if (!(cond)) { \
+			mock_dev_assert(); \
+		} \
+	} while (0)
+
+/* a local start time, sync publishes nest the measurements */
+#define ULOOP_TIMER_START()         uint32_t timer_start = mock_clock
+#define ULOOP_TIMER_STOP()          (mock_clock - timer_start)
+#define ULOOP_ATOMIC_BLOCK_ENTER()  mock_atomic_block_start()
+#define ULOOP_ATOMIC_BLOCK_LEAVE()  mock_atomic_block_stop()
@@ -0,0 +1,188 @@
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <stdint.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTestExt/MockSupport.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "uloop.h"
+#include "uloop_config.h"
+
+#define RAW        0
+#define FILTERED   1
+#define THRESHOLD  2
+#define DEEP       3
+
+static void raw_listener(uloop_event_t event, const void* data, uint32_t size);
+static void filter_listener(uloop_event_t event, const void* data, uint32_t size);
+static void threshold_listener(uloop_event_t event, const void* data, uint32_t size);
+static void deep_listener(uloop_event_t event, const void* data, uint32_t size);
+
+const uloop_listener_t uloop_listeners[4] = {raw_listener, filter_listener, threshold_listener, deep_listener};
+
+/* RAW -> FILTERED -> THRESHOLD, each stage publishes the next one synchronously */
+const uloop_listener_id_t uloop_listener_table[8] = {
+	0, ULOOP_LISTENER_NONE, 1, ULOOP_LISTENER_NONE, 2, ULOOP_LISTENER_NONE, 3, ULOOP_LISTENER_NONE
+};
+const uloop_listener_lut_t uloop_listener_lut[4] = {0, 2, 4, 6};
+
+uint32_t mock_clock;
+
+static std::vector<std::string> calls;
+static std::vector<const void*> pointers;
+static uint32_t filter_cost;
+static bool threshold_deep;
+static bool threshold_retain;
+static uint32_t atomic_depth;
+
+static void raw_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	char filtered[16];
+	for (uint32_t i = 0; i < size; i++) {
+		filtered[i] = ((const char*) data)[i] - 'a' + 'A';
+	}
+	mock_clock += 3;
+	calls.push_back("raw");
+	uloop_publish_sync(FILTERED, filtered, size);
+	CHECK_EQUAL(0, uloop_listener_active);
+	mock_clock += 1;
+}
+
+static void filter_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	mock_clock += filter_cost;
+	calls.push_back(std::string("filter ") + std::string((const char*) data, size));
+	pointers.push_back(data);
+	uloop_publish_sync(THRESHOLD, data, size);
+	CHECK_EQUAL(1, uloop_listener_active);
+}
+
+static void threshold_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	mock_clock += 2;
+	calls.push_back(std::string("threshold ") + std::string((const char*) data, size));
+	pointers.push_back(data);
+	if (threshold_deep) {
+		uloop_publish_sync(DEEP, NULL, 0);
+	}
+	if (threshold_retain) {
+		uloop_data_retain(data);
+	}
+}
+
+static void deep_listener(uloop_event_t event, const void* data, uint32_t size) {
+	(void) event;
+	(void) data;
+	(void) size;
+	calls.push_back("deep");
+}
+
+void mock_fail(const char* reason) {
+	mock().actualCall(__FUNCTION__)
+		.withStringParameter("reason", reason);
+	throw std::exception();
+}
+
+void mock_fail_tmo(uint32_t duration) {
+	mock().actualCall(__FUNCTION__)
+		.withParameter("duration", duration);
+}
+
+void mock_dev_assert() {
+	mock().actualCall(__FUNCTION__);
+	throw std::exception();
+}
+
+void mock_atomic_block_start() {
+	CHECK_EQUAL(atomic_depth, 0);
+	atomic_depth += 1;
+}
+
+void mock_atomic_block_stop() {
+	CHECK_EQUAL(atomic_depth, 1);
+	atomic_depth -= 1;
+}
+
+TEST_GROUP(uloop_sync) {
+	void setup() {
+		calls.clear();
+		pointers.clear();
+		mock_clock = 0;
+		filter_cost = 5;
+		threshold_deep = false;
+		threshold_retain = false;
+		atomic_depth = 0;
+		uloop_listener_active = ULOOP_LISTENER_NONE;
+		memset(uloop_event_stats, 0, sizeof(uloop_event_stats));
+		memset(uloop_listener_stats, 0, sizeof(uloop_listener_stats));
+		uloop_init();
+	}
+
+	void teardown() {
+		mock().checkExpectations();
+		mock().clear();
+	}
+};
+
+TEST(uloop_sync, pipeline) {
+	uloop_publish_ex(RAW, "abc", 3);
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(3, calls.size());
+	STRCMP_EQUAL("raw", calls[0].c_str());
+	STRCMP_EQUAL("filter ABC", calls[1].c_str());
+	STRCMP_EQUAL("threshold ABC", calls[2].c_str());
+	// the buffer of the publishing listener is passed on, nothing is copied or queued
+	CHECK_TRUE(pointers[0] == pointers[1]);
+	CHECK_FALSE(uloop_run());
+}
+
+TEST(uloop_sync, statistics) {
+	uloop_publish_ex(RAW, "abc", 3);
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(1, uloop_event_stats[FILTERED].count);
+	CHECK_EQUAL(1, uloop_event_stats[THRESHOLD].count);
+	for (uint32_t i = 0; i < 3; i++) {
+		CHECK_EQUAL(1, uloop_listener_stats[i].runs);
+	}
+	// every listener is charged with its own time only
+	CHECK_TRUE(uloop_listener_stats[0].time_total == 4);
+	CHECK_TRUE(uloop_listener_stats[1].time_total == 5);
+	CHECK_TRUE(uloop_listener_stats[2].time_total == 2);
+}
+
+TEST(uloop_sync, time_limit) {
+	// the pipeline takes 16 in total, only the filter itself is over the limit
+	filter_cost = 11;
+	mock().expectOneCall("mock_fail_tmo").withParameter("duration", 11);
+	uloop_publish_ex(RAW, "abc", 3);
+	CHECK_TRUE(uloop_run());
+	CHECK_EQUAL(11, uloop_listener_stats[1].time_max);
+}
+
+TEST(uloop_sync, outside_listener) {
+	mock().expectOneCall("mock_dev_assert");
+	CHECK_THROWS(std::exception, uloop_publish_sync(FILTERED, "abc", 3));
+}
+
+TEST(uloop_sync, too_deep) {
+	threshold_deep = true;
+	mock().expectOneCall("mock_dev_assert");
+	uloop_publish_ex(RAW, "abc", 3);
+	CHECK_THROWS(std::exception, uloop_run());
+	CHECK_EQUAL(0, std::count(calls.begin(), calls.end(), "deep"));
+}
+
+TEST(uloop_sync, retain) {
+	threshold_retain = true;
+	mock().expectOneCall("mock_dev_assert");
+	uloop_publish_ex(RAW, "abc", 3);
+	CHECK_THROWS(std::exception, uloop_run());
+}
+
+int main(int ac, char** av) {
+	return CommandLineTestRunner::RunAllTests(ac, av);
+}
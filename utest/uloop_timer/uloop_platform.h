@@ -3,6 +3,7 @@
 
 extern void mock_dev_assert(void);
 extern uint32_t mock_systick(void);
+extern uint32_t compare_deadline;
 
 #define ULOOP_DEV_ASSERT(cond)     \
 	do { \
@@ -12,4 +13,5 @@ extern uint32_t mock_systick(void);
 	} while (0)
 
 #define ULOOP_SYSTICK()            mock_systick()
+#define ULOOP_TIMER_SET_COMPARE(deadline) (compare_deadline = (deadline))
 #define ULOOP_TIMER_COUNT          8
@@ -1 +1,4 @@
 #define ULOOP_TIMER_COUNT 8
+#define ULOOP_TIMER_PERIODIC
+#define ULOOP_TIMER_POOL_SIZE 4
+#define ULOOP_TIMER_POOL_DATA_SIZE 8
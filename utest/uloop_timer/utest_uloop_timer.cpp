@@ -1,6 +1,7 @@
 
 #include <stdexcept>
 #include <queue>
+#include <vector>
 #include <stdint.h>
 #include <string.h>
 
@@ -32,6 +33,9 @@ uint64_t xorshift64s(uint64_t* state) {
 }
 
 const uloop_event_t uloop_timer_events[] = {10, 11, 12, 13, 14, 15, 16, 17};
+const uint32_t uloop_timer_periods[] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+uint32_t compare_deadline;
 
 void mock_dev_assert() {
 	mock().actualCall(__FUNCTION__);
@@ -46,6 +50,17 @@ void uloop_publish(uloop_event_t event) {
 	mock().actualCall(__FUNCTION__).withParameter("event", event);
 }
 
+void uloop_publish_ex(uloop_event_t event, const void* data, uint32_t size) {
+	uint32_t value = 0;
+	if (size > 0) {
+		memcpy(&value, data, (size < sizeof(value)) ? size : sizeof(value));
+	}
+	mock().actualCall(__FUNCTION__)
+		.withParameter("event", event)
+		.withParameter("size", size)
+		.withParameter("value", value);
+}
+
 TEST_GROUP(uloop_timer)
 {
 	void setup() {
@@ -94,6 +109,12 @@ void run_for(uint32_t& systick, uint32_t value, uint32_t bitmask = 0, bool exact
 	}
 }
 
+void start_periodic(uint32_t systick, uloop_timer_t timer, uint32_t period, uint32_t phase) {
+	mock().expectOneCall("mock_systick").andReturnValue(systick);
+	uloop_timer_start_periodic(timer, period, phase);
+	mock().checkExpectations();
+}
+
 void start(uint32_t systick, uloop_timer_t timer, uint32_t value, bool realtive = true) {
 	mock().expectOneCall("mock_systick").andReturnValue(systick);
 	uloop_timer_start_ex(timer, value, realtive);
@@ -101,13 +122,54 @@ void start(uint32_t systick, uloop_timer_t timer, uint32_t value, bool realtive
 }
 
 void stop(uint32_t systick, uloop_timer_t timer) {
+#ifndef ULOOP_TIMER_HEAP
 	mock().expectOneCall("mock_systick").andReturnValue(systick);
+#else
+	(void) systick;
+#endif
 	uloop_timer_stop(timer);
 	mock().checkExpectations();
 }
 
+uloop_timer_handle_t publish_delayed(uint32_t systick, uloop_event_t event, uint32_t value, uint32_t delay) {
+	mock().expectOneCall("mock_systick").andReturnValue(systick);
+	uloop_timer_handle_t handle = uloop_publish_delayed(event, &value, sizeof(value), delay);
+	mock().checkExpectations();
+	return handle;
+}
+
+void cancel(uint32_t systick, uloop_timer_handle_t handle, bool valid) {
+#ifndef ULOOP_TIMER_HEAP
+	if (valid) {
+		mock().expectOneCall("mock_systick").andReturnValue(systick);
+	}
+#else
+	(void) systick;
+#endif
+	CHECK_EQUAL(uloop_publish_delayed_cancel(handle), valid);
+	mock().checkExpectations();
+}
+
+/* advances systick by value and runs the timer listener expecting the given pool events, each carrying its id as value */
+void expire_delayed(uint32_t& systick, uint32_t value, std::vector<uint32_t> events) {
+	systick += value;
+	mock().expectOneCall("uloop_publish").withParameter("event", E_ULOOP_TIMER_UPDATE);
+	uloop_timer_update(systick);
+	mock().checkExpectations();
+	mock().expectOneCall("mock_systick").andReturnValue(systick);
+	for (uint32_t event : events) {
+		mock().expectOneCall("uloop_publish_ex").withParameter("event", event).withParameter("size", 4).withParameter("value", event);
+	}
+	uloop_timer_listener(E_ULOOP_TIMER_UPDATE, NULL, 0);
+	mock().checkExpectations();
+}
+
 void running(uint32_t systick, uloop_timer_t timer, bool val) {
+#ifndef ULOOP_TIMER_HEAP
 	mock().expectOneCall("mock_systick").andReturnValue(systick);
+#else
+	(void) systick;
+#endif
 	CHECK_EQUAL(uloop_timer_running(timer), val);
 	mock().checkExpectations();
 }
@@ -259,6 +321,156 @@ TEST(uloop_timer, start_absolute) {
 	run_for(systick, 0x100, TIM0);
 }
 
+TEST(uloop_timer, next_deadline) {
+	uint32_t systick = 1000;
+	uloop_timer_init(systick);
+	CHECK_EQUAL(uloop_timer_next_deadline(), systick + ULOOP_TIMER_UPDATE_PERIOD);
+	CHECK_EQUAL(compare_deadline, uloop_timer_next_deadline());
+	start(systick, 0, 50);
+	start(systick, 1, 20);
+	CHECK_EQUAL(uloop_timer_next_deadline(), systick + 20);
+	CHECK_EQUAL(compare_deadline, uloop_timer_next_deadline());
+	run_for(systick, 20, TIM1, true);
+	CHECK_EQUAL(uloop_timer_next_deadline(), systick + 30);
+	CHECK_EQUAL(compare_deadline, uloop_timer_next_deadline());
+	run_for(systick, 30, TIM0, true);
+	CHECK_EQUAL(uloop_timer_next_deadline(), systick + ULOOP_TIMER_UPDATE_PERIOD);
+	CHECK_EQUAL(compare_deadline, uloop_timer_next_deadline());
+	// a passed deadline is handed to the port as it is, the port fires right away
+	start(systick, 2, systick - 10, false);
+	CHECK_EQUAL(compare_deadline, systick - 10);
+	run_for(systick, 0, TIM2, true);
+}
+
+TEST(uloop_timer, periodic) {
+	uint32_t systick = 0;
+	start_periodic(systick, 0, 10, 5);
+	run_for(systick, 5, TIM0);
+	for (uint32_t i = 0; i < 10; i++) {
+		run_for(systick, 10, TIM0);
+	}
+	running(systick, 0, true);
+	stop(systick, 0);
+	run_for(systick, 10, TIM_NONE);
+	run_for(systick, 100);
+	running(systick, 0, false);
+}
+
+TEST(uloop_timer, periodic_drift_free) {
+	uint32_t systick = 0xFFFFFFF0;
+	uloop_timer_init(systick);
+	start_periodic(systick, 1, 10, 10);
+	// the listener runs 3 ticks late, the next deadline is still 10 ticks after the previous one
+	mock().expectOneCall("uloop_publish").withParameter("event", E_ULOOP_TIMER_UPDATE);
+	uloop_timer_update(systick + 10);
+	update(systick + 13, TIM1);
+	CHECK_EQUAL(uloop_timer_next_deadline(), systick + 20);
+	// three more deadlines pass before the listener runs, they are coalesced
+	mock().expectOneCall("uloop_publish").withParameter("event", E_ULOOP_TIMER_UPDATE);
+	uloop_timer_update(systick + 20);
+	mock().expectOneCall("mock_systick").andReturnValue(systick + 50);
+	mock().expectOneCall("uloop_publish_ex").withParameter("event", 11).withParameter("size", 4).withParameter("value", 3);
+	uloop_timer_listener(E_ULOOP_TIMER_UPDATE, NULL, 0);
+	mock().checkExpectations();
+	CHECK_EQUAL(uloop_timer_next_deadline(), systick + 60);
+	systick += 50;
+	run_for(systick, 10, TIM1);
+	start(systick, 1, 5);
+	run_for(systick, 5, TIM1);
+	run_for(systick, 100);
+}
+
+TEST(uloop_timer, delayed_publish) {
+	uint32_t systick = 0xFFFFFFF0;
+	uloop_timer_init(systick);
+	publish_delayed(systick, 30, 30, 20);
+	publish_delayed(systick, 31, 31, 10);
+	start(systick, 0, 15);
+	expire_delayed(systick, 10, {31});
+	run_for(systick, 5, TIM0, true);
+	expire_delayed(systick, 5, {30});
+	run_for(systick, 100);
+}
+
+TEST(uloop_timer, delayed_publish_no_data) {
+	uint32_t systick = 0;
+	mock().expectOneCall("mock_systick").andReturnValue(systick);
+	CHECK(uloop_publish_delayed(24, NULL, 0, 10) != ULOOP_TIMER_HANDLE_NONE);
+	mock().checkExpectations();
+	systick += 10;
+	mock().expectOneCall("uloop_publish").withParameter("event", E_ULOOP_TIMER_UPDATE);
+	uloop_timer_update(systick);
+	mock().checkExpectations();
+	mock().expectOneCall("mock_systick").andReturnValue(systick);
+	mock().expectOneCall("uloop_publish_ex").withParameter("event", 24).withParameter("size", 0).withParameter("value", 0);
+	uloop_timer_listener(E_ULOOP_TIMER_UPDATE, NULL, 0);
+	mock().checkExpectations();
+}
+
+TEST(uloop_timer, delayed_pool) {
+	uint32_t systick = 0;
+	uloop_timer_handle_t handles[4];
+	for (uint32_t i = 0; i < 4; i++) {
+		handles[i] = publish_delayed(systick, 20 + i, 20 + i, 10 + i);
+		CHECK(handles[i] != ULOOP_TIMER_HANDLE_NONE);
+	}
+	CHECK_EQUAL(publish_delayed(systick, 24, 24, 10), ULOOP_TIMER_HANDLE_NONE);
+	cancel(systick, handles[1], true);
+	cancel(systick, handles[1], false);
+	uloop_timer_handle_t reused = publish_delayed(systick, 25, 25, 30);
+	CHECK(reused != ULOOP_TIMER_HANDLE_NONE);
+	CHECK(reused != handles[1]);
+	expire_delayed(systick, 10, {20});
+	cancel(systick, handles[0], false);
+	expire_delayed(systick, 3, {22, 23});
+	expire_delayed(systick, 17, {25});
+	run_for(systick, 100);
+}
+
+TEST(uloop_timer, random_restart) {
+	uint64_t seed = 1;
+	uint32_t systick = 0xFFFFF000;
+	uint32_t deadlines[8];
+	bool active[8] = {false};
+	// stopping a timer does not move the update time back, mirror it
+	uint32_t current = systick + ULOOP_TIMER_UPDATE_PERIOD;
+	uloop_timer_init(systick);
+	for (uint32_t n = 0; n < 2000; n++) {
+		uloop_timer_t timer = xorshift64s(&seed) % 8;
+		if ((xorshift64s(&seed) % 4) == 0) {
+			stop(systick, timer);
+			active[timer] = false;
+		} else {
+			uint32_t value = xorshift64s(&seed) % 64;
+			start(systick, timer, value);
+			deadlines[timer] = systick + value;
+			active[timer] = true;
+			if ((int32_t)(deadlines[timer] - current) < 0) {
+				current = deadlines[timer];
+			}
+		}
+		uint32_t step = 1 + (xorshift64s(&seed) % 16);
+		uint32_t bitmask = 0;
+		if ((int32_t)((systick + step) - current) >= 0) {
+			bitmask = TIM_NONE;
+			current = systick + step + ULOOP_TIMER_UPDATE_PERIOD;
+			for (uint32_t i = 0; i < 8; i++) {
+				if (active[i] && ((int32_t)((systick + step) - deadlines[i]) >= 0)) {
+					bitmask |= 1 << i;
+					active[i] = false;
+				} else if (active[i] && ((int32_t)(deadlines[i] - current) < 0)) {
+					current = deadlines[i];
+				}
+			}
+		}
+		run_for(systick, step, bitmask, true);
+		CHECK_EQUAL(current, uloop_timer_next_deadline());
+		for (uint32_t i = 0; i < 8; i++) {
+			running(systick, i, active[i]);
+		}
+	}
+}
+
 int main(int ac, char** av) {
 	return CommandLineTestRunner::RunAllTests(ac, av);
 }
\ No newline at end of file